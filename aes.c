@@ -2,61 +2,104 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "aes.h"
+#include "es.h"
+#include "mapeo.h"
+#include "pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AES_X86 1
+#include <immintrin.h>
+#endif
 
 #define BUFFER_SIZE 4096
-#define AES_BLOCK_SIZE 16
-#define AES_KEY_SIZE 16
-
-// S-box de AES (tabla de sustitución)
-static const unsigned char sbox[256] = {
-    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
-    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
-    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
-    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
-    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
-    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
-    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
-    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
-    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
-    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
-    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
-    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
-    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
-    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
-    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
-    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
-};
+
+// S-box de AES (tabla de sustitución), como lista para generar las tablas
+#define AES_SBOX(X) \
+    X(0x63) X(0x7c) X(0x77) X(0x7b) X(0xf2) X(0x6b) X(0x6f) X(0xc5) X(0x30) X(0x01) X(0x67) X(0x2b) X(0xfe) X(0xd7) X(0xab) X(0x76) \
+    X(0xca) X(0x82) X(0xc9) X(0x7d) X(0xfa) X(0x59) X(0x47) X(0xf0) X(0xad) X(0xd4) X(0xa2) X(0xaf) X(0x9c) X(0xa4) X(0x72) X(0xc0) \
+    X(0xb7) X(0xfd) X(0x93) X(0x26) X(0x36) X(0x3f) X(0xf7) X(0xcc) X(0x34) X(0xa5) X(0xe5) X(0xf1) X(0x71) X(0xd8) X(0x31) X(0x15) \
+    X(0x04) X(0xc7) X(0x23) X(0xc3) X(0x18) X(0x96) X(0x05) X(0x9a) X(0x07) X(0x12) X(0x80) X(0xe2) X(0xeb) X(0x27) X(0xb2) X(0x75) \
+    X(0x09) X(0x83) X(0x2c) X(0x1a) X(0x1b) X(0x6e) X(0x5a) X(0xa0) X(0x52) X(0x3b) X(0xd6) X(0xb3) X(0x29) X(0xe3) X(0x2f) X(0x84) \
+    X(0x53) X(0xd1) X(0x00) X(0xed) X(0x20) X(0xfc) X(0xb1) X(0x5b) X(0x6a) X(0xcb) X(0xbe) X(0x39) X(0x4a) X(0x4c) X(0x58) X(0xcf) \
+    X(0xd0) X(0xef) X(0xaa) X(0xfb) X(0x43) X(0x4d) X(0x33) X(0x85) X(0x45) X(0xf9) X(0x02) X(0x7f) X(0x50) X(0x3c) X(0x9f) X(0xa8) \
+    X(0x51) X(0xa3) X(0x40) X(0x8f) X(0x92) X(0x9d) X(0x38) X(0xf5) X(0xbc) X(0xb6) X(0xda) X(0x21) X(0x10) X(0xff) X(0xf3) X(0xd2) \
+    X(0xcd) X(0x0c) X(0x13) X(0xec) X(0x5f) X(0x97) X(0x44) X(0x17) X(0xc4) X(0xa7) X(0x7e) X(0x3d) X(0x64) X(0x5d) X(0x19) X(0x73) \
+    X(0x60) X(0x81) X(0x4f) X(0xdc) X(0x22) X(0x2a) X(0x90) X(0x88) X(0x46) X(0xee) X(0xb8) X(0x14) X(0xde) X(0x5e) X(0x0b) X(0xdb) \
+    X(0xe0) X(0x32) X(0x3a) X(0x0a) X(0x49) X(0x06) X(0x24) X(0x5c) X(0xc2) X(0xd3) X(0xac) X(0x62) X(0x91) X(0x95) X(0xe4) X(0x79) \
+    X(0xe7) X(0xc8) X(0x37) X(0x6d) X(0x8d) X(0xd5) X(0x4e) X(0xa9) X(0x6c) X(0x56) X(0xf4) X(0xea) X(0x65) X(0x7a) X(0xae) X(0x08) \
+    X(0xba) X(0x78) X(0x25) X(0x2e) X(0x1c) X(0xa6) X(0xb4) X(0xc6) X(0xe8) X(0xdd) X(0x74) X(0x1f) X(0x4b) X(0xbd) X(0x8b) X(0x8a) \
+    X(0x70) X(0x3e) X(0xb5) X(0x66) X(0x48) X(0x03) X(0xf6) X(0x0e) X(0x61) X(0x35) X(0x57) X(0xb9) X(0x86) X(0xc1) X(0x1d) X(0x9e) \
+    X(0xe1) X(0xf8) X(0x98) X(0x11) X(0x69) X(0xd9) X(0x8e) X(0x94) X(0x9b) X(0x1e) X(0x87) X(0xe9) X(0xce) X(0x55) X(0x28) X(0xdf) \
+    X(0x8c) X(0xa1) X(0x89) X(0x0d) X(0xbf) X(0xe6) X(0x42) X(0x68) X(0x41) X(0x99) X(0x2d) X(0x0f) X(0xb0) X(0x54) X(0xbb) X(0x16)
 
 // S-box inversa para descifrado
-static const unsigned char inv_sbox[256] = {
-    0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38, 0xbf, 0x40, 0xa3, 0x9e, 0x81, 0xf3, 0xd7, 0xfb,
-    0x7c, 0xe3, 0x39, 0x82, 0x9b, 0x2f, 0xff, 0x87, 0x34, 0x8e, 0x43, 0x44, 0xc4, 0xde, 0xe9, 0xcb,
-    0x54, 0x7b, 0x94, 0x32, 0xa6, 0xc2, 0x23, 0x3d, 0xee, 0x4c, 0x95, 0x0b, 0x42, 0xfa, 0xc3, 0x4e,
-    0x08, 0x2e, 0xa1, 0x66, 0x28, 0xd9, 0x24, 0xb2, 0x76, 0x5b, 0xa2, 0x49, 0x6d, 0x8b, 0xd1, 0x25,
-    0x72, 0xf8, 0xf6, 0x64, 0x86, 0x68, 0x98, 0x16, 0xd4, 0xa4, 0x5c, 0xcc, 0x5d, 0x65, 0xb6, 0x92,
-    0x6c, 0x70, 0x48, 0x50, 0xfd, 0xed, 0xb9, 0xda, 0x5e, 0x15, 0x46, 0x57, 0xa7, 0x8d, 0x9d, 0x84,
-    0x90, 0xd8, 0xab, 0x00, 0x8c, 0xbc, 0xd3, 0x0a, 0xf7, 0xe4, 0x58, 0x05, 0xb8, 0xb3, 0x45, 0x06,
-    0xd0, 0x2c, 0x1e, 0x8f, 0xca, 0x3f, 0x0f, 0x02, 0xc1, 0xaf, 0xbd, 0x03, 0x01, 0x13, 0x8a, 0x6b,
-    0x3a, 0x91, 0x11, 0x41, 0x4f, 0x67, 0xdc, 0xea, 0x97, 0xf2, 0xcf, 0xce, 0xf0, 0xb4, 0xe6, 0x73,
-    0x96, 0xac, 0x74, 0x22, 0xe7, 0xad, 0x35, 0x85, 0xe2, 0xf9, 0x37, 0xe8, 0x1c, 0x75, 0xdf, 0x6e,
-    0x47, 0xf1, 0x1a, 0x71, 0x1d, 0x29, 0xc5, 0x89, 0x6f, 0xb7, 0x62, 0x0e, 0xaa, 0x18, 0xbe, 0x1b,
-    0xfc, 0x56, 0x3e, 0x4b, 0xc6, 0xd2, 0x79, 0x20, 0x9a, 0xdb, 0xc0, 0xfe, 0x78, 0xcd, 0x5a, 0xf4,
-    0x1f, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31, 0xb1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xec, 0x5f,
-    0x60, 0x51, 0x7f, 0xa9, 0x19, 0xb5, 0x4a, 0x0d, 0x2d, 0xe5, 0x7a, 0x9f, 0x93, 0xc9, 0x9c, 0xef,
-    0xa0, 0xe0, 0x3b, 0x4d, 0xae, 0x2a, 0xf5, 0xb0, 0xc8, 0xeb, 0xbb, 0x3c, 0x83, 0x53, 0x99, 0x61,
-    0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26, 0xe1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0c, 0x7d
-};
+#define AES_INV_SBOX(X) \
+    X(0x52) X(0x09) X(0x6a) X(0xd5) X(0x30) X(0x36) X(0xa5) X(0x38) X(0xbf) X(0x40) X(0xa3) X(0x9e) X(0x81) X(0xf3) X(0xd7) X(0xfb) \
+    X(0x7c) X(0xe3) X(0x39) X(0x82) X(0x9b) X(0x2f) X(0xff) X(0x87) X(0x34) X(0x8e) X(0x43) X(0x44) X(0xc4) X(0xde) X(0xe9) X(0xcb) \
+    X(0x54) X(0x7b) X(0x94) X(0x32) X(0xa6) X(0xc2) X(0x23) X(0x3d) X(0xee) X(0x4c) X(0x95) X(0x0b) X(0x42) X(0xfa) X(0xc3) X(0x4e) \
+    X(0x08) X(0x2e) X(0xa1) X(0x66) X(0x28) X(0xd9) X(0x24) X(0xb2) X(0x76) X(0x5b) X(0xa2) X(0x49) X(0x6d) X(0x8b) X(0xd1) X(0x25) \
+    X(0x72) X(0xf8) X(0xf6) X(0x64) X(0x86) X(0x68) X(0x98) X(0x16) X(0xd4) X(0xa4) X(0x5c) X(0xcc) X(0x5d) X(0x65) X(0xb6) X(0x92) \
+    X(0x6c) X(0x70) X(0x48) X(0x50) X(0xfd) X(0xed) X(0xb9) X(0xda) X(0x5e) X(0x15) X(0x46) X(0x57) X(0xa7) X(0x8d) X(0x9d) X(0x84) \
+    X(0x90) X(0xd8) X(0xab) X(0x00) X(0x8c) X(0xbc) X(0xd3) X(0x0a) X(0xf7) X(0xe4) X(0x58) X(0x05) X(0xb8) X(0xb3) X(0x45) X(0x06) \
+    X(0xd0) X(0x2c) X(0x1e) X(0x8f) X(0xca) X(0x3f) X(0x0f) X(0x02) X(0xc1) X(0xaf) X(0xbd) X(0x03) X(0x01) X(0x13) X(0x8a) X(0x6b) \
+    X(0x3a) X(0x91) X(0x11) X(0x41) X(0x4f) X(0x67) X(0xdc) X(0xea) X(0x97) X(0xf2) X(0xcf) X(0xce) X(0xf0) X(0xb4) X(0xe6) X(0x73) \
+    X(0x96) X(0xac) X(0x74) X(0x22) X(0xe7) X(0xad) X(0x35) X(0x85) X(0xe2) X(0xf9) X(0x37) X(0xe8) X(0x1c) X(0x75) X(0xdf) X(0x6e) \
+    X(0x47) X(0xf1) X(0x1a) X(0x71) X(0x1d) X(0x29) X(0xc5) X(0x89) X(0x6f) X(0xb7) X(0x62) X(0x0e) X(0xaa) X(0x18) X(0xbe) X(0x1b) \
+    X(0xfc) X(0x56) X(0x3e) X(0x4b) X(0xc6) X(0xd2) X(0x79) X(0x20) X(0x9a) X(0xdb) X(0xc0) X(0xfe) X(0x78) X(0xcd) X(0x5a) X(0xf4) \
+    X(0x1f) X(0xdd) X(0xa8) X(0x33) X(0x88) X(0x07) X(0xc7) X(0x31) X(0xb1) X(0x12) X(0x10) X(0x59) X(0x27) X(0x80) X(0xec) X(0x5f) \
+    X(0x60) X(0x51) X(0x7f) X(0xa9) X(0x19) X(0xb5) X(0x4a) X(0x0d) X(0x2d) X(0xe5) X(0x7a) X(0x9f) X(0x93) X(0xc9) X(0x9c) X(0xef) \
+    X(0xa0) X(0xe0) X(0x3b) X(0x4d) X(0xae) X(0x2a) X(0xf5) X(0xb0) X(0xc8) X(0xeb) X(0xbb) X(0x3c) X(0x83) X(0x53) X(0x99) X(0x61) \
+    X(0x17) X(0x2b) X(0x04) X(0x7e) X(0xba) X(0x77) X(0xd6) X(0x26) X(0xe1) X(0x69) X(0x14) X(0x63) X(0x55) X(0x21) X(0x0c) X(0x7d)
+
+#define AES_BYTE(s) s,
+
+static const unsigned char sbox[256] = { AES_SBOX(AES_BYTE) };
+static const unsigned char inv_sbox[256] = { AES_INV_SBOX(AES_BYTE) };
+
+/**
+ * Tablas T: SubBytes y MixColumns (o sus inversas) de un byte en una sola
+ * búsqueda. Cada entrada es la columna que aporta el byte (byte 0 en los 8
+ * bits altos); Te1..Te3 y Td1..Td3 son la misma rotada, para las filas de
+ * ShiftRows. Las genera el preprocesador a partir de las S-box.
+ */
+#define XT(x)   ((((x) << 1) ^ (((x) >> 7) * 0x1b)) & 0xff)     // x * 2 en GF(2^8)
+#define M2(x)   XT(x)
+#define M3(x)   (XT(x) ^ (x))
+#define M9(x)   (XT(XT(XT(x))) ^ (x))
+#define MB(x)   (XT(XT(XT(x))) ^ XT(x) ^ (x))
+#define MD(x)   (XT(XT(XT(x))) ^ XT(XT(x)) ^ (x))
+#define ME(x)   (XT(XT(XT(x))) ^ XT(XT(x)) ^ XT(x))
+#define PALABRA(a, b, c, d) \
+    (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+
+#define TE0(s) PALABRA(M2(s), s, s, M3(s)),
+#define TE1(s) PALABRA(M3(s), M2(s), s, s),
+#define TE2(s) PALABRA(s, M3(s), M2(s), s),
+#define TE3(s) PALABRA(s, s, M3(s), M2(s)),
+#define TD0(s) PALABRA(ME(s), M9(s), MD(s), MB(s)),
+#define TD1(s) PALABRA(MB(s), ME(s), M9(s), MD(s)),
+#define TD2(s) PALABRA(MD(s), MB(s), ME(s), M9(s)),
+#define TD3(s) PALABRA(M9(s), MD(s), MB(s), ME(s)),
+
+static const uint32_t Te0[256] = { AES_SBOX(TE0) };
+static const uint32_t Te1[256] = { AES_SBOX(TE1) };
+static const uint32_t Te2[256] = { AES_SBOX(TE2) };
+static const uint32_t Te3[256] = { AES_SBOX(TE3) };
+static const uint32_t Td0[256] = { AES_INV_SBOX(TD0) };
+static const uint32_t Td1[256] = { AES_INV_SBOX(TD1) };
+static const uint32_t Td2[256] = { AES_INV_SBOX(TD2) };
+static const uint32_t Td3[256] = { AES_INV_SBOX(TD3) };
 
 // Rcon (constantes para expansión de clave)
 static const unsigned char Rcon[11] = {
     0x8d, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36
 };
 
-// Estructura para manejar el estado de AES
-typedef struct {
-    unsigned char round_keys[176]; // 11 round keys de 16 bytes cada una
-} AES_Context;
-
 // Funciones auxiliares RENOMBRADAS
 void aes_escribir_salida(const char *msg) {
     int len = 0;
@@ -92,8 +135,63 @@ unsigned char gmul(unsigned char a, unsigned char b) {
     return p;
 }
 
-// Expansión de clave (Key Schedule)
-void aes_key_expansion(const unsigned char *key, AES_Context *ctx) {
+static inline uint32_t cargar_palabra(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void guardar_palabra(unsigned char *p, uint32_t w) {
+    p[0] = (unsigned char)(w >> 24);
+    p[1] = (unsigned char)(w >> 16);
+    p[2] = (unsigned char)(w >> 8);
+    p[3] = (unsigned char)w;
+}
+
+void inv_mix_columns(unsigned char *state);
+
+#ifdef AES_X86
+static int usar_aesni(void);
+
+// Una ronda del key schedule: w[i] = w[i-4] ^ w[i-1] para las 4 palabras,
+// con SubWord(RotWord()) ^ Rcon que calcula AESKEYGENASSIST en asistida
+__attribute__((target("aes")))
+static inline __m128i paso_clave_aesni(__m128i clave, __m128i asistida) {
+    asistida = _mm_shuffle_epi32(asistida, 0xff);
+    clave = _mm_xor_si128(clave, _mm_slli_si128(clave, 4));
+    clave = _mm_xor_si128(clave, _mm_slli_si128(clave, 4));
+    clave = _mm_xor_si128(clave, _mm_slli_si128(clave, 4));
+    return _mm_xor_si128(clave, asistida);
+}
+
+// Rcon tiene que ser inmediato
+#define RONDA_CLAVE_AESNI(k, i, rcon) \
+    k[i] = paso_clave_aesni(k[i - 1], _mm_aeskeygenassist_si128(k[i - 1], rcon))
+
+__attribute__((target("aes")))
+static void expandir_clave_aesni(const unsigned char *key, AES_Context *ctx) {
+    __m128i k[11];
+    k[0] = _mm_loadu_si128((const __m128i *)key);
+    RONDA_CLAVE_AESNI(k, 1, 0x01);
+    RONDA_CLAVE_AESNI(k, 2, 0x02);
+    RONDA_CLAVE_AESNI(k, 3, 0x04);
+    RONDA_CLAVE_AESNI(k, 4, 0x08);
+    RONDA_CLAVE_AESNI(k, 5, 0x10);
+    RONDA_CLAVE_AESNI(k, 6, 0x20);
+    RONDA_CLAVE_AESNI(k, 7, 0x40);
+    RONDA_CLAVE_AESNI(k, 8, 0x80);
+    RONDA_CLAVE_AESNI(k, 9, 0x1b);
+    RONDA_CLAVE_AESNI(k, 10, 0x36);
+
+    for (int round = 0; round <= 10; round++) {
+        __m128i inversa = k[10 - round];
+        if (round > 0 && round < 10) inversa = _mm_aesimc_si128(inversa);
+        _mm_storeu_si128((__m128i *)(ctx->round_keys + round * 16), k[round]);
+        _mm_storeu_si128((__m128i *)(ctx->round_keys_dec + round * 16), inversa);
+    }
+}
+#endif
+
+// Expansión de clave (Key Schedule) paso por paso
+static void expandir_clave_bytes(const unsigned char *key, AES_Context *ctx) {
     // Copiar la clave inicial
     for (int i = 0; i < 16; i++) {
         ctx->round_keys[i] = key[i];
@@ -128,6 +226,33 @@ void aes_key_expansion(const unsigned char *key, AES_Context *ctx) {
             ctx->round_keys[i*4 + j] = ctx->round_keys[(i-4)*4 + j] ^ temp[j];
         }
     }
+
+    // El descifrado usa el cifrado inverso equivalente: claves en orden
+    // inverso y, salvo la primera y la última, pasadas por InvMixColumns
+    for (int round = 0; round <= 10; round++) {
+        unsigned char *inversa = ctx->round_keys_dec + round * 16;
+        memcpy(inversa, ctx->round_keys + (10 - round) * 16, 16);
+        if (round > 0 && round < 10) inv_mix_columns(inversa);
+    }
+}
+
+// Las mismas claves en palabras para las tablas T
+static void claves_en_palabras(AES_Context *ctx) {
+    for (int i = 0; i < 44; i++) {
+        ctx->enc[i] = cargar_palabra(ctx->round_keys + i * 4);
+        ctx->dec[i] = cargar_palabra(ctx->round_keys_dec + i * 4);
+    }
+}
+
+// Expansión de clave (Key Schedule)
+void aes_key_expansion(const unsigned char *key, AES_Context *ctx) {
+#ifdef AES_X86
+    if (usar_aesni()) expandir_clave_aesni(key, ctx);
+    else expandir_clave_bytes(key, ctx);
+#else
+    expandir_clave_bytes(key, ctx);
+#endif
+    claves_en_palabras(ctx);
 }
 
 // AddRoundKey
@@ -232,8 +357,8 @@ void inv_mix_columns(unsigned char *state) {
     }
 }
 
-// Cifrar un bloque de 16 bytes
-void aes_encrypt_block(unsigned char *block, const AES_Context *ctx) {
+// Cifrar un bloque de 16 bytes, paso por paso (referencia para aes_verificar)
+void aes_encrypt_block_bytes(unsigned char *block, const AES_Context *ctx) {
     add_round_key(block, ctx->round_keys);
     
     for (int round = 1; round < 10; round++) {
@@ -248,8 +373,8 @@ void aes_encrypt_block(unsigned char *block, const AES_Context *ctx) {
     add_round_key(block, ctx->round_keys + 160);
 }
 
-// Descifrar un bloque de 16 bytes
-void aes_decrypt_block(unsigned char *block, const AES_Context *ctx) {
+// Descifrar un bloque de 16 bytes, paso por paso (referencia para aes_verificar)
+void aes_decrypt_block_bytes(unsigned char *block, const AES_Context *ctx) {
     add_round_key(block, ctx->round_keys + 160);
     inv_shift_rows(block);
     inv_sub_bytes(block);
@@ -264,64 +389,1236 @@ void aes_decrypt_block(unsigned char *block, const AES_Context *ctx) {
     add_round_key(block, ctx->round_keys);
 }
 
-// Cifrar archivo
-int cifrar_archivo_aes(const char *entrada, const char *salida, const unsigned char *clave) {
+/**
+ * Cifrar un bloque de 16 bytes con las tablas T: cada ronda son 16
+ * búsquedas y XOR por palabras (SubBytes, ShiftRows y MixColumns juntos).
+ * La última ronda no tiene MixColumns y usa la S-box sola.
+ */
+void aes_encrypt_block(unsigned char *block, const AES_Context *ctx) {
+    const uint32_t *rk = ctx->enc;
+    uint32_t s0 = cargar_palabra(block) ^ rk[0];
+    uint32_t s1 = cargar_palabra(block + 4) ^ rk[1];
+    uint32_t s2 = cargar_palabra(block + 8) ^ rk[2];
+    uint32_t s3 = cargar_palabra(block + 12) ^ rk[3];
+
+    for (int round = 1; round < 10; round++) {
+        rk += 4;
+        uint32_t t0 = Te0[s0 >> 24] ^ Te1[(s1 >> 16) & 0xff] ^ Te2[(s2 >> 8) & 0xff] ^ Te3[s3 & 0xff] ^ rk[0];
+        uint32_t t1 = Te0[s1 >> 24] ^ Te1[(s2 >> 16) & 0xff] ^ Te2[(s3 >> 8) & 0xff] ^ Te3[s0 & 0xff] ^ rk[1];
+        uint32_t t2 = Te0[s2 >> 24] ^ Te1[(s3 >> 16) & 0xff] ^ Te2[(s0 >> 8) & 0xff] ^ Te3[s1 & 0xff] ^ rk[2];
+        uint32_t t3 = Te0[s3 >> 24] ^ Te1[(s0 >> 16) & 0xff] ^ Te2[(s1 >> 8) & 0xff] ^ Te3[s2 & 0xff] ^ rk[3];
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+
+    rk += 4;
+    guardar_palabra(block, PALABRA(sbox[s0 >> 24], sbox[(s1 >> 16) & 0xff],
+                                   sbox[(s2 >> 8) & 0xff], sbox[s3 & 0xff]) ^ rk[0]);
+    guardar_palabra(block + 4, PALABRA(sbox[s1 >> 24], sbox[(s2 >> 16) & 0xff],
+                                       sbox[(s3 >> 8) & 0xff], sbox[s0 & 0xff]) ^ rk[1]);
+    guardar_palabra(block + 8, PALABRA(sbox[s2 >> 24], sbox[(s3 >> 16) & 0xff],
+                                       sbox[(s0 >> 8) & 0xff], sbox[s1 & 0xff]) ^ rk[2]);
+    guardar_palabra(block + 12, PALABRA(sbox[s3 >> 24], sbox[(s0 >> 16) & 0xff],
+                                        sbox[(s1 >> 8) & 0xff], sbox[s2 & 0xff]) ^ rk[3]);
+}
+
+// Descifrar un bloque de 16 bytes con el cifrado inverso equivalente (ShiftRows
+// inverso: cada columna toma las filas de las columnas anteriores)
+void aes_decrypt_block(unsigned char *block, const AES_Context *ctx) {
+    const uint32_t *rk = ctx->dec;
+    uint32_t s0 = cargar_palabra(block) ^ rk[0];
+    uint32_t s1 = cargar_palabra(block + 4) ^ rk[1];
+    uint32_t s2 = cargar_palabra(block + 8) ^ rk[2];
+    uint32_t s3 = cargar_palabra(block + 12) ^ rk[3];
+
+    for (int round = 1; round < 10; round++) {
+        rk += 4;
+        uint32_t t0 = Td0[s0 >> 24] ^ Td1[(s3 >> 16) & 0xff] ^ Td2[(s2 >> 8) & 0xff] ^ Td3[s1 & 0xff] ^ rk[0];
+        uint32_t t1 = Td0[s1 >> 24] ^ Td1[(s0 >> 16) & 0xff] ^ Td2[(s3 >> 8) & 0xff] ^ Td3[s2 & 0xff] ^ rk[1];
+        uint32_t t2 = Td0[s2 >> 24] ^ Td1[(s1 >> 16) & 0xff] ^ Td2[(s0 >> 8) & 0xff] ^ Td3[s3 & 0xff] ^ rk[2];
+        uint32_t t3 = Td0[s3 >> 24] ^ Td1[(s2 >> 16) & 0xff] ^ Td2[(s1 >> 8) & 0xff] ^ Td3[s0 & 0xff] ^ rk[3];
+        s0 = t0;
+        s1 = t1;
+        s2 = t2;
+        s3 = t3;
+    }
+
+    rk += 4;
+    guardar_palabra(block, PALABRA(inv_sbox[s0 >> 24], inv_sbox[(s3 >> 16) & 0xff],
+                                   inv_sbox[(s2 >> 8) & 0xff], inv_sbox[s1 & 0xff]) ^ rk[0]);
+    guardar_palabra(block + 4, PALABRA(inv_sbox[s1 >> 24], inv_sbox[(s0 >> 16) & 0xff],
+                                       inv_sbox[(s3 >> 8) & 0xff], inv_sbox[s2 & 0xff]) ^ rk[1]);
+    guardar_palabra(block + 8, PALABRA(inv_sbox[s2 >> 24], inv_sbox[(s1 >> 16) & 0xff],
+                                       inv_sbox[(s0 >> 8) & 0xff], inv_sbox[s3 & 0xff]) ^ rk[2]);
+    guardar_palabra(block + 12, PALABRA(inv_sbox[s3 >> 24], inv_sbox[(s2 >> 16) & 0xff],
+                                        inv_sbox[(s1 >> 8) & 0xff], inv_sbox[s0 & 0xff]) ^ rk[3]);
+}
+
+#ifdef AES_X86
+/**
+ * Con AES-NI cada bloque pasa por 10 AESENC/AESDEC que dependen uno del
+ * anterior; con 8 bloques a la vez las rondas de bloques distintos se
+ * superponen en el pipeline. Los bucles sobre los 8 se desenrollan para que
+ * los bloques queden en registros.
+ */
+#define AESNI_EN_VUELO 8
+
+__attribute__((target("aes")))
+static void cifrar_bloques_aesni(unsigned char *datos, size_t n, const AES_Context *ctx) {
+    __m128i k[11];
+    for (int i = 0; i <= 10; i++) k[i] = _mm_loadu_si128((const __m128i *)(ctx->round_keys + i * 16));
+
+    size_t i = 0;
+    for (; i + AESNI_EN_VUELO <= n; i += AESNI_EN_VUELO) {
+        __m128i *p = (__m128i *)(datos + i * AES_BLOCK_SIZE);
+        __m128i b[AESNI_EN_VUELO];
+        #pragma GCC unroll 8
+        for (int j = 0; j < AESNI_EN_VUELO; j++) b[j] = _mm_xor_si128(_mm_loadu_si128(p + j), k[0]);
+        for (int round = 1; round < 10; round++) {
+            #pragma GCC unroll 8
+            for (int j = 0; j < AESNI_EN_VUELO; j++) b[j] = _mm_aesenc_si128(b[j], k[round]);
+        }
+        #pragma GCC unroll 8
+        for (int j = 0; j < AESNI_EN_VUELO; j++) _mm_storeu_si128(p + j, _mm_aesenclast_si128(b[j], k[10]));
+    }
+    for (; i < n; i++) {
+        __m128i *p = (__m128i *)(datos + i * AES_BLOCK_SIZE);
+        __m128i b = _mm_xor_si128(_mm_loadu_si128(p), k[0]);
+        for (int round = 1; round < 10; round++) b = _mm_aesenc_si128(b, k[round]);
+        _mm_storeu_si128(p, _mm_aesenclast_si128(b, k[10]));
+    }
+}
+
+__attribute__((target("aes")))
+static void descifrar_bloques_aesni(unsigned char *datos, size_t n, const AES_Context *ctx) {
+    __m128i k[11];
+    for (int i = 0; i <= 10; i++) k[i] = _mm_loadu_si128((const __m128i *)(ctx->round_keys_dec + i * 16));
+
+    size_t i = 0;
+    for (; i + AESNI_EN_VUELO <= n; i += AESNI_EN_VUELO) {
+        __m128i *p = (__m128i *)(datos + i * AES_BLOCK_SIZE);
+        __m128i b[AESNI_EN_VUELO];
+        #pragma GCC unroll 8
+        for (int j = 0; j < AESNI_EN_VUELO; j++) b[j] = _mm_xor_si128(_mm_loadu_si128(p + j), k[0]);
+        for (int round = 1; round < 10; round++) {
+            #pragma GCC unroll 8
+            for (int j = 0; j < AESNI_EN_VUELO; j++) b[j] = _mm_aesdec_si128(b[j], k[round]);
+        }
+        #pragma GCC unroll 8
+        for (int j = 0; j < AESNI_EN_VUELO; j++) _mm_storeu_si128(p + j, _mm_aesdeclast_si128(b[j], k[10]));
+    }
+    for (; i < n; i++) {
+        __m128i *p = (__m128i *)(datos + i * AES_BLOCK_SIZE);
+        __m128i b = _mm_xor_si128(_mm_loadu_si128(p), k[0]);
+        for (int round = 1; round < 10; round++) b = _mm_aesdec_si128(b, k[round]);
+        _mm_storeu_si128(p, _mm_aesdeclast_si128(b, k[10]));
+    }
+}
+
+/**
+ * CTR con AES-NI: los bloques de contador se arman en registros y el flujo de
+ * claves se mezcla con los datos sin pasar por memoria. n bloques completos
+ * desde el número de bloque contador.
+ */
+__attribute__((target("aes")))
+static void ctr_bloques_aesni(unsigned char *datos, size_t n, const AES_Context *ctx,
+                              const unsigned char *nonce, uint64_t contador) {
+    __m128i k[11];
+    for (int i = 0; i <= 10; i++) k[i] = _mm_loadu_si128((const __m128i *)(ctx->round_keys + i * 16));
+    uint64_t mitad;
+    memcpy(&mitad, nonce, 8);
+
+    size_t i = 0;
+    for (; i + AESNI_EN_VUELO <= n; i += AESNI_EN_VUELO) {
+        __m128i *p = (__m128i *)(datos + i * AES_BLOCK_SIZE);
+        __m128i b[AESNI_EN_VUELO];
+        #pragma GCC unroll 8
+        for (int j = 0; j < AESNI_EN_VUELO; j++) {
+            __m128i c = _mm_set_epi64x((long long)__builtin_bswap64(contador + i + j), (long long)mitad);
+            b[j] = _mm_xor_si128(c, k[0]);
+        }
+        for (int round = 1; round < 10; round++) {
+            #pragma GCC unroll 8
+            for (int j = 0; j < AESNI_EN_VUELO; j++) b[j] = _mm_aesenc_si128(b[j], k[round]);
+        }
+        #pragma GCC unroll 8
+        for (int j = 0; j < AESNI_EN_VUELO; j++) {
+            __m128i flujo = _mm_aesenclast_si128(b[j], k[10]);
+            _mm_storeu_si128(p + j, _mm_xor_si128(_mm_loadu_si128(p + j), flujo));
+        }
+    }
+    for (; i < n; i++) {
+        __m128i *p = (__m128i *)(datos + i * AES_BLOCK_SIZE);
+        __m128i b = _mm_set_epi64x((long long)__builtin_bswap64(contador + i), (long long)mitad);
+        b = _mm_xor_si128(b, k[0]);
+        for (int round = 1; round < 10; round++) b = _mm_aesenc_si128(b, k[round]);
+        _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), _mm_aesenclast_si128(b, k[10])));
+    }
+}
+#endif
+
+static void cifrar_bloques_bytes(unsigned char *datos, size_t n, const AES_Context *ctx) {
+    for (size_t i = 0; i < n; i++) aes_encrypt_block_bytes(datos + i * AES_BLOCK_SIZE, ctx);
+}
+
+static void descifrar_bloques_bytes(unsigned char *datos, size_t n, const AES_Context *ctx) {
+    for (size_t i = 0; i < n; i++) aes_decrypt_block_bytes(datos + i * AES_BLOCK_SIZE, ctx);
+}
+
+static void cifrar_bloques_tablas(unsigned char *datos, size_t n, const AES_Context *ctx) {
+    for (size_t i = 0; i < n; i++) aes_encrypt_block(datos + i * AES_BLOCK_SIZE, ctx);
+}
+
+static void descifrar_bloques_tablas(unsigned char *datos, size_t n, const AES_Context *ctx) {
+    for (size_t i = 0; i < n; i++) aes_decrypt_block(datos + i * AES_BLOCK_SIZE, ctx);
+}
+
+#ifdef AES_X86
+/**
+ * Antes de usar AES-NI se compara una vez con las tablas T: key schedule,
+ * cifrado, descifrado y CTR sobre bloques de sobra para el camino de 8 en
+ * vuelo y el de a uno
+ */
+static int aesni_coincide(void) {
+    enum { BLOQUES = AESNI_EN_VUELO + 3 };
+    unsigned char clave[AES_KEY_SIZE], nonce[8];
+    for (int i = 0; i < AES_KEY_SIZE; i++) clave[i] = (unsigned char)(i * 29 + 7);
+    for (int i = 0; i < 8; i++) nonce[i] = (unsigned char)(0xf0 + i);
+
+    AES_Context ctx, referencia;
+    expandir_clave_aesni(clave, &ctx);
+    expandir_clave_bytes(clave, &referencia);
+    claves_en_palabras(&referencia);
+    if (memcmp(ctx.round_keys, referencia.round_keys, sizeof(ctx.round_keys)) != 0 ||
+        memcmp(ctx.round_keys_dec, referencia.round_keys_dec, sizeof(ctx.round_keys_dec)) != 0) {
+        return 0;
+    }
+
+    unsigned char a[BLOQUES * AES_BLOCK_SIZE], b[BLOQUES * AES_BLOCK_SIZE];
+    for (size_t i = 0; i < sizeof(a); i++) a[i] = b[i] = (unsigned char)(i * 131 + 17);
+    cifrar_bloques_aesni(a, BLOQUES, &ctx);
+    cifrar_bloques_tablas(b, BLOQUES, &referencia);
+    if (memcmp(a, b, sizeof(a)) != 0) return 0;
+    descifrar_bloques_aesni(a, BLOQUES, &ctx);
+    descifrar_bloques_tablas(b, BLOQUES, &referencia);
+    if (memcmp(a, b, sizeof(a)) != 0) return 0;
+
+    // CTR: el flujo de claves armado a mano con las tablas
+    uint64_t contador = 0xfffffffffffffffaULL;
+    for (int j = 0; j < BLOQUES; j++) {
+        uint64_t c = __builtin_bswap64(contador + j);
+        memcpy(b + j * AES_BLOCK_SIZE, nonce, 8);
+        memcpy(b + j * AES_BLOCK_SIZE + 8, &c, 8);
+    }
+    cifrar_bloques_tablas(b, BLOQUES, &referencia);
+    for (size_t i = 0; i < sizeof(b); i++) b[i] ^= a[i];
+    ctr_bloques_aesni(a, BLOQUES, &ctx, nonce, contador);
+    return memcmp(a, b, sizeof(a)) == 0;
+}
+
+static int aesni_disponible = 0;
+static pthread_once_t aesni_una_vez = PTHREAD_ONCE_INIT;
+
+static void elegir_aesni(void) {
+    if (!__builtin_cpu_supports("aes")) return;
+    aesni_disponible = aesni_coincide();
+    if (!aesni_disponible) aes_escribir_salida("Aviso: AES-NI no coincide con las tablas T, se usan las tablas\n");
+}
+
+// AES-NI si la CPU lo tiene (CPUID) y da lo mismo que las tablas T
+static int usar_aesni(void) {
+    pthread_once(&aesni_una_vez, elegir_aesni);
+    return aesni_disponible;
+}
+#endif
+
+void aes_encrypt_blocks(unsigned char *datos, size_t n, const AES_Context *ctx) {
+#ifdef AES_X86
+    if (usar_aesni()) {
+        cifrar_bloques_aesni(datos, n, ctx);
+        return;
+    }
+#endif
+    cifrar_bloques_tablas(datos, n, ctx);
+}
+
+void aes_decrypt_blocks(unsigned char *datos, size_t n, const AES_Context *ctx) {
+#ifdef AES_X86
+    if (usar_aesni()) {
+        descifrar_bloques_aesni(datos, n, ctx);
+        return;
+    }
+#endif
+    descifrar_bloques_tablas(datos, n, ctx);
+}
+
+static void ctr_generico(const AES_Context *ctx, const unsigned char *nonce, uint64_t posicion,
+                         unsigned char *datos, size_t n);
+
+/**
+ * Comprueba el cifrado y el descifrado de todas las implementaciones con el
+ * vector de FIPS-197, apéndice C.1: paso por paso, tablas T y, si la CPU lo
+ * tiene, AES-NI (con más bloques que los que van en vuelo, para probar
+ * también la cola)
+ */
+int aes_verificar(void) {
+    static const unsigned char clave[16] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+    };
+    static const unsigned char texto[16] = {
+        0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+    };
+    static const unsigned char cifrado[16] = {
+        0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a
+    };
+    void (*cifrar[3])(unsigned char *, size_t, const AES_Context *) = {
+        cifrar_bloques_bytes, cifrar_bloques_tablas, aes_encrypt_blocks
+    };
+    void (*descifrar[3])(unsigned char *, size_t, const AES_Context *) = {
+        descifrar_bloques_bytes, descifrar_bloques_tablas, aes_decrypt_blocks
+    };
+
+    // El key schedule de AES-NI tiene que dar las mismas claves
+    AES_Context ctx, referencia;
+    aes_key_expansion(clave, &ctx);
+    expandir_clave_bytes(clave, &referencia);
+    if (memcmp(ctx.round_keys, referencia.round_keys, sizeof(ctx.round_keys)) != 0 ||
+        memcmp(ctx.round_keys_dec, referencia.round_keys_dec, sizeof(ctx.round_keys_dec)) != 0) {
+        return -1;
+    }
+
+    enum { BLOQUES = 11 };
+    unsigned char datos[BLOQUES * AES_BLOCK_SIZE];
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < BLOQUES; j++) memcpy(datos + j * AES_BLOCK_SIZE, texto, 16);
+        cifrar[i](datos, BLOQUES, &ctx);
+        for (int j = 0; j < BLOQUES; j++) {
+            if (memcmp(datos + j * AES_BLOCK_SIZE, cifrado, 16) != 0) return -1;
+        }
+        descifrar[i](datos, BLOQUES, &ctx);
+        for (int j = 0; j < BLOQUES; j++) {
+            if (memcmp(datos + j * AES_BLOCK_SIZE, texto, 16) != 0) return -1;
+        }
+    }
+
+    // CTR desde una posición que no cae en un bloque: el camino rápido
+    // tiene que dar el mismo flujo de claves que el genérico
+    unsigned char ctr[BLOQUES * AES_BLOCK_SIZE];
+    memset(ctr, 0, sizeof(ctr));
+    memset(datos, 0, sizeof(datos));
+    aes_ctr_aplicar(&ctx, texto, 37, ctr, sizeof(ctr) - 5);
+    ctr_generico(&ctx, texto, 37, datos, sizeof(datos) - 5);
+    return memcmp(ctr, datos, sizeof(ctr)) == 0 ? 0 : -1;
+}
+
+// Magia de los archivos cifrados con --mode ctr (ver más abajo)
+static const unsigned char magia_ctr[AES_CTR_TAM_MAGIA] = { 'A', 'E', 'S', '-', 'C', 'T', 'R', 0x01 };
+
+int aes_ctr_es_encabezado(const unsigned char *encabezado) {
+    return memcmp(encabezado, magia_ctr, AES_CTR_TAM_MAGIA) == 0;
+}
+
+// Un encabezado de ECB que en realidad es de CTR: avisa en vez de descifrar basura
+static int encabezado_ctr(const void *encabezado, size_t n) {
+    if (n < AES_CTR_TAM_MAGIA || !aes_ctr_es_encabezado(encabezado)) return 0;
+    aes_escribir_salida("Error: el archivo se cifró con --mode ctr\n");
+    return 1;
+}
+
+// Tamaño del archivo cifrado: encabezado + datos con padding al bloque
+long aes_tamano_cifrado(long file_size) {
+    long bloques = (file_size + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+    return (long)sizeof(long) + bloques * AES_BLOCK_SIZE;
+}
+
+// pread de n bytes desde pos; menos solo si la entrada termina antes
+static ssize_t leer_completo_en(int fd, void *buf, size_t n, off_t pos) {
+    size_t total = 0;
+    while (total < n) {
+        ssize_t r = pread(fd, (unsigned char *)buf + total, n - total, pos + total);
+        if (r < 0) return -1;
+        if (r == 0) break;
+        total += r;
+    }
+    return total;
+}
+
+// Un rango que no se pudo leer entero: la salida ya reservada quedaría con
+// bytes sin procesar, así que el archivo falla
+static int rango_incompleto(ssize_t bytes_leidos) {
+    if (bytes_leidos < 0) aes_escribir_salida("Error al leer\n");
+    else aes_escribir_salida("Error: la entrada terminó antes de lo esperado\n");
+    return -1;
+}
+
+/**
+ * Cifra el rango [inicio, inicio + longitud) de la entrada y lo escribe en su
+ * posición de la salida (desplazada por el encabezado). Cada bloque de ECB es
+ * independiente, así que varios hilos pueden cifrar rangos distintos a la vez.
+ * inicio debe ser múltiplo de AES_BLOCK_SIZE.
+ */
+int cifrar_rango_aes(int fd_in, int fd_out, const AES_Context *ctx, long inicio, long longitud) {
+    unsigned char buffer[BUFFER_SIZE];
+    long procesados = 0;
+
+    while (procesados < longitud) {
+        long pedir = longitud - procesados;
+        if (pedir > BUFFER_SIZE) pedir = BUFFER_SIZE;
+
+        ssize_t bytes_leidos = leer_completo_en(fd_in, buffer, pedir, inicio + procesados);
+        if (bytes_leidos != pedir) return rango_incompleto(bytes_leidos);
+
+        // Aplicar padding PKCS#7 al último bloque incompleto
+        ssize_t resto = bytes_leidos % AES_BLOCK_SIZE;
+        if (resto != 0) {
+            unsigned char padding = AES_BLOCK_SIZE - resto;
+            for (ssize_t i = bytes_leidos; i < bytes_leidos + padding; i++) {
+                buffer[i] = padding;
+            }
+            bytes_leidos += padding;
+        }
+
+        aes_encrypt_blocks(buffer, bytes_leidos / AES_BLOCK_SIZE, ctx);
+
+        off_t destino = (off_t)sizeof(long) + inicio + procesados;
+        if (pwrite(fd_out, buffer, bytes_leidos, destino) != bytes_leidos) {
+            aes_escribir_salida("Error al escribir\n");
+            return -1;
+        }
+
+        procesados += bytes_leidos;
+    }
+
+    return 0;
+}
+
+/**
+ * Descifra el rango [inicio, inicio + longitud) de los datos cifrados (sin
+ * contar el encabezado) y lo escribe en la misma posición de la salida,
+ * recortando el padding que sobrepase file_size.
+ */
+int descifrar_rango_aes(int fd_in, int fd_out, const AES_Context *ctx, long inicio, long longitud, long file_size) {
+    unsigned char buffer[BUFFER_SIZE];
+    long procesados = 0;
+
+    while (procesados < longitud) {
+        long pedir = longitud - procesados;
+        if (pedir > BUFFER_SIZE) pedir = BUFFER_SIZE;
+
+        off_t origen = (off_t)sizeof(long) + inicio + procesados;
+        ssize_t bytes_leidos = leer_completo_en(fd_in, buffer, pedir, origen);
+        if (bytes_leidos != pedir) return rango_incompleto(bytes_leidos);
+        // Un resto que no llega a bloque al final de los datos no se descifra
+        bytes_leidos -= bytes_leidos % AES_BLOCK_SIZE;
+        if (bytes_leidos == 0) break;
+
+        aes_decrypt_blocks(buffer, bytes_leidos / AES_BLOCK_SIZE, ctx);
+
+        // Calcular cuántos bytes escribir (remover padding en el último bloque)
+        long pos = inicio + procesados;
+        ssize_t bytes_a_escribir = bytes_leidos;
+        if (pos + bytes_a_escribir > file_size) {
+            bytes_a_escribir = file_size > pos ? file_size - pos : 0;
+        }
+
+        if (bytes_a_escribir > 0 &&
+            pwrite(fd_out, buffer, bytes_a_escribir, pos) != bytes_a_escribir) {
+            aes_escribir_salida("Error al escribir\n");
+            return -1;
+        }
+
+        procesados += bytes_leidos;
+    }
+
+    return 0;
+}
+
+// Escribir tamaño original (para remover padding al descifrar)
+int aes_escribir_encabezado(int fd_out, long file_size) {
+    if (pwrite(fd_out, &file_size, sizeof(long), 0) != sizeof(long)) return -1;
+    return 0;
+}
+
+// Leer tamaño original
+int aes_leer_encabezado(int fd_in, long *file_size) {
+    if (pread(fd_in, file_size, sizeof(long), 0) != sizeof(long)) return -1;
+    if (encabezado_ctr(file_size, sizeof(long))) return -1;
+    return 0;
+}
+
+// Tamaño original según el padding del último bloque cifrado (-1 si es inválido)
+static long tamano_por_padding(const AES_Context *ctx, const unsigned char *ultimo, long datos) {
+    unsigned char bloque[AES_BLOCK_SIZE];
+    memcpy(bloque, ultimo, AES_BLOCK_SIZE);
+    aes_decrypt_block(bloque, ctx);
+    
+    unsigned char padding = bloque[AES_BLOCK_SIZE - 1];
+    if (padding < 1 || padding > AES_BLOCK_SIZE) return -1;
+    return datos - padding;
+}
+
+/**
+ * aes_resolver_tamano - Tamaño original de un archivo cifrado sin conocerlo
+ *
+ * Si el encabezado tiene AES_TAMANO_DESCONOCIDO, el tamaño sale del padding
+ * del último de los datos bloques (datos múltiplo de AES_BLOCK_SIZE).
+ * Retorna: 0, o -1 si no se pudo leer o el padding es inválido
+ */
+int aes_resolver_tamano(int fd_in, const AES_Context *ctx, long datos, long *file_size) {
+    if (*file_size != AES_TAMANO_DESCONOCIDO) return 0;
+    if (datos < AES_BLOCK_SIZE) return -1;
+    
+    unsigned char ultimo[AES_BLOCK_SIZE];
+    off_t pos = (off_t)sizeof(long) + datos - AES_BLOCK_SIZE;
+    if (pread(fd_in, ultimo, AES_BLOCK_SIZE, pos) != AES_BLOCK_SIZE) return -1;
+    
+    *file_size = tamano_por_padding(ctx, ultimo, datos);
+    return *file_size < 0 ? -1 : 0;
+}
+
+// Cifrar desde fd_in hacia fd_out
+int cifrar_aes_fd(int fd_in, int fd_out, const unsigned char *clave) {
     AES_Context ctx;
     aes_key_expansion(clave, &ctx);
     
-    int fd_in = open(entrada, O_RDONLY);
-    if (fd_in == -1) {
-        aes_escribir_salida("Error: No se pudo abrir archivo de entrada\n");
+    // Obtener tamaño del archivo
+    struct stat st;
+    fstat(fd_in, &st);
+    long file_size = st.st_size;
+    
+    if (aes_escribir_encabezado(fd_out, file_size) != 0) return -1;
+    return cifrar_rango_aes(fd_in, fd_out, &ctx, 0, file_size);
+}
+
+// Descifrar desde fd_in hacia fd_out
+int descifrar_aes_fd(int fd_in, int fd_out, const unsigned char *clave) {
+    AES_Context ctx;
+    aes_key_expansion(clave, &ctx);
+    
+    // Uno cifrado con --mode ctr ya se avisó; uno vacío o corto sigue como antes
+    long file_size = 0;
+    if (aes_leer_encabezado(fd_in, &file_size) != 0 &&
+        aes_ctr_es_encabezado((const unsigned char *)&file_size)) return -1;
+    
+    struct stat st;
+    fstat(fd_in, &st);
+    long datos = st.st_size - (long)sizeof(long);
+    
+    if (datos <= 0) return 0;
+    if (aes_resolver_tamano(fd_in, &ctx, datos - datos % AES_BLOCK_SIZE, &file_size) != 0) {
+        aes_escribir_salida("Error: padding inválido\n");
         return -1;
     }
+    return descifrar_rango_aes(fd_in, fd_out, &ctx, 0, datos, file_size);
+}
+
+// Cifrar desde fd_in hacia fd_out con lectura y escritura en tubería
+int cifrar_aes_tuberia(int fd_in, int fd_out, const unsigned char *clave, const ConfigTuberia *config) {
+    AES_Context ctx;
+    aes_key_expansion(clave, &ctx);
     
-    int fd_out = open(salida, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-    if (fd_out == -1) {
-        aes_escribir_salida("Error: No se pudo crear archivo de salida\n");
-        close(fd_in);
+    struct stat st;
+    fstat(fd_in, &st);
+    long file_size = st.st_size;
+    
+    LectorTuberia *lector = lector_tuberia_crear(fd_in, config);
+    if (!lector) return -1;
+    EscritorTuberia *escritor = escritor_tuberia_crear(fd_out, config);
+    if (!escritor) {
+        lector_tuberia_destruir(lector);
+        return -1;
+    }
+    
+    int resultado = escritor_tuberia_escribir(escritor, &file_size, sizeof(long));
+    
+    unsigned char buffer[BUFFER_SIZE];
+    ssize_t bytes_leidos = 0;
+    long leidos = 0;
+    while (resultado == 0 && (bytes_leidos = lector_tuberia_leer(lector, buffer, BUFFER_SIZE)) > 0) {
+        leidos += bytes_leidos;
+        // Aplicar padding PKCS#7 al último bloque incompleto
+        ssize_t resto = bytes_leidos % AES_BLOCK_SIZE;
+        if (resto != 0) {
+            unsigned char padding = AES_BLOCK_SIZE - resto;
+            memset(buffer + bytes_leidos, padding, padding);
+            bytes_leidos += padding;
+        }
+        
+        aes_encrypt_blocks(buffer, bytes_leidos / AES_BLOCK_SIZE, &ctx);
+        resultado = escritor_tuberia_escribir(escritor, buffer, bytes_leidos);
+    }
+    // El encabezado ya dice file_size: menos datos serían un archivo corrupto
+    int incompleto = resultado == 0 && (bytes_leidos < 0 || leidos != file_size);
+    
+    lector_tuberia_destruir(lector);
+    if (escritor_tuberia_cerrar(escritor) != 0) resultado = -1;
+    if (resultado != 0) aes_escribir_salida("Error al escribir\n");
+    if (incompleto) return rango_incompleto(bytes_leidos);
+    return resultado;
+}
+
+// Descifrar desde fd_in hacia fd_out con lectura y escritura en tubería
+int descifrar_aes_tuberia(int fd_in, int fd_out, const unsigned char *clave, const ConfigTuberia *config) {
+    AES_Context ctx;
+    aes_key_expansion(clave, &ctx);
+    
+    LectorTuberia *lector = lector_tuberia_crear(fd_in, config);
+    if (!lector) return -1;
+    
+    long file_size = 0;
+    if (lector_tuberia_leer(lector, &file_size, sizeof(long)) != sizeof(long)) {
+        lector_tuberia_destruir(lector);
+        return 0;
+    }
+    if (encabezado_ctr(&file_size, sizeof(long))) {
+        lector_tuberia_destruir(lector);
         return -1;
     }
     
-    // Obtener tamaño del archivo
     struct stat st;
     fstat(fd_in, &st);
-    long file_size = st.st_size;
+    long datos = st.st_size - (long)sizeof(long);
+    if (aes_resolver_tamano(fd_in, &ctx, datos - datos % AES_BLOCK_SIZE, &file_size) != 0) {
+        aes_escribir_salida("Error: padding inválido\n");
+        lector_tuberia_destruir(lector);
+        return -1;
+    }
     
-    // Escribir tamaño original (para remover padding al descifrar)
-    write(fd_out, &file_size, sizeof(long));
+    EscritorTuberia *escritor = escritor_tuberia_crear(fd_out, config);
+    if (!escritor) {
+        lector_tuberia_destruir(lector);
+        return -1;
+    }
     
-    unsigned char buffer[AES_BLOCK_SIZE];
-    ssize_t bytes_leidos;
+    unsigned char buffer[BUFFER_SIZE];
+    ssize_t bytes_leidos = 0;
+    long pos = 0;
+    int resultado = 0;
+    while (resultado == 0 && (bytes_leidos = lector_tuberia_leer(lector, buffer, BUFFER_SIZE)) > 0) {
+        bytes_leidos -= bytes_leidos % AES_BLOCK_SIZE;
+        if (bytes_leidos <= 0) break;
+        
+        aes_decrypt_blocks(buffer, bytes_leidos / AES_BLOCK_SIZE, &ctx);
+        
+        // Remover padding: no escribir más allá del tamaño original
+        ssize_t bytes_a_escribir = bytes_leidos;
+        if (pos + bytes_a_escribir > file_size) {
+            bytes_a_escribir = file_size > pos ? file_size - pos : 0;
+        }
+        if (bytes_a_escribir > 0) {
+            resultado = escritor_tuberia_escribir(escritor, buffer, bytes_a_escribir);
+        }
+        pos += bytes_leidos;
+    }
+    int incompleto = resultado == 0 && (bytes_leidos < 0 || pos < file_size);
     
-    while ((bytes_leidos = read(fd_in, buffer, AES_BLOCK_SIZE)) > 0) {
-        // Aplicar padding PKCS#7 si es necesario
-        if (bytes_leidos < AES_BLOCK_SIZE) {
-            unsigned char padding = AES_BLOCK_SIZE - bytes_leidos;
-            for (int i = bytes_leidos; i < AES_BLOCK_SIZE; i++) {
-                buffer[i] = padding;
-            }
+    lector_tuberia_destruir(lector);
+    if (escritor_tuberia_cerrar(escritor) != 0) resultado = -1;
+    if (resultado != 0) aes_escribir_salida("Error al escribir\n");
+    if (incompleto) return rango_incompleto(bytes_leidos);
+    return resultado;
+}
+
+/**
+ * Cifrar de forma secuencial, sin pread/pwrite: sirve con tuberías (-i -,
+ * -o -). Si la entrada no es un archivo regular su tamaño no se sabe de
+ * antemano: el encabezado lleva AES_TAMANO_DESCONOCIDO y el último bloque
+ * siempre tiene padding (uno entero si los datos ya estaban alineados).
+ */
+int cifrar_aes_flujo(int fd_in, int fd_out, const unsigned char *clave) {
+    AES_Context ctx;
+    aes_key_expansion(clave, &ctx);
+    
+    struct stat st;
+    long file_size = AES_TAMANO_DESCONOCIDO;
+    if (fstat(fd_in, &st) == 0 && S_ISREG(st.st_mode)) file_size = st.st_size;
+    
+    if (escribir_completo(fd_out, &file_size, sizeof(long)) != 0) {
+        aes_escribir_salida("Error al escribir\n");
+        return -1;
+    }
+    
+    unsigned char buffer[BUFFER_SIZE + AES_BLOCK_SIZE];
+    while (1) {
+        ssize_t bytes_leidos = leer_completo(fd_in, buffer, BUFFER_SIZE);
+        if (bytes_leidos < 0) return -1;
+        int final = bytes_leidos < BUFFER_SIZE;
+        
+        // Aplicar padding PKCS#7 al último bloque incompleto (siempre, sin tamaño)
+        ssize_t resto = bytes_leidos % AES_BLOCK_SIZE;
+        if (final && (resto != 0 || file_size == AES_TAMANO_DESCONOCIDO)) {
+            unsigned char padding = AES_BLOCK_SIZE - resto;
+            memset(buffer + bytes_leidos, padding, padding);
+            bytes_leidos += padding;
         }
         
-        aes_encrypt_block(buffer, &ctx);
+        aes_encrypt_blocks(buffer, bytes_leidos / AES_BLOCK_SIZE, &ctx);
+        if (escribir_completo(fd_out, buffer, bytes_leidos) != 0) {
+            aes_escribir_salida("Error al escribir\n");
+            return -1;
+        }
+        if (final) return 0;
+    }
+}
+
+/**
+ * Descifrar de forma secuencial. Con tamaño desconocido el último bloque se
+ * retiene hasta llegar al final, para sacarle el padding.
+ */
+int descifrar_aes_flujo(int fd_in, int fd_out, const unsigned char *clave) {
+    AES_Context ctx;
+    aes_key_expansion(clave, &ctx);
+    
+    long file_size = 0;
+    if (leer_completo(fd_in, &file_size, sizeof(long)) != sizeof(long)) return 0;
+    if (encabezado_ctr(&file_size, sizeof(long))) return -1;
+    int desconocido = file_size == AES_TAMANO_DESCONOCIDO;
+    
+    unsigned char buffer[BUFFER_SIZE];
+    unsigned char retenido[AES_BLOCK_SIZE];
+    int hay_retenido = 0;
+    long pos = 0;
+    ssize_t bytes_leidos;
+    while ((bytes_leidos = leer_completo(fd_in, buffer, BUFFER_SIZE)) > 0) {
+        bytes_leidos -= bytes_leidos % AES_BLOCK_SIZE;
+        if (bytes_leidos <= 0) break;
+        
+        aes_decrypt_blocks(buffer, bytes_leidos / AES_BLOCK_SIZE, &ctx);
         
-        if (write(fd_out, buffer, AES_BLOCK_SIZE) != AES_BLOCK_SIZE) {
+        ssize_t bytes_a_escribir = bytes_leidos;
+        if (desconocido) {
+            if (hay_retenido && escribir_completo(fd_out, retenido, AES_BLOCK_SIZE) != 0) return -1;
+            bytes_a_escribir -= AES_BLOCK_SIZE;
+            memcpy(retenido, buffer + bytes_a_escribir, AES_BLOCK_SIZE);
+            hay_retenido = 1;
+        } else if (pos + bytes_a_escribir > file_size) {
+            // Remover padding: no escribir más allá del tamaño original
+            bytes_a_escribir = file_size > pos ? file_size - pos : 0;
+        }
+        if (bytes_a_escribir > 0 && escribir_completo(fd_out, buffer, bytes_a_escribir) != 0) {
             aes_escribir_salida("Error al escribir\n");
-            close(fd_in);
-            close(fd_out);
             return -1;
         }
+        pos += bytes_leidos;
     }
+    if (bytes_leidos < 0 || (!desconocido && pos < file_size)) return rango_incompleto(bytes_leidos);
     
-    close(fd_in);
-    close(fd_out);
+    if (desconocido) {
+        unsigned char padding = hay_retenido ? retenido[AES_BLOCK_SIZE - 1] : 0;
+        if (padding < 1 || padding > AES_BLOCK_SIZE) {
+            aes_escribir_salida("Error: padding inválido\n");
+            return -1;
+        }
+        if (escribir_completo(fd_out, retenido, AES_BLOCK_SIZE - padding) != 0) return -1;
+    }
     return 0;
 }
 
-// Descifrar archivo
-int descifrar_archivo_aes(const char *entrada, const char *salida, const unsigned char *clave) {
+// Cifra n bytes de entrada sobre salida (aes_tamano_cifrado(n) bytes)
+static void cifrar_en_memoria(const AES_Context *ctx, const unsigned char *entrada, size_t n,
+                              unsigned char *salida) {
+    long file_size = n;
+    memcpy(salida, &file_size, sizeof(long));
+    unsigned char *datos = salida + sizeof(long);
+    if (n > 0) memcpy(datos, entrada, n);
+    
+    // Aplicar padding PKCS#7 al último bloque incompleto
+    size_t resto = n % AES_BLOCK_SIZE;
+    if (resto != 0) {
+        unsigned char padding = AES_BLOCK_SIZE - resto;
+        memset(datos + n, padding, padding);
+    }
+    
+    size_t total = aes_tamano_cifrado(n) - sizeof(long);
+    aes_encrypt_blocks(datos, total / AES_BLOCK_SIZE, ctx);
+}
+
+// Tamaño que tendrá el descifrado de un buffer de n bytes (sin el padding),
+// o -1 (ya avisado) si el tamaño es desconocido y el padding es inválido
+static ssize_t tamano_descifrado(const AES_Context *ctx, const unsigned char *entrada, size_t n) {
+    long file_size = 0;
+    if (n >= sizeof(long)) memcpy(&file_size, entrada, sizeof(long));
+    if (encabezado_ctr(entrada, n)) return -1;
+    
+    size_t datos = n >= sizeof(long) ? n - sizeof(long) : 0;
+    datos -= datos % AES_BLOCK_SIZE;
+    if (file_size == AES_TAMANO_DESCONOCIDO) {
+        long total = -1;
+        if (datos >= AES_BLOCK_SIZE) {
+            const unsigned char *ultimo = entrada + sizeof(long) + datos - AES_BLOCK_SIZE;
+            total = tamano_por_padding(ctx, ultimo, datos);
+        }
+        if (total < 0) aes_escribir_salida("Error: padding inválido\n");
+        return total;
+    }
+    return file_size >= 0 && (size_t)file_size < datos ? (size_t)file_size : datos;
+}
+
+// Descifra sobre salida, que tiene total = tamano_descifrado(...) bytes
+static void descifrar_en_memoria(const AES_Context *ctx, const unsigned char *entrada, size_t total,
+                                 unsigned char *salida) {
+    if (total == 0) return;
+    const unsigned char *datos = entrada + sizeof(long);
+    
+    size_t completos = total - total % AES_BLOCK_SIZE;
+    memcpy(salida, datos, completos);
+    aes_decrypt_blocks(salida, completos / AES_BLOCK_SIZE, ctx);
+    
+    // Último bloque: descifrar aparte y quedarse sin el padding
+    if (completos < total) {
+        unsigned char bloque[AES_BLOCK_SIZE];
+        memcpy(bloque, datos + completos, AES_BLOCK_SIZE);
+        aes_decrypt_block(bloque, ctx);
+        memcpy(salida + completos, bloque, total - completos);
+    }
+}
+
+/**
+ * Cifrar un buffer completo en memoria. *salida se reserva con malloc con
+ * aes_tamano_cifrado(n) bytes (encabezado + datos con padding).
+ */
+int cifrar_aes_memoria(const unsigned char *entrada, size_t n, unsigned char **salida,
+                       size_t *n_salida, const unsigned char *clave) {
+    AES_Context ctx;
+    aes_key_expansion(clave, &ctx);
+    
+    size_t total = aes_tamano_cifrado(n);
+    *salida = malloc(total);
+    if (!*salida) return -1;
+    
+    cifrar_en_memoria(&ctx, entrada, n, *salida);
+    *n_salida = total;
+    return 0;
+}
+
+// Descifrar un buffer completo en memoria (*salida se reserva con malloc)
+int descifrar_aes_memoria(const unsigned char *entrada, size_t n, unsigned char **salida,
+                          size_t *n_salida, const unsigned char *clave) {
     AES_Context ctx;
     aes_key_expansion(clave, &ctx);
     
+    ssize_t total = tamano_descifrado(&ctx, entrada, n);
+    if (total < 0) return -1;
+    *salida = malloc(total > 0 ? total : 1);
+    if (!*salida) return -1;
+    
+    descifrar_en_memoria(&ctx, entrada, total, *salida);
+    *n_salida = total;
+    return 0;
+}
+
+// Cifrar con la entrada mapeada y la salida reservada y mapeada (fd_out con O_RDWR)
+int cifrar_aes_mapeado(int fd_in, int fd_out, const unsigned char *clave) {
+    AES_Context ctx;
+    aes_key_expansion(clave, &ctx);
+    
+    const unsigned char *entrada;
+    size_t n;
+    if (mapear_entrada(fd_in, &entrada, &n) != 0) return -1;
+    
+    size_t total = aes_tamano_cifrado(n);
+    unsigned char *salida;
+    if (mapear_salida(fd_out, total, &salida) != 0) {
+        desmapear(entrada, n);
+        return -1;
+    }
+    
+    cifrar_en_memoria(&ctx, entrada, n, salida);
+    
+    desmapear(salida, total);
+    desmapear(entrada, n);
+    return 0;
+}
+
+// Descifrar con la salida reservada según el tamaño del encabezado
+int descifrar_aes_mapeado(int fd_in, int fd_out, const unsigned char *clave) {
+    AES_Context ctx;
+    aes_key_expansion(clave, &ctx);
+    
+    const unsigned char *entrada;
+    size_t n;
+    if (mapear_entrada(fd_in, &entrada, &n) != 0) return -1;
+    
+    ssize_t total = tamano_descifrado(&ctx, entrada, n);
+    if (total < 0) {
+        desmapear(entrada, n);
+        return -1;
+    }
+    unsigned char *salida;
+    if (mapear_salida(fd_out, total, &salida) != 0) {
+        desmapear(entrada, n);
+        return -1;
+    }
+    
+    descifrar_en_memoria(&ctx, entrada, total, salida);
+    
+    desmapear(salida, total);
+    desmapear(entrada, n);
+    return 0;
+}
+
+/*
+ * Modo CTR (--mode ctr). El flujo de claves es E(nonce || contador), con el
+ * contador en big-endian igual al número de bloque de 16 bytes dentro del
+ * archivo original. El byte p se cifra con el byte p % 16 del bloque p / 16,
+ * así que cualquier rango se cifra o descifra sin mirar lo anterior y la
+ * salida tiene el mismo tamaño que la entrada (sin padding).
+ *
+ * Archivo cifrado: [magia "AES-CTR\x01"][nonce de 8 bytes][datos]
+ */
+
+// Bloques de flujo de claves que se generan por vuelta (y el buffer de E/S)
+#define CTR_BLOQUES         256
+#define CTR_TAM_BUFFER      (256 * 1024)
+
+// Por debajo de esto no vale la pena repartir un archivo entre hilos
+#define CTR_TAM_SEGMENTO    (8L * 1024 * 1024)
+
+int aes_ctr_generar_nonce(unsigned char *nonce) {
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0) return -1;
+    ssize_t r = read(fd, nonce, AES_CTR_TAM_NONCE);
+    close(fd);
+    return r == AES_CTR_TAM_NONCE ? 0 : -1;
+}
+
+static void armar_encabezado_ctr(unsigned char *encabezado, const unsigned char *nonce) {
+    memcpy(encabezado, magia_ctr, AES_CTR_TAM_MAGIA);
+    memcpy(encabezado + AES_CTR_TAM_MAGIA, nonce, AES_CTR_TAM_NONCE);
+}
+
+// Copia el nonce si el encabezado es de CTR. Retorna: 0, o -1 si no lo es
+static int leer_encabezado_ctr(const unsigned char *encabezado, unsigned char *nonce) {
+    if (!aes_ctr_es_encabezado(encabezado)) {
+        aes_escribir_salida("Error: no es un archivo cifrado con --mode ctr\n");
+        return -1;
+    }
+    memcpy(nonce, encabezado + AES_CTR_TAM_MAGIA, AES_CTR_TAM_NONCE);
+    return 0;
+}
+
+int aes_ctr_escribir_encabezado(int fd_out, const unsigned char *nonce) {
+    unsigned char encabezado[AES_CTR_TAM_ENCABEZADO];
+    armar_encabezado_ctr(encabezado, nonce);
+    if (pwrite(fd_out, encabezado, AES_CTR_TAM_ENCABEZADO, 0) != AES_CTR_TAM_ENCABEZADO) return -1;
+    return 0;
+}
+
+int aes_ctr_leer_encabezado(int fd_in, unsigned char *nonce) {
+    unsigned char encabezado[AES_CTR_TAM_ENCABEZADO];
+    if (pread(fd_in, encabezado, AES_CTR_TAM_ENCABEZADO, 0) != AES_CTR_TAM_ENCABEZADO) {
+        aes_escribir_salida("Error: no es un archivo cifrado con --mode ctr\n");
+        return -1;
+    }
+    return leer_encabezado_ctr(encabezado, nonce);
+}
+
+// Flujo de claves a un buffer y XOR: sirve con cualquier implementación y posición
+static void ctr_generico(const AES_Context *ctx, const unsigned char *nonce, uint64_t posicion,
+                         unsigned char *datos, size_t n) {
+    unsigned char flujo[CTR_BLOQUES * AES_BLOCK_SIZE];
+    while (n > 0) {
+        uint64_t contador = posicion / AES_BLOCK_SIZE;
+        size_t salto = posicion % AES_BLOCK_SIZE;
+        size_t bloques = (salto + n + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+        if (bloques > CTR_BLOQUES) bloques = CTR_BLOQUES;
+        
+        uint64_t mitad;
+        memcpy(&mitad, nonce, AES_CTR_TAM_NONCE);
+        for (size_t b = 0; b < bloques; b++) {
+            // El contador va en big-endian en cualquier máquina
+            memcpy(flujo + b * AES_BLOCK_SIZE, &mitad, 8);
+            guardar_palabra(flujo + b * AES_BLOCK_SIZE + 8, (uint32_t)((contador + b) >> 32));
+            guardar_palabra(flujo + b * AES_BLOCK_SIZE + 12, (uint32_t)(contador + b));
+        }
+        aes_encrypt_blocks(flujo, bloques, ctx);
+        
+        size_t usados = bloques * AES_BLOCK_SIZE - salto;
+        if (usados > n) usados = n;
+        const unsigned char *k = flujo + salto;
+        size_t i = 0;
+        for (; i + 8 <= usados; i += 8) {
+            uint64_t a, b;
+            memcpy(&a, datos + i, 8);
+            memcpy(&b, k + i, 8);
+            a ^= b;
+            memcpy(datos + i, &a, 8);
+        }
+        for (; i < usados; i++) datos[i] ^= k[i];
+        
+        datos += usados;
+        n -= usados;
+        posicion += usados;
+    }
+}
+
+/**
+ * aes_ctr_aplicar - XOR de n bytes con el flujo de claves
+ * @posicion: Posición de datos[0] dentro del archivo original
+ *
+ * Cifrar y descifrar son la misma operación.
+ */
+void aes_ctr_aplicar(const AES_Context *ctx, const unsigned char *nonce, uint64_t posicion,
+                     unsigned char *datos, size_t n) {
+#ifdef AES_X86
+    if (usar_aesni()) {
+        // Los bytes hasta el primer bloque completo y los del final, por separado
+        size_t cabeza = (AES_BLOCK_SIZE - posicion % AES_BLOCK_SIZE) % AES_BLOCK_SIZE;
+        if (cabeza > n) cabeza = n;
+        ctr_generico(ctx, nonce, posicion, datos, cabeza);
+        
+        size_t bloques = (n - cabeza) / AES_BLOCK_SIZE;
+        ctr_bloques_aesni(datos + cabeza, bloques, ctx, nonce, (posicion + cabeza) / AES_BLOCK_SIZE);
+        
+        size_t hecho = cabeza + bloques * AES_BLOCK_SIZE;
+        ctr_generico(ctx, nonce, posicion + hecho, datos + hecho, n - hecho);
+        return;
+    }
+#endif
+    ctr_generico(ctx, nonce, posicion, datos, n);
+}
+
+/**
+ * aes_ctr_rango - Cifra o descifra el rango [inicio, inicio + longitud) del
+ * archivo original
+ * @origen: Posición en fd_in del byte 0 del original
+ * @destino: Posición en fd_out del byte 0 del original
+ *
+ * Al cifrar origen es 0 y destino AES_CTR_TAM_ENCABEZADO; al descifrar al
+ * revés. Retorna: 0, o -1 si hubo error
+ */
+int aes_ctr_rango(int fd_in, int fd_out, const AES_Context *ctx, const unsigned char *nonce,
+                  long inicio, long longitud, long origen, long destino) {
+    unsigned char *buffer = malloc(CTR_TAM_BUFFER);
+    if (!buffer) return -1;
+    
+    int resultado = 0;
+    long procesados = 0;
+    while (procesados < longitud) {
+        long pedir = longitud - procesados;
+        if (pedir > CTR_TAM_BUFFER) pedir = CTR_TAM_BUFFER;
+        
+        long pos = inicio + procesados;
+        ssize_t bytes_leidos = leer_completo_en(fd_in, buffer, pedir, origen + pos);
+        if (bytes_leidos != pedir) {
+            resultado = rango_incompleto(bytes_leidos);
+            break;
+        }
+        
+        aes_ctr_aplicar(ctx, nonce, pos, buffer, bytes_leidos);
+        if (pwrite(fd_out, buffer, bytes_leidos, destino + pos) != bytes_leidos) {
+            aes_escribir_salida("Error al escribir\n");
+            resultado = -1;
+            break;
+        }
+        procesados += bytes_leidos;
+    }
+    
+    free(buffer);
+    return resultado;
+}
+
+typedef struct {
+    int fd_in, fd_out;
+    const AES_Context *ctx;
+    const unsigned char *nonce;
+    long inicio, longitud, origen, destino;
+    int resultado;
+} SegmentoCTR;
+
+static void trabajo_segmento_ctr(void *arg, void *contexto) {
+    (void)contexto;
+    SegmentoCTR *s = arg;
+    s->resultado = aes_ctr_rango(s->fd_in, s->fd_out, s->ctx, s->nonce,
+                                 s->inicio, s->longitud, s->origen, s->destino);
+}
+
+/**
+ * Reparte los longitud bytes del original en segmentos de CTR_TAM_SEGMENTO
+ * entre hilos, cada uno con sus propios pread/pwrite
+ */
+static int ctr_segmentos(int fd_in, int fd_out, const AES_Context *ctx, const unsigned char *nonce,
+                         long longitud, long origen, long destino, int hilos) {
+    long num = (longitud + CTR_TAM_SEGMENTO - 1) / CTR_TAM_SEGMENTO;
+    if (hilos <= 1 || num <= 1) {
+        return aes_ctr_rango(fd_in, fd_out, ctx, nonce, 0, longitud, origen, destino);
+    }
+    
+    SegmentoCTR *segmentos = malloc(num * sizeof(SegmentoCTR));
+    Pool *pool = pool_crear(hilos < num ? hilos : (int)num, NULL, NULL);
+    if (!segmentos || !pool) {
+        free(segmentos);
+        if (pool) pool_destruir(pool);
+        return aes_ctr_rango(fd_in, fd_out, ctx, nonce, 0, longitud, origen, destino);
+    }
+    
+    for (long i = 0; i < num; i++) {
+        SegmentoCTR *s = &segmentos[i];
+        s->fd_in = fd_in;
+        s->fd_out = fd_out;
+        s->ctx = ctx;
+        s->nonce = nonce;
+        s->inicio = i * CTR_TAM_SEGMENTO;
+        s->longitud = longitud - s->inicio < CTR_TAM_SEGMENTO ? longitud - s->inicio : CTR_TAM_SEGMENTO;
+        s->origen = origen;
+        s->destino = destino;
+        if (pool_enviar(pool, trabajo_segmento_ctr, s) != 0) trabajo_segmento_ctr(s, NULL);
+    }
+    pool_destruir(pool);
+    
+    int resultado = 0;
+    for (long i = 0; i < num; i++) {
+        if (segmentos[i].resultado != 0) resultado = -1;
+    }
+    free(segmentos);
+    return resultado;
+}
+
+// Cifrar un archivo regular en CTR, repartido entre hilos
+int cifrar_aes_ctr_fd(int fd_in, int fd_out, const unsigned char *clave, int hilos) {
+    AES_Context ctx;
+    aes_key_expansion(clave, &ctx);
+    
+    struct stat st;
+    fstat(fd_in, &st);
+    long file_size = st.st_size;
+    
+    unsigned char nonce[AES_CTR_TAM_NONCE];
+    if (aes_ctr_generar_nonce(nonce) != 0) {
+        aes_escribir_salida("Error: no se pudo generar el nonce\n");
+        return -1;
+    }
+    if (aes_ctr_escribir_encabezado(fd_out, nonce) != 0 ||
+        ftruncate(fd_out, AES_CTR_TAM_ENCABEZADO + file_size) != 0) {
+        aes_escribir_salida("Error al escribir\n");
+        return -1;
+    }
+    return ctr_segmentos(fd_in, fd_out, &ctx, nonce, file_size, 0, AES_CTR_TAM_ENCABEZADO, hilos);
+}
+
+// Descifrar un archivo regular en CTR, repartido entre hilos
+int descifrar_aes_ctr_fd(int fd_in, int fd_out, const unsigned char *clave, int hilos) {
+    AES_Context ctx;
+    aes_key_expansion(clave, &ctx);
+    
+    unsigned char nonce[AES_CTR_TAM_NONCE];
+    if (aes_ctr_leer_encabezado(fd_in, nonce) != 0) return -1;
+    
+    struct stat st;
+    fstat(fd_in, &st);
+    long datos = st.st_size - AES_CTR_TAM_ENCABEZADO;
+    if (ftruncate(fd_out, datos) != 0) {
+        aes_escribir_salida("Error al escribir\n");
+        return -1;
+    }
+    return ctr_segmentos(fd_in, fd_out, &ctx, nonce, datos, AES_CTR_TAM_ENCABEZADO, 0, hilos);
+}
+
+// XOR secuencial con el flujo de claves desde la posición 0 (read/write)
+static int ctr_flujo(int fd_in, int fd_out, const AES_Context *ctx, const unsigned char *nonce) {
+    unsigned char *buffer = malloc(CTR_TAM_BUFFER);
+    if (!buffer) return -1;
+    
+    int resultado = 0;
+    uint64_t pos = 0;
+    ssize_t bytes_leidos;
+    while ((bytes_leidos = leer_completo(fd_in, buffer, CTR_TAM_BUFFER)) > 0) {
+        aes_ctr_aplicar(ctx, nonce, pos, buffer, bytes_leidos);
+        if (escribir_completo(fd_out, buffer, bytes_leidos) != 0) {
+            aes_escribir_salida("Error al escribir\n");
+            resultado = -1;
+            break;
+        }
+        pos += bytes_leidos;
+    }
+    if (bytes_leidos < 0) resultado = -1;
+    
+    free(buffer);
+    return resultado;
+}
+
+// Cifrar en CTR de forma secuencial (tuberías): no hace falta saber el tamaño
+int cifrar_aes_ctr_flujo(int fd_in, int fd_out, const unsigned char *clave) {
+    AES_Context ctx;
+    aes_key_expansion(clave, &ctx);
+    
+    unsigned char nonce[AES_CTR_TAM_NONCE];
+    unsigned char encabezado[AES_CTR_TAM_ENCABEZADO];
+    if (aes_ctr_generar_nonce(nonce) != 0) {
+        aes_escribir_salida("Error: no se pudo generar el nonce\n");
+        return -1;
+    }
+    armar_encabezado_ctr(encabezado, nonce);
+    if (escribir_completo(fd_out, encabezado, AES_CTR_TAM_ENCABEZADO) != 0) {
+        aes_escribir_salida("Error al escribir\n");
+        return -1;
+    }
+    return ctr_flujo(fd_in, fd_out, &ctx, nonce);
+}
+
+// Descifrar en CTR de forma secuencial
+int descifrar_aes_ctr_flujo(int fd_in, int fd_out, const unsigned char *clave) {
+    AES_Context ctx;
+    aes_key_expansion(clave, &ctx);
+    
+    unsigned char nonce[AES_CTR_TAM_NONCE];
+    unsigned char encabezado[AES_CTR_TAM_ENCABEZADO];
+    if (leer_completo(fd_in, encabezado, AES_CTR_TAM_ENCABEZADO) != AES_CTR_TAM_ENCABEZADO) {
+        aes_escribir_salida("Error: no es un archivo cifrado con --mode ctr\n");
+        return -1;
+    }
+    if (leer_encabezado_ctr(encabezado, nonce) != 0) return -1;
+    return ctr_flujo(fd_in, fd_out, &ctx, nonce);
+}
+
+// Cifrar en CTR un buffer completo (*salida: AES_CTR_TAM_ENCABEZADO + n bytes)
+int cifrar_aes_ctr_memoria(const unsigned char *entrada, size_t n, unsigned char **salida,
+                           size_t *n_salida, const unsigned char *clave) {
+    AES_Context ctx;
+    aes_key_expansion(clave, &ctx);
+    
+    unsigned char nonce[AES_CTR_TAM_NONCE];
+    if (aes_ctr_generar_nonce(nonce) != 0) {
+        aes_escribir_salida("Error: no se pudo generar el nonce\n");
+        return -1;
+    }
+    *salida = malloc(AES_CTR_TAM_ENCABEZADO + n);
+    if (!*salida) return -1;
+    
+    armar_encabezado_ctr(*salida, nonce);
+    if (n > 0) memcpy(*salida + AES_CTR_TAM_ENCABEZADO, entrada, n);
+    aes_ctr_aplicar(&ctx, nonce, 0, *salida + AES_CTR_TAM_ENCABEZADO, n);
+    *n_salida = AES_CTR_TAM_ENCABEZADO + n;
+    return 0;
+}
+
+// Descifrar en CTR un buffer completo (*salida se reserva con malloc)
+int descifrar_aes_ctr_memoria(const unsigned char *entrada, size_t n, unsigned char **salida,
+                              size_t *n_salida, const unsigned char *clave) {
+    AES_Context ctx;
+    aes_key_expansion(clave, &ctx);
+    
+    unsigned char nonce[AES_CTR_TAM_NONCE];
+    if (n < AES_CTR_TAM_ENCABEZADO) {
+        aes_escribir_salida("Error: no es un archivo cifrado con --mode ctr\n");
+        return -1;
+    }
+    if (leer_encabezado_ctr(entrada, nonce) != 0) return -1;
+    
+    size_t total = n - AES_CTR_TAM_ENCABEZADO;
+    *salida = malloc(total > 0 ? total : 1);
+    if (!*salida) return -1;
+    
+    if (total > 0) memcpy(*salida, entrada + AES_CTR_TAM_ENCABEZADO, total);
+    aes_ctr_aplicar(&ctx, nonce, 0, *salida, total);
+    *n_salida = total;
+    return 0;
+}
+
+// Cifrar archivo
+int cifrar_archivo_aes(const char *entrada, const char *salida, const unsigned char *clave) {
     int fd_in = open(entrada, O_RDONLY);
     if (fd_in == -1) {
         aes_escribir_salida("Error: No se pudo abrir archivo de entrada\n");
@@ -335,35 +1632,33 @@ int descifrar_archivo_aes(const char *entrada, const char *salida, const unsigne
         return -1;
     }
     
-    // Leer tamaño original
-    long file_size;
-    read(fd_in, &file_size, sizeof(long));
+    int resultado = cifrar_aes_fd(fd_in, fd_out, clave);
     
-    unsigned char buffer[AES_BLOCK_SIZE];
-    long bytes_escritos_total = 0;
+    close(fd_in);
+    close(fd_out);
+    return resultado;
+}
+
+// Descifrar archivo
+int descifrar_archivo_aes(const char *entrada, const char *salida, const unsigned char *clave) {
+    int fd_in = open(entrada, O_RDONLY);
+    if (fd_in == -1) {
+        aes_escribir_salida("Error: No se pudo abrir archivo de entrada\n");
+        return -1;
+    }
     
-    while (read(fd_in, buffer, AES_BLOCK_SIZE) == AES_BLOCK_SIZE) {
-        aes_decrypt_block(buffer, &ctx);
-        
-        // Calcular cuántos bytes escribir (remover padding en el último bloque)
-        ssize_t bytes_a_escribir = AES_BLOCK_SIZE;
-        if (bytes_escritos_total + AES_BLOCK_SIZE > file_size) {
-            bytes_a_escribir = file_size - bytes_escritos_total;
-        }
-        
-        if (write(fd_out, buffer, bytes_a_escribir) != bytes_a_escribir) {
-            aes_escribir_salida("Error al escribir\n");
-            close(fd_in);
-            close(fd_out);
-            return -1;
-        }
-        
-        bytes_escritos_total += bytes_a_escribir;
+    int fd_out = open(salida, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_out == -1) {
+        aes_escribir_salida("Error: No se pudo crear archivo de salida\n");
+        close(fd_in);
+        return -1;
     }
     
+    int resultado = descifrar_aes_fd(fd_in, fd_out, clave);
+    
     close(fd_in);
     close(fd_out);
-    return 0;
+    return resultado;
 }
 
 // Generar clave de 16 bytes desde una cadena
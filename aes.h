@@ -2,19 +2,98 @@
 #define AES_H
 
 #include <unistd.h>
+#include <stdint.h>
+#include "tuberia.h"
 
 // Tamaños
 #define AES_BLOCK_SIZE 16
 #define AES_KEY_SIZE 16
 
+// Tamaño original en el encabezado cuando la entrada no tenía tamaño conocido
+// (una tubería): el último bloque siempre lleva padding
+#define AES_TAMANO_DESCONOCIDO (-1L)
+
+// Modo CTR (--mode ctr): [magia "AES-CTR\x01"][nonce][datos del mismo tamaño]
+#define AES_CTR_TAM_MAGIA 8
+#define AES_CTR_TAM_NONCE 8
+#define AES_CTR_TAM_ENCABEZADO (AES_CTR_TAM_MAGIA + AES_CTR_TAM_NONCE)
+
 // Contexto AES
 typedef struct {
     unsigned char round_keys[176]; // 11 round keys de 16 bytes cada una
+    unsigned char round_keys_dec[176]; // las del cifrado inverso equivalente (AESDEC)
+    uint32_t enc[44];              // las mismas en palabras, para las tablas T
+    uint32_t dec[44];
 } AES_Context;
 
 // Funciones de cifrado y descifrado
 int cifrar_archivo_aes(const char *entrada, const char *salida, const unsigned char *clave);
 int descifrar_archivo_aes(const char *entrada, const char *salida, const unsigned char *clave);
+int cifrar_aes_fd(int fd_in, int fd_out, const unsigned char *clave);
+int descifrar_aes_fd(int fd_in, int fd_out, const unsigned char *clave);
+
+// Igual que las anteriores pero leyendo y escribiendo en tubería (archivos grandes)
+int cifrar_aes_tuberia(int fd_in, int fd_out, const unsigned char *clave, const ConfigTuberia *config);
+int descifrar_aes_tuberia(int fd_in, int fd_out, const unsigned char *clave, const ConfigTuberia *config);
+
+// Variantes secuenciales (read/write), para tuberías y terminales
+int cifrar_aes_flujo(int fd_in, int fd_out, const unsigned char *clave);
+int descifrar_aes_flujo(int fd_in, int fd_out, const unsigned char *clave);
+
+// Variantes con la entrada y la salida mapeadas en memoria (fd_out con O_RDWR)
+int cifrar_aes_mapeado(int fd_in, int fd_out, const unsigned char *clave);
+int descifrar_aes_mapeado(int fd_in, int fd_out, const unsigned char *clave);
+
+// Variantes sobre buffers completos en memoria (*salida se reserva con malloc)
+int cifrar_aes_memoria(const unsigned char *entrada, size_t n, unsigned char **salida,
+                       size_t *n_salida, const unsigned char *clave);
+int descifrar_aes_memoria(const unsigned char *entrada, size_t n, unsigned char **salida,
+                          size_t *n_salida, const unsigned char *clave);
+
+// Cifrado por rangos (pread/pwrite), para dividir un archivo entre hilos
+void aes_key_expansion(const unsigned char *key, AES_Context *ctx);
+long aes_tamano_cifrado(long file_size);
+int aes_escribir_encabezado(int fd_out, long file_size);
+int aes_leer_encabezado(int fd_in, long *file_size);
+int aes_resolver_tamano(int fd_in, const AES_Context *ctx, long datos, long *file_size);
+int cifrar_rango_aes(int fd_in, int fd_out, const AES_Context *ctx, long inicio, long longitud);
+int descifrar_rango_aes(int fd_in, int fd_out, const AES_Context *ctx, long inicio, long longitud, long file_size);
+
+// Modo CTR. Las variantes _fd reparten el archivo en segmentos entre hilos
+// (pread/pwrite); las _flujo son secuenciales y sirven con tuberías
+int cifrar_aes_ctr_fd(int fd_in, int fd_out, const unsigned char *clave, int hilos);
+int descifrar_aes_ctr_fd(int fd_in, int fd_out, const unsigned char *clave, int hilos);
+int cifrar_aes_ctr_flujo(int fd_in, int fd_out, const unsigned char *clave);
+int descifrar_aes_ctr_flujo(int fd_in, int fd_out, const unsigned char *clave);
+int cifrar_aes_ctr_memoria(const unsigned char *entrada, size_t n, unsigned char **salida,
+                           size_t *n_salida, const unsigned char *clave);
+int descifrar_aes_ctr_memoria(const unsigned char *entrada, size_t n, unsigned char **salida,
+                              size_t *n_salida, const unsigned char *clave);
+
+// Piezas de CTR para dividir un archivo entre hilos: cualquier rango de bytes
+// se cifra o descifra sin el resto
+int aes_ctr_es_encabezado(const unsigned char *encabezado);
+int aes_ctr_generar_nonce(unsigned char *nonce);
+int aes_ctr_escribir_encabezado(int fd_out, const unsigned char *nonce);
+int aes_ctr_leer_encabezado(int fd_in, unsigned char *nonce);
+void aes_ctr_aplicar(const AES_Context *ctx, const unsigned char *nonce, uint64_t posicion,
+                     unsigned char *datos, size_t n);
+int aes_ctr_rango(int fd_in, int fd_out, const AES_Context *ctx, const unsigned char *nonce,
+                  long inicio, long longitud, long origen, long destino);
+
+// Un bloque con las tablas T, y paso por paso como en FIPS-197 (referencia)
+void aes_encrypt_block(unsigned char *block, const AES_Context *ctx);
+void aes_decrypt_block(unsigned char *block, const AES_Context *ctx);
+void aes_encrypt_block_bytes(unsigned char *block, const AES_Context *ctx);
+void aes_decrypt_block_bytes(unsigned char *block, const AES_Context *ctx);
+
+// n bloques seguidos: con AES-NI si la CPU lo tiene, si no con las tablas T
+void aes_encrypt_blocks(unsigned char *datos, size_t n, const AES_Context *ctx);
+void aes_decrypt_blocks(unsigned char *datos, size_t n, const AES_Context *ctx);
+
+// Lo corre --selftest. Retorna: 0 si todas las implementaciones dan el vector
+// de FIPS-197, -1 si no
+int aes_verificar(void);
 
 // Funciones auxiliares
 void generar_clave_aes(const char *clave_str, unsigned char *clave);
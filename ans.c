@@ -0,0 +1,261 @@
+#include <stdint.h>
+#include <string.h>
+#include "ans.h"
+#include "es.h"
+
+#define ANS_ESCALA      (1u << ANS_BITS_ESCALA)
+#define ANS_L           (1u << 15)      // estados en [ANS_L, ANS_L << 16)
+#define TAM_MAPA        32
+
+// Símbolo para el codificador: división por freq con un recíproco
+typedef struct {
+    uint32_t x_max;         // desde aquí hay que emitir una palabra antes
+    uint32_t rcp_freq;
+    uint32_t bias;
+    uint16_t cmpl_freq;     // ANS_ESCALA - freq
+    uint16_t rcp_shift;
+} SimboloCodificador;
+
+// Entrada de la tabla de decodificación (una por posición en [0, ANS_ESCALA)),
+// todo en una sola lectura: símbolo, freq - 1 y posición - inicio del símbolo
+typedef uint32_t EntradaAns;
+
+#define ENTRADA_ANS(simbolo, freq, bias)    ((simbolo) | ((freq) - 1) << 8 | (bias) << 20)
+
+static void poner_u16(unsigned char *p, unsigned int v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static unsigned int tomar_u16(const unsigned char *p) {
+    return p[0] | (p[1] << 8);
+}
+
+size_t ans_cota(size_t n) {
+    return TAM_MAPA + 384 + 4 * ANS_ESTADOS + 2 * n + 2;
+}
+
+/**
+ * Frecuencias que suman ANS_ESCALA, al menos 1 por símbolo presente. Lo que
+ * sobra o falta tras escalar se ajusta en los símbolos más frecuentes, que
+ * son los que menos lo notan.
+ */
+static void normalizar(const unsigned long *frequencies, size_t n, unsigned int *norm) {
+    unsigned int suma = 0;
+    int mayor = 0;
+    for (int s = 0; s < 256; s++) {
+        norm[s] = 0;
+        if (frequencies[s] == 0) continue;
+        unsigned long long escalada = (unsigned long long)frequencies[s] * ANS_ESCALA / n;
+        norm[s] = escalada > 0 ? (unsigned int)escalada : 1;
+        suma += norm[s];
+        if (norm[s] > norm[mayor]) mayor = s;
+    }
+
+    if (suma < ANS_ESCALA) {
+        norm[mayor] += ANS_ESCALA - suma;
+        return;
+    }
+    while (suma > ANS_ESCALA) {
+        for (int s = 0; s < 256; s++) {
+            if (norm[s] > norm[mayor]) mayor = s;
+        }
+        unsigned int quitar = norm[mayor] - 1 < suma - ANS_ESCALA ? norm[mayor] - 1 : suma - ANS_ESCALA;
+        if (quitar > norm[mayor] / 4 + 1) quitar = norm[mayor] / 4 + 1;
+        norm[mayor] -= quitar;
+        suma -= quitar;
+    }
+}
+
+static void preparar_simbolo(SimboloCodificador *e, unsigned int inicio, unsigned int freq) {
+    e->x_max = ((ANS_L >> ANS_BITS_ESCALA) << 16) * freq;
+    e->cmpl_freq = ANS_ESCALA - freq;
+    if (freq < 2) {
+        // x / 1: el producto por el recíproco tiene que dar x
+        e->rcp_freq = ~0u;
+        e->rcp_shift = 0;
+        e->bias = inicio + ANS_ESCALA - 1;
+    } else {
+        unsigned int shift = 0;
+        while (freq > (1u << shift)) shift++;
+        e->rcp_freq = (uint32_t)(((1ull << (shift + 31)) + freq - 1) / freq);
+        e->rcp_shift = shift - 1;
+        e->bias = inicio;
+    }
+}
+
+static inline uint32_t codificar_simbolo(uint32_t x, const SimboloCodificador *e, unsigned char **p) {
+    if (x >= e->x_max) {
+        *p -= 2;
+        poner_u16(*p, x & 0xFFFF);
+        x >>= 16;
+    }
+    uint32_t q = (uint32_t)(((uint64_t)x * e->rcp_freq) >> 32) >> e->rcp_shift;
+    return x + e->bias + q * e->cmpl_freq;
+}
+
+static size_t escribir_frecuencias(const unsigned int *norm, unsigned char *p) {
+    memset(p, 0, TAM_MAPA);
+    size_t pos = TAM_MAPA;
+    int pendiente = -1;
+    for (int s = 0; s < 256; s++) {
+        if (norm[s] == 0) continue;
+        p[s >> 3] |= 1 << (s & 7);
+        unsigned int v = norm[s] - 1;
+        if (pendiente < 0) {
+            pendiente = v;
+            continue;
+        }
+        p[pos++] = pendiente & 0xFF;
+        p[pos++] = (pendiente >> 8) | ((v & 0x0F) << 4);
+        p[pos++] = v >> 4;
+        pendiente = -1;
+    }
+    if (pendiente >= 0) {
+        p[pos++] = pendiente & 0xFF;
+        p[pos++] = pendiente >> 8;
+    }
+    return pos;
+}
+
+size_t ans_codificar(const unsigned char *datos, size_t n, const unsigned long *frequencies,
+                     unsigned char *salida) {
+    unsigned int norm[256];
+    normalizar(frequencies, n, norm);
+    size_t encabezado = escribir_frecuencias(norm, salida);
+
+    SimboloCodificador simbolos[256];
+    unsigned int inicio = 0;
+    for (int s = 0; s < 256; s++) {
+        if (norm[s] == 0) continue;
+        preparar_simbolo(&simbolos[s], inicio, norm[s]);
+        inicio += norm[s];
+    }
+
+    // Se codifica de atrás hacia adelante: las palabras se escriben desde el
+    // final del buffer y el decodificador las lee en el orden inverso
+    unsigned char *fin = salida + ans_cota(n);
+    unsigned char *p = fin;
+    uint32_t x[ANS_ESTADOS] = { ANS_L, ANS_L, ANS_L, ANS_L };
+
+    size_t i = n;
+    while (i % ANS_ESTADOS != 0) {
+        i--;
+        x[i % ANS_ESTADOS] = codificar_simbolo(x[i % ANS_ESTADOS], &simbolos[datos[i]], &p);
+    }
+    uint32_t x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3];
+    while (i > 0) {
+        i -= ANS_ESTADOS;
+        x3 = codificar_simbolo(x3, &simbolos[datos[i + 3]], &p);
+        x2 = codificar_simbolo(x2, &simbolos[datos[i + 2]], &p);
+        x1 = codificar_simbolo(x1, &simbolos[datos[i + 1]], &p);
+        x0 = codificar_simbolo(x0, &simbolos[datos[i]], &p);
+    }
+    x[0] = x0;
+    x[1] = x1;
+    x[2] = x2;
+    x[3] = x3;
+
+    unsigned char *q = salida + encabezado;
+    for (int j = 0; j < ANS_ESTADOS; j++) {
+        escribir_u32(q, x[j]);
+        q += 4;
+    }
+    size_t palabras = fin - p;
+    memmove(q, p, palabras);
+    return (q - salida) + palabras;
+}
+
+// Lee el encabezado y arma la tabla. Retorna: bytes leídos, o -1
+static ssize_t leer_frecuencias(const unsigned char *p, size_t n, EntradaAns *tabla) {
+    if (n < TAM_MAPA) return -1;
+    size_t pos = TAM_MAPA;
+    unsigned int inicio = 0;
+    int par = 0;
+    for (int s = 0; s < 256; s++) {
+        if (!(p[s >> 3] & (1 << (s & 7)))) continue;
+
+        unsigned int v;
+        if (par == 0) {
+            if (pos + 2 > n) return -1;
+            v = p[pos] | ((p[pos + 1] & 0x0F) << 8);
+        } else {
+            if (pos + 3 > n) return -1;
+            v = (p[pos + 1] >> 4) | (p[pos + 2] << 4);
+            pos += 3;
+        }
+        par ^= 1;
+
+        unsigned int freq = v + 1;
+        if (inicio + freq > ANS_ESCALA) return -1;
+        for (unsigned int k = 0; k < freq; k++) tabla[inicio + k] = ENTRADA_ANS(s, freq, k);
+        inicio += freq;
+    }
+    if (par) pos += 2;
+    return inicio == ANS_ESCALA ? (ssize_t)pos : -1;
+}
+
+static inline uint32_t decodificar_simbolo(uint32_t x, const EntradaAns *tabla, unsigned char *out) {
+    EntradaAns e = tabla[x & (ANS_ESCALA - 1)];
+    *out = e & 0xFF;
+    return (((e >> 8) & 0xFFF) + 1) * (x >> ANS_BITS_ESCALA) + (e >> 20);
+}
+
+static inline uint32_t renormalizar(uint32_t x, const unsigned char **p) {
+    if (x < ANS_L) {
+        x = (x << 16) | tomar_u16(*p);
+        *p += 2;
+    }
+    return x;
+}
+
+int ans_decodificar(const unsigned char *entrada, size_t n_entrada, unsigned char *salida, size_t n) {
+    EntradaAns tabla[ANS_ESCALA];
+    ssize_t encabezado = leer_frecuencias(entrada, n_entrada, tabla);
+    if (encabezado < 0 || n_entrada - encabezado < 4 * ANS_ESTADOS) return -1;
+
+    uint32_t x[ANS_ESTADOS];
+    const unsigned char *p = entrada + encabezado;
+    for (int j = 0; j < ANS_ESTADOS; j++) {
+        x[j] = leer_u32(p);
+        p += 4;
+        if (x[j] < ANS_L || x[j] >= ANS_L << 16) return -1;
+    }
+    const unsigned char *fin = entrada + n_entrada;
+
+    // Cada símbolo pide a lo sumo una palabra: mientras queden 4 por grupo no
+    // hace falta mirar el final. Los estados van en variables sueltas para
+    // que los bytes escritos en salida no obliguen a releerlos de memoria.
+    uint32_t x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3];
+    size_t i = 0;
+    for (; i + ANS_ESTADOS <= n && fin - p >= 2 * ANS_ESTADOS; i += ANS_ESTADOS) {
+        x0 = decodificar_simbolo(x0, tabla, salida + i);
+        x1 = decodificar_simbolo(x1, tabla, salida + i + 1);
+        x2 = decodificar_simbolo(x2, tabla, salida + i + 2);
+        x3 = decodificar_simbolo(x3, tabla, salida + i + 3);
+        x0 = renormalizar(x0, &p);
+        x1 = renormalizar(x1, &p);
+        x2 = renormalizar(x2, &p);
+        x3 = renormalizar(x3, &p);
+    }
+    x[0] = x0;
+    x[1] = x1;
+    x[2] = x2;
+    x[3] = x3;
+
+    for (; i < n; i++) {
+        uint32_t *e = &x[i % ANS_ESTADOS];
+        *e = decodificar_simbolo(*e, tabla, salida + i);
+        if (*e < ANS_L) {
+            if (fin - p < 2) return -1;
+            *e = (*e << 16) | tomar_u16(p);
+            p += 2;
+        }
+    }
+
+    // El codificador empezó con todos los estados en ANS_L
+    for (int j = 0; j < ANS_ESTADOS; j++) {
+        if (x[j] != ANS_L) return -1;
+    }
+    return p == fin ? 0 : -1;
+}
@@ -0,0 +1,48 @@
+#ifndef ANS_H
+#define ANS_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * Codificación rANS (--comp-alg ans): las frecuencias de un bloque se
+ * normalizan a 1 << ANS_BITS_ESCALA, así que cada símbolo ocupa casi
+ * exactamente -log2(p) bits, sin redondear a bits enteros como Huffman.
+ * Cuatro estados intercalados (el byte i usa el estado i % 4) y palabras de
+ * 16 bits; el decodificador resuelve cada símbolo con una tabla de
+ * 1 << ANS_BITS_ESCALA entradas, sin ramas por longitud de código.
+ *
+ * Un bloque codificado es:
+ *   [32 bytes: mapa de bits de los símbolos presentes]
+ *   [frecuencia - 1 de cada símbolo presente: 12 bits, de a dos en 3 bytes]
+ *   [4 estados finales: uint32 cada uno][palabras de 16 bits]
+ */
+
+#define ANS_BITS_ESCALA 12
+#define ANS_ESTADOS     4
+
+/**
+ * ans_cota - Lo más que puede ocupar un bloque de n bytes codificado
+ */
+size_t ans_cota(size_t n);
+
+/**
+ * ans_codificar - Codifica n bytes con su histograma
+ * @frequencies: histograma de los n bytes (de contar_frecuencias)
+ * @salida: al menos ans_cota(n) bytes
+ *
+ * Retorna: bytes escritos en salida
+ */
+size_t ans_codificar(const unsigned char *datos, size_t n, const unsigned long *frequencies,
+                     unsigned char *salida);
+
+/**
+ * ans_decodificar - Decodifica un bloque completo de n_entrada bytes
+ * @salida: n bytes
+ *
+ * Retorna: 0, o -1 si el bloque es inválido (frecuencias, palabras de más o
+ * de menos, o estados finales que no cierran)
+ */
+int ans_decodificar(const unsigned char *entrada, size_t n_entrada, unsigned char *salida, size_t n);
+
+#endif // ANS_H
@@ -0,0 +1,34 @@
+#include <unistd.h>
+#include "es.h"
+
+ssize_t leer_completo(int fd, void *buf, size_t n) {
+    size_t total = 0;
+    while (total < n) {
+        ssize_t r = read(fd, (unsigned char *)buf + total, n - total);
+        if (r < 0) return -1;
+        if (r == 0) break;
+        total += r;
+    }
+    return total;
+}
+
+int escribir_completo(int fd, const void *buf, size_t n) {
+    size_t total = 0;
+    while (total < n) {
+        ssize_t w = write(fd, (const unsigned char *)buf + total, n - total);
+        if (w <= 0) return -1;
+        total += w;
+    }
+    return 0;
+}
+
+void escribir_u32(unsigned char *p, unsigned int v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+unsigned int leer_u32(const unsigned char *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
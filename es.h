@@ -0,0 +1,24 @@
+#ifndef ES_H
+#define ES_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * Ayudas de E/S que comparten los codecs: lecturas y escrituras completas
+ * sobre un descriptor y los enteros de 32 bits de los formatos.
+ */
+
+// Lee hasta n bytes; menos solo al final de la entrada (una tubería o una
+// terminal pueden entregar de a poco). Retorna: bytes leídos, o -1 si hubo error
+ssize_t leer_completo(int fd, void *buf, size_t n);
+
+// Retorna: 0 si se escribieron los n bytes, -1 si no
+int escribir_completo(int fd, const void *buf, size_t n);
+
+// Campos de 32 bits de los encabezados y registros, siempre en little-endian
+// para que un archivo se lea igual en cualquier máquina
+void escribir_u32(unsigned char *p, unsigned int v);
+unsigned int leer_u32(const unsigned char *p);
+
+#endif // ES_H
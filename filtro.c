@@ -0,0 +1,406 @@
+#include <unistd.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "es.h"
+#include "filtro.h"
+#include "huffman.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const unsigned char MAGIA_DELTA[6] = { 'D', 'E', 'L', 'T', 'A', 0x01 };
+
+#define TAM_BUFFER_FILTRO       (1024 * 1024)
+#define MUESTRA_DETECCION       (64 * 1024)
+#define PASO_MAX_DETECCION      32      // pasos más largos hay que pedirlos con delta:N
+#define CABEZA_ESCALAR          32      // bytes del comienzo de cada llamada sin SIMD
+
+int filtro_parsear(const char *texto, ConfigFiltro *config) {
+    if (strncmp(texto, "delta", 5) != 0) return -1;
+    const char *paso = texto + 5;
+
+    config->activo = 1;
+    config->paso = FILTRO_PASO_AUTO;
+    if (*paso == '\0') return 0;
+    if (*paso != ':') return -1;
+    paso++;
+    if (strcmp(paso, "auto") == 0) return 0;
+
+    char *fin;
+    long n = strtol(paso, &fin, 10);
+    if (fin == paso || *fin != '\0' || n < 1 || n > FILTRO_PASO_MAX) return -1;
+    config->paso = (int)n;
+    return 0;
+}
+
+/**
+ * restar - out[i] = in[i] - in[i - paso]
+ * Lee los paso bytes anteriores a in.
+ */
+static void restar(const unsigned char *in, unsigned char *out, size_t n, size_t paso) {
+    size_t i = 0;
+#ifdef __SSE2__
+    for (; i + 16 <= n; i += 16) {
+        __m128i actual = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i previo = _mm_loadu_si128((const __m128i *)(in + i - paso));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_sub_epi8(actual, previo));
+    }
+#endif
+    for (; i < n; i++) out[i] = in[i] - in[i - paso];
+}
+
+int filtro_detectar_paso(const unsigned char *datos, size_t n) {
+    if (n > MUESTRA_DETECCION) n = MUESTRA_DETECCION;
+    // Todos los candidatos se miden sobre los mismos bytes
+    if (n <= 2 * PASO_MAX_DETECCION) return 0;
+    const unsigned char *muestra = datos + PASO_MAX_DETECCION;
+    unsigned long total = n - PASO_MAX_DETECCION;
+    unsigned char *diferencias = malloc(total);
+    if (!diferencias) return 0;
+
+    // Costo de orden 0 de cada histograma: coste_histograma con ref = h
+    unsigned long h[256] = {0};
+    contar_frecuencias(muestra, total, h);
+    unsigned long long mejor_coste = coste_histograma(h, h, total);
+    unsigned long long sin_filtro = mejor_coste;
+    int mejor = 0;
+
+    for (int paso = 1; paso <= PASO_MAX_DETECCION; paso++) {
+        restar(muestra, diferencias, total, paso);
+        memset(h, 0, sizeof(h));
+        contar_frecuencias(diferencias, total, h);
+        unsigned long long c = coste_histograma(h, h, total);
+        if (c < mejor_coste) {
+            mejor_coste = c;
+            mejor = paso;
+        }
+    }
+    free(diferencias);
+
+    // Un filtro que apenas mejora la muestra no vale el riesgo en el resto
+    return mejor_coste * 100 < sin_filtro * 97 ? mejor : 0;
+}
+
+#ifdef __SSE2__
+/**
+ * Suma prefija con paso 1, 2, 4 u 8 dentro de un vector: el byte j termina
+ * con la suma de j, j - paso, j - 2 * paso... (el caso sigue de largo a
+ * propósito: con paso 1 hacen falta los desplazamientos 1, 2, 4 y 8)
+ */
+static inline __m128i prefijo_potencia(__m128i v, size_t paso) {
+    switch (paso) {
+    case 1:
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 1));
+        /* fall through */
+    case 2:
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 2));
+        /* fall through */
+    case 4:
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+        /* fall through */
+    default:
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+    }
+    return v;
+}
+
+// Los últimos paso bytes de v repetidos en todo el vector
+static inline __m128i repetir_final(__m128i v, size_t paso) {
+    switch (paso) {
+    case 1:
+        v = _mm_unpackhi_epi8(v, v);
+        /* fall through */
+    case 2:
+        v = _mm_shufflehi_epi16(v, 0xFF);
+        /* fall through */
+    case 4:
+        return _mm_shuffle_epi32(v, 0xFF);
+    default:
+        return _mm_unpackhi_epi64(v, v);
+    }
+}
+#endif
+
+/**
+ * sumar - out[i] = in[i] + out[i - paso], lo inverso de restar
+ * Lee los paso bytes anteriores a out.
+ */
+static void sumar(const unsigned char *in, unsigned char *out, size_t n, size_t paso) {
+    size_t i = 0;
+#ifdef __SSE2__
+    // Los primeros bytes van uno a uno: así los vectores de abajo nunca
+    // leen antes de in ni más de paso bytes antes de out
+    for (; i < n && i < CABEZA_ESCALAR; i++) out[i] = in[i] + out[i - paso];
+
+    if (paso >= 16) {
+        // Lo que se suma ya está completo: un vector por vez
+        for (; i + 16 <= n; i += 16) {
+            __m128i d = _mm_loadu_si128((const __m128i *)(in + i));
+            __m128i previo = _mm_loadu_si128((const __m128i *)(out + i - paso));
+            _mm_storeu_si128((__m128i *)(out + i), _mm_add_epi8(d, previo));
+        }
+    } else if (paso == 1 || paso == 2 || paso == 4 || paso == 8) {
+        // Suma prefija dentro del vector más el final del anterior repetido
+        __m128i acarreo = repetir_final(_mm_loadu_si128((const __m128i *)(out + i - 16)), paso);
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = prefijo_potencia(_mm_loadu_si128((const __m128i *)(in + i)), paso);
+            v = _mm_add_epi8(v, acarreo);
+            _mm_storeu_si128((__m128i *)(out + i), v);
+            acarreo = repetir_final(v, paso);
+        }
+    } else {
+        // out[i] = in[i] + in[i - paso] + ... (k términos) + out[i - k * paso],
+        // con k * paso >= 16 para que lo último ya esté escrito
+        size_t k = (16 + paso - 1) / paso;
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(out + i - k * paso));
+            for (size_t j = 0; j < k; j++) {
+                v = _mm_add_epi8(v, _mm_loadu_si128((const __m128i *)(in + i - j * paso)));
+            }
+            _mm_storeu_si128((__m128i *)(out + i), v);
+        }
+    }
+#endif
+    for (; i < n; i++) out[i] = in[i] + out[i - paso];
+}
+
+static void escribir_encabezado(unsigned char *p, int paso) {
+    memcpy(p, MAGIA_DELTA, sizeof(MAGIA_DELTA));
+    p[6] = paso & 0xFF;
+    p[7] = paso >> 8;
+}
+
+// Retorna: el paso del encabezado, o -1 si no lo es
+static int leer_encabezado(const unsigned char *p) {
+    if (memcmp(p, MAGIA_DELTA, sizeof(MAGIA_DELTA)) != 0) return -1;
+    int paso = p[6] | (p[7] << 8);
+    return paso <= FILTRO_PASO_MAX ? paso : -1;
+}
+
+int filtro_tiene_encabezado(const unsigned char *datos, size_t n) {
+    return n >= FILTRO_TAM_ENCABEZADO && leer_encabezado(datos) >= 0;
+}
+
+int filtrar_memoria(const ConfigFiltro *config, const unsigned char *entrada, size_t n,
+                    unsigned char **salida, size_t *n_salida) {
+    int paso = config->paso != FILTRO_PASO_AUTO ? config->paso : filtro_detectar_paso(entrada, n);
+    unsigned char *out = malloc(FILTRO_TAM_ENCABEZADO + n);
+    if (!out) return -1;
+
+    escribir_encabezado(out, paso);
+    unsigned char *datos = out + FILTRO_TAM_ENCABEZADO;
+    size_t cabeza = (size_t)paso < n ? (size_t)paso : n;
+    memcpy(datos, entrada, paso ? cabeza : n);
+    if (paso) restar(entrada + cabeza, datos + cabeza, n - cabeza, paso);
+
+    *salida = out;
+    *n_salida = FILTRO_TAM_ENCABEZADO + n;
+    return 0;
+}
+
+int restaurar_memoria(const unsigned char *entrada, size_t n, unsigned char **salida, size_t *n_salida) {
+    int paso = n >= FILTRO_TAM_ENCABEZADO ? leer_encabezado(entrada) : -1;
+    if (paso < 0) {
+        escribir_salida("Error: los datos no tienen filtro delta\n");
+        return -1;
+    }
+    entrada += FILTRO_TAM_ENCABEZADO;
+    n -= FILTRO_TAM_ENCABEZADO;
+
+    unsigned char *out = malloc(n ? n : 1);
+    if (!out) return -1;
+    size_t cabeza = (size_t)paso < n ? (size_t)paso : n;
+    memcpy(out, entrada, paso ? cabeza : n);
+    if (paso) sumar(entrada + cabeza, out + cabeza, n - cabeza, paso);
+
+    *salida = out;
+    *n_salida = n;
+    return 0;
+}
+
+/**
+ * Si el codec deja de leer, el write al pipe falla con EPIPE en vez de
+ * matar el proceso: SIGPIPE queda bloqueada solo en el hilo del filtro.
+ */
+static void bloquear_sigpipe(void) {
+    sigset_t senales;
+    sigemptyset(&senales);
+    sigaddset(&senales, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &senales, NULL);
+}
+
+/**
+ * Los buffers llevan FILTRO_PASO_MAX bytes de historia delante: los últimos
+ * bytes del buffer anterior (ceros al principio del archivo, que es como si
+ * el archivo empezara precedido de ceros).
+ */
+static void *hilo_filtrar(void *arg) {
+    HiloFiltro *h = arg;
+    bloquear_sigpipe();
+
+    unsigned char *in = calloc(1, FILTRO_PASO_MAX + TAM_BUFFER_FILTRO);
+    unsigned char *out = malloc(TAM_BUFFER_FILTRO);
+    unsigned char *datos = in + FILTRO_PASO_MAX;
+    ssize_t n = in && out ? leer_completo(h->fd_origen, datos, TAM_BUFFER_FILTRO) : -1;
+
+    unsigned char encabezado[FILTRO_TAM_ENCABEZADO];
+    if (n >= 0) {
+        if (h->paso == FILTRO_PASO_AUTO) h->paso = filtro_detectar_paso(datos, n);
+        escribir_encabezado(encabezado, h->paso);
+        if (escribir_completo(h->fd_destino, encabezado, sizeof(encabezado)) != 0) n = -1;
+    }
+
+    size_t paso = h->paso;
+    while (n > 0) {
+        const unsigned char *filtrado = datos;
+        if (paso) {
+            restar(datos, out, n, paso);
+            filtrado = out;
+        }
+        if (escribir_completo(h->fd_destino, filtrado, n) != 0) {
+            n = -1;
+            break;
+        }
+        memmove(datos - paso, datos + n - paso, paso);
+        n = leer_completo(h->fd_origen, datos, TAM_BUFFER_FILTRO);
+    }
+
+    h->resultado = n < 0 ? -1 : 0;
+    close(h->fd_destino);
+    free(in);
+    free(out);
+    return NULL;
+}
+
+static void *hilo_restaurar(void *arg) {
+    HiloFiltro *h = arg;
+    bloquear_sigpipe();
+
+    unsigned char *in = malloc(TAM_BUFFER_FILTRO);
+    unsigned char *out = calloc(1, FILTRO_PASO_MAX + TAM_BUFFER_FILTRO);
+    unsigned char *datos = out + FILTRO_PASO_MAX;
+    unsigned char encabezado[FILTRO_TAM_ENCABEZADO];
+    int resultado = in && out ? 0 : -1;
+
+    if (resultado == 0) {
+        ssize_t leidos = leer_completo(h->fd_origen, encabezado, sizeof(encabezado));
+        h->paso = leidos == FILTRO_TAM_ENCABEZADO ? leer_encabezado(encabezado) : -1;
+        if (h->paso < 0 && h->automatico && leidos > 0) {
+            // Sin filtro: lo leído era parte de los datos y pasa tal cual
+            h->paso = 0;
+            if (escribir_completo(h->fd_destino, encabezado, leidos) != 0) resultado = -1;
+        } else if (h->paso < 0 && leidos != 0) {
+            // Sin nada que restaurar (entrada vacía o un error del codec) no hay encabezado
+            escribir_salida("Error: los datos no tienen filtro delta\n");
+            resultado = -1;
+        }
+    }
+
+    ssize_t n = 0;
+    size_t paso = h->paso > 0 ? h->paso : 0;
+    while (resultado == 0 && h->paso >= 0 && (n = leer_completo(h->fd_origen, in, TAM_BUFFER_FILTRO)) > 0) {
+        if (paso) sumar(in, datos, n, paso);
+        else memcpy(datos, in, n);
+        if (escribir_completo(h->fd_destino, datos, n) != 0) {
+            resultado = -1;
+            break;
+        }
+        memmove(datos - paso, datos + n - paso, paso);
+    }
+    if (n < 0) resultado = -1;
+
+    // El codec sigue escribiendo hasta terminar: hay que vaciar el pipe
+    if (resultado != 0 && in) {
+        while (read(h->fd_origen, in, TAM_BUFFER_FILTRO) > 0) {}
+    }
+
+    h->resultado = resultado;
+    close(h->fd_origen);
+    free(in);
+    free(out);
+    return NULL;
+}
+
+int filtro_iniciar_entrada(HiloFiltro *h, const ConfigFiltro *config, int fd_in) {
+    int extremos[2];
+    if (pipe(extremos) != 0) {
+        perror("pipe");
+        return -1;
+    }
+    h->fd_origen = fd_in;
+    h->fd_destino = extremos[1];
+    h->paso = config->paso;
+    h->resultado = 0;
+    if (pthread_create(&h->hilo, NULL, hilo_filtrar, h) != 0) {
+        close(extremos[0]);
+        close(extremos[1]);
+        return -1;
+    }
+    return extremos[0];
+}
+
+int filtro_iniciar_salida(HiloFiltro *h, int fd_out, int automatico) {
+    int extremos[2];
+    if (pipe(extremos) != 0) {
+        perror("pipe");
+        return -1;
+    }
+    h->fd_origen = extremos[0];
+    h->fd_destino = fd_out;
+    h->paso = 0;
+    h->automatico = automatico;
+    h->resultado = 0;
+    if (pthread_create(&h->hilo, NULL, hilo_restaurar, h) != 0) {
+        close(extremos[0]);
+        close(extremos[1]);
+        return -1;
+    }
+    return extremos[1];
+}
+
+/**
+ * Cada trozo se lee FILTRO_TAM_ENCABEZADO bytes más adelante de donde se
+ * escribe ya restaurado, así que la escritura nunca pisa lo que falta leer
+ */
+int filtro_restaurar_archivo(int fd) {
+    unsigned char encabezado[FILTRO_TAM_ENCABEZADO];
+    if (pread(fd, encabezado, sizeof(encabezado), 0) != (ssize_t)sizeof(encabezado)) return 0;
+    int paso = leer_encabezado(encabezado);
+    if (paso < 0) return 0;
+
+    unsigned char *in = malloc(TAM_BUFFER_FILTRO);
+    unsigned char *out = calloc(1, FILTRO_PASO_MAX + TAM_BUFFER_FILTRO);
+    unsigned char *datos = out + FILTRO_PASO_MAX;
+    int resultado = in && out ? 1 : -1;
+
+    off_t escritura = 0;
+    while (resultado == 1) {
+        ssize_t n = pread(fd, in, TAM_BUFFER_FILTRO, escritura + FILTRO_TAM_ENCABEZADO);
+        if (n < 0) resultado = -1;
+        if (n <= 0) break;
+        if (paso) sumar(in, datos, n, paso);
+        else memcpy(datos, in, n);
+        if (pwrite(fd, datos, n, escritura) != n) {
+            resultado = -1;
+            break;
+        }
+        memmove(datos - paso, datos + n - paso, paso);
+        escritura += n;
+    }
+    if (resultado == 1 && ftruncate(fd, escritura) != 0) resultado = -1;
+    if (resultado < 0) escribir_salida("Error: no se pudo deshacer el filtro delta\n");
+
+    free(in);
+    free(out);
+    return resultado;
+}
+
+int filtro_terminar(HiloFiltro *h, int fd_codec) {
+    close(fd_codec);
+    pthread_join(h->hilo, NULL);
+    return h->resultado;
+}
@@ -0,0 +1,96 @@
+#ifndef FILTRO_H
+#define FILTRO_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+/**
+ * Filtro delta previo al codec (--filter delta:N).
+ *
+ * Cada byte se reemplaza por su diferencia con el que está N bytes antes.
+ * En registros de ancho fijo (muestras de sensores, píxeles, enteros) los
+ * campos vecinos se parecen y las diferencias quedan cerca de 0, que es lo
+ * que aprovechan Huffman, LZ77 y RLE. Con delta o delta:auto el paso se
+ * elige mirando una muestra del comienzo: el que deja el menor costo de
+ * orden 0, o ninguno (paso 0) si no mejora.
+ *
+ * Los datos filtrados empiezan con [magia "DELTA\x01"][uint16 paso], así que
+ * al descomprimir el filtro se detecta y se deshace aunque no se pase
+ * --filter.
+ */
+
+#define FILTRO_PASO_MAX         255
+#define FILTRO_PASO_AUTO        0       // en ConfigFiltro.paso: elegirlo de los datos
+#define FILTRO_TAM_ENCABEZADO   8
+
+typedef struct {
+    int activo;
+    int paso;               // 1..FILTRO_PASO_MAX, o FILTRO_PASO_AUTO
+} ConfigFiltro;
+
+/**
+ * filtro_parsear - Interpreta "delta", "delta:auto" o "delta:N"
+ * Retorna: 0, o -1 si no es válido
+ */
+int filtro_parsear(const char *texto, ConfigFiltro *config);
+
+/**
+ * filtro_detectar_paso - Paso que mejor predice cada byte en la muestra
+ * Retorna: el paso, o 0 si ninguno baja el costo de orden 0
+ */
+int filtro_detectar_paso(const unsigned char *datos, size_t n);
+
+// Variantes sobre buffers completos (*salida se reserva con malloc)
+int filtrar_memoria(const ConfigFiltro *config, const unsigned char *entrada, size_t n,
+                    unsigned char **salida, size_t *n_salida);
+int restaurar_memoria(const unsigned char *entrada, size_t n, unsigned char **salida, size_t *n_salida);
+
+// Retorna: 1 si datos empieza con el encabezado del filtro, 0 si no
+int filtro_tiene_encabezado(const unsigned char *datos, size_t n);
+
+/**
+ * filtro_restaurar_archivo - Deshace el filtro de un archivo ya descomprimido
+ * @fd: Archivo regular abierto para leer y escribir
+ *
+ * Si no empieza con el encabezado no lo toca; si lo tiene, lo restaura en el
+ * lugar y lo acorta. Retorna: 1 si tenía filtro, 0 si no, -1 si hubo error
+ */
+int filtro_restaurar_archivo(int fd);
+
+/**
+ * Variante sobre descriptores: un hilo aplica el filtro entre el archivo y
+ * el codec a través de un pipe, y el codec lo ve como una entrada o salida
+ * secuencial más (igual que -i - / -o -).
+ */
+typedef struct {
+    pthread_t hilo;
+    int fd_origen;
+    int fd_destino;
+    int paso;
+    int automatico;         // al restaurar: sin encabezado los datos pasan tal cual
+    int resultado;          // 0, o -1 si el hilo falló
+} HiloFiltro;
+
+/**
+ * filtro_iniciar_entrada - Filtra fd_in hacia un pipe
+ * Retorna: el extremo de lectura que debe consumir el codec, o -1
+ */
+int filtro_iniciar_entrada(HiloFiltro *h, const ConfigFiltro *config, int fd_in);
+
+/**
+ * filtro_iniciar_salida - Deshace el filtro de lo que el codec escriba
+ * @automatico: Si no hay encabezado, copiar los datos en vez de fallar
+ * Retorna: el extremo de escritura que debe usar el codec, o -1
+ */
+int filtro_iniciar_salida(HiloFiltro *h, int fd_out, int automatico);
+
+/**
+ * filtro_terminar - Cierra el extremo del codec y espera al hilo
+ * Retorna: 0, o -1 si el filtro falló
+ */
+int filtro_terminar(HiloFiltro *h, int fd_codec);
+
+// Funciones auxiliares
+void escribir_salida(const char *msg);
+
+#endif // FILTRO_H
@@ -2,28 +2,29 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <stdlib.h>
+#include <string.h>
+#include "huffman.h"
+#include "ans.h"
+#include "es.h"
+#include "mapeo.h"
+#include "pool.h"
 
-#define MAX_TREE_NODES 512
 #define MAX_CODE_LENGTH 256
 
-// Estructura para nodo del árbol de Huffman
-typedef struct HuffmanNode {
-    unsigned char byte;
-    unsigned long frequency;
-    struct HuffmanNode *left;
-    struct HuffmanNode *right;
-} HuffmanNode;
+// Longitud máxima de los códigos canónicos que lee el formato por bloques
+// (cabe en 4 bits). Al comprimir se usa LONGITUD_LIMITE: con 12 bits casi
+// todos los símbolos se resuelven en la tabla principal del decodificador.
+#define HUFFMAN_MAX_LONGITUD    15
+#define LONGITUD_LIMITE         12
 
-// Estructura para tabla de códigos
+// Estructura para tabla de códigos: el código va alineado a la derecha y su
+// primer bit es el más significativo (con length <= 64)
 typedef struct {
-    unsigned char bits[MAX_CODE_LENGTH];
+    unsigned long long bits;
     int length;
 } HuffmanCode;
 
-// Pool de nodos (evita malloc/free)
-static HuffmanNode node_pool[MAX_TREE_NODES];
-static int node_pool_index = 0;
-
 // Funciones auxiliares
 void escribir_salida(const char *msg) {
     int len = 0;
@@ -46,11 +47,11 @@ int comparar_cadena(const char *s1, const char *s2) {
     return s1[i] == s2[i];
 }
 
-// Crear nuevo nodo
-HuffmanNode* crear_nodo(unsigned char byte, unsigned long freq) {
-    if (node_pool_index >= MAX_TREE_NODES) return 0;
+// Crear nuevo nodo (tomado del pool del contexto)
+HuffmanNode* crear_nodo(HuffmanContexto *ctx, unsigned char byte, unsigned long freq) {
+    if (ctx->node_pool_index >= MAX_TREE_NODES) return 0;
     
-    HuffmanNode *node = &node_pool[node_pool_index++];
+    HuffmanNode *node = &ctx->node_pool[ctx->node_pool_index++];
     node->byte = byte;
     node->frequency = freq;
     node->left = 0;
@@ -116,14 +117,14 @@ HuffmanNode* pq_extract_min(PriorityQueue *pq) {
 }
 
 // Construir árbol de Huffman
-HuffmanNode* construir_arbol_huffman(unsigned long *frequencies) {
+HuffmanNode* construir_arbol_huffman(HuffmanContexto *ctx, unsigned long *frequencies) {
     PriorityQueue pq;
     pq_init(&pq);
     
     // Crear nodos hoja para cada byte con frecuencia > 0
     for (int i = 0; i < 256; i++) {
         if (frequencies[i] > 0) {
-            HuffmanNode *node = crear_nodo((unsigned char)i, frequencies[i]);
+            HuffmanNode *node = crear_nodo(ctx, (unsigned char)i, frequencies[i]);
             pq_insert(&pq, node);
         }
     }
@@ -133,7 +134,7 @@ HuffmanNode* construir_arbol_huffman(unsigned long *frequencies) {
         HuffmanNode *left = pq_extract_min(&pq);
         HuffmanNode *right = pq_extract_min(&pq);
         
-        HuffmanNode *parent = crear_nodo(0, left->frequency + right->frequency);
+        HuffmanNode *parent = crear_nodo(ctx, 0, left->frequency + right->frequency);
         parent->left = left;
         parent->right = right;
         
@@ -144,182 +145,412 @@ HuffmanNode* construir_arbol_huffman(unsigned long *frequencies) {
 }
 
 // Generar códigos Huffman
-void generar_codigos(HuffmanNode *node, unsigned char *code, int depth, HuffmanCode *codes) {
+void generar_codigos(HuffmanNode *node, unsigned long long code, int depth, HuffmanCode *codes) {
     if (!node) return;
     
     if (!node->left && !node->right) {
         // Nodo hoja
         codes[node->byte].length = depth;
-        for (int i = 0; i < depth; i++) {
-            codes[node->byte].bits[i] = code[i];
-        }
+        codes[node->byte].bits = code;
         return;
     }
     
     if (node->left) {
-        code[depth] = 0;
-        generar_codigos(node->left, code, depth + 1, codes);
+        generar_codigos(node->left, code << 1, depth + 1, codes);
     }
     
     if (node->right) {
-        code[depth] = 1;
-        generar_codigos(node->right, code, depth + 1, codes);
+        generar_codigos(node->right, (code << 1) | 1, depth + 1, codes);
     }
 }
 
-// Escribir bits en un buffer
+// Destino de los bytes producidos: un descriptor, un buffer en memoria o una tubería
 typedef struct {
-    unsigned char buffer[4096];
-    int byte_pos;
-    int bit_pos;
+    int fd;
+    unsigned char *mem;     // si no es NULL se escribe aquí en vez de en fd
+    size_t pos;
+    EscritorTuberia *tuberia;
+} Destino;
+
+int destino_escribir(Destino *d, const void *datos, size_t n) {
+    if (d->mem) {
+        memcpy(d->mem + d->pos, datos, n);
+        d->pos += n;
+        return 0;
+    }
+    if (d->tuberia) {
+        if (escritor_tuberia_escribir(d->tuberia, datos, n) != 0) return -1;
+        d->pos += n;
+        return 0;
+    }
+    if (write(d->fd, datos, n) != (ssize_t)n) return -1;
+    d->pos += n;
+    return 0;
+}
+
+// Origen de los bytes: un descriptor, un buffer en memoria o una tubería
+typedef struct {
+    int fd;
+    const unsigned char *mem;   // si no es NULL se lee de aquí en vez de fd
+    size_t len;
+    size_t pos;
+    LectorTuberia *tuberia;
+} Origen;
+
+ssize_t origen_leer(Origen *o, void *buf, size_t n) {
+    if (o->mem) {
+        size_t quedan = o->len - o->pos;
+        if (n > quedan) n = quedan;
+        memcpy(buf, o->mem + o->pos, n);
+        o->pos += n;
+        return n;
+    }
+    if (o->tuberia) return lector_tuberia_leer(o->tuberia, buf, n);
+    return read(o->fd, buf, n);
+}
+
+// Escribir bits de a palabras de 64 (en un buffer, o directamente en la
+// memoria del destino). Los códigos se acumulan desde el bit más significativo
+typedef struct {
+    unsigned long long acumulador;
+    int ocupados;               // bits usados del acumulador
+    unsigned char buffer[16384];
+    unsigned char *datos;       // buffer, o destino->mem + destino->pos
+    size_t byte_pos;
+    Destino *destino;
 } BitWriter;
 
 void bw_init(BitWriter *bw) {
+    bw->acumulador = 0;
+    bw->ocupados = 0;
     bw->byte_pos = 0;
-    bw->bit_pos = 0;
-    bw->buffer[0] = 0;
+    bw->datos = bw->destino->mem ? bw->destino->mem + bw->destino->pos : bw->buffer;
 }
 
-void bw_write_bit(BitWriter *bw, int bit) {
-    if (bit) {
-        bw->buffer[bw->byte_pos] |= (1 << (7 - bw->bit_pos));
+// Pasa lo escrito al destino (en memoria ya está en su lugar: solo avanzar)
+static int bw_vaciar(BitWriter *bw) {
+    if (bw->destino->mem) {
+        bw->destino->pos += bw->byte_pos;
+        bw->datos += bw->byte_pos;
+    } else if (bw->byte_pos > 0) {
+        if (destino_escribir(bw->destino, bw->buffer, bw->byte_pos) != 0) return -1;
     }
-    
-    bw->bit_pos++;
-    if (bw->bit_pos == 8) {
-        bw->bit_pos = 0;
-        bw->byte_pos++;
-        if (bw->byte_pos < 4096) {
-            bw->buffer[bw->byte_pos] = 0;
-        }
+    bw->byte_pos = 0;
+    return 0;
+}
+
+// Agregar un código de 1 a 64 bits
+static inline int bw_write(BitWriter *bw, unsigned long long codigo, int longitud) {
+    int libres = 64 - bw->ocupados;
+    if (longitud < libres) {
+        bw->acumulador |= codigo << (libres - longitud);
+        bw->ocupados += longitud;
+        return 0;
     }
+
+    // La palabra se completa: escribirla entera y dejar el resto del código
+    int resto = longitud - libres;
+    unsigned long long palabra = __builtin_bswap64(bw->acumulador | (codigo >> resto));
+    memcpy(bw->datos + bw->byte_pos, &palabra, 8);
+    bw->byte_pos += 8;
+    bw->acumulador = resto ? codigo << (64 - resto) : 0;
+    bw->ocupados = resto;
+
+    if (!bw->destino->mem && bw->byte_pos + 8 > sizeof(bw->buffer)) return bw_vaciar(bw);
+    return 0;
 }
 
-int bw_flush(BitWriter *bw, int fd) {
-    int bytes_to_write = bw->byte_pos;
-    if (bw->bit_pos > 0) bytes_to_write++;
-    
-    if (bytes_to_write > 0) {
-        if (write(fd, bw->buffer, bytes_to_write) != bytes_to_write) {
-            return -1;
+// Escribir los bits que quedan (el último byte se completa con ceros)
+int bw_flush(BitWriter *bw) {
+    for (int i = 0; i < bw->ocupados; i += 8) {
+        if (!bw->destino->mem && bw->byte_pos == sizeof(bw->buffer)) {
+            if (bw_vaciar(bw) != 0) return -1;
         }
+        bw->datos[bw->byte_pos++] = bw->acumulador >> (56 - i);
     }
+    if (bw_vaciar(bw) != 0) return -1;
     
     bw_init(bw);
     return 0;
 }
 
-// Comprimir archivo
-int comprimir_archivo_huffman(const char *entrada, const char *salida) {
-    node_pool_index = 0;
-    
-    // Paso 1: Contar frecuencias
-    unsigned long frequencies[256] = {0};
-    
-    int fd_in = open(entrada, O_RDONLY);
-    if (fd_in == -1) {
-        escribir_salida("Error: No se pudo abrir archivo de entrada\n");
-        return -1;
+void huffman_contexto_init(HuffmanContexto *ctx) {
+    ctx->node_pool_index = 0;
+    ctx->hilos = 1;
+    ctx->muestreo = 0;
+    ctx->tabla = NULL;
+    ctx->ans = 0;
+}
+
+/**
+ * contar_frecuencias - Acumular el histograma de un bloque
+ *
+ * Con un solo contador por byte, una racha de bytes iguales encadena cada
+ * incremento con el anterior (lectura de un valor que todavía se está
+ * escribiendo). Por eso se reparten los bytes entre 4 tablas, se leen de a
+ * 16 y las tablas se suman al final.
+ */
+void contar_frecuencias(const unsigned char *buffer, size_t n, unsigned long *frequencies) {
+    unsigned int tablas[4][256];
+
+    while (n > 0) {
+        // Tramos de hasta 1 GB para que los contadores de 32 bits no desborden
+        size_t tramo = n < (1UL << 30) ? n : (1UL << 30);
+        memset(tablas, 0, sizeof(tablas));
+
+        size_t i = 0;
+        for (; i + 16 <= tramo; i += 16) {
+            unsigned long long a, b;
+            memcpy(&a, buffer + i, 8);
+            memcpy(&b, buffer + i + 8, 8);
+            tablas[0][a & 0xFF]++;
+            tablas[1][(a >> 8) & 0xFF]++;
+            tablas[2][(a >> 16) & 0xFF]++;
+            tablas[3][(a >> 24) & 0xFF]++;
+            tablas[0][(a >> 32) & 0xFF]++;
+            tablas[1][(a >> 40) & 0xFF]++;
+            tablas[2][(a >> 48) & 0xFF]++;
+            tablas[3][a >> 56]++;
+            tablas[0][b & 0xFF]++;
+            tablas[1][(b >> 8) & 0xFF]++;
+            tablas[2][(b >> 16) & 0xFF]++;
+            tablas[3][(b >> 24) & 0xFF]++;
+            tablas[0][(b >> 32) & 0xFF]++;
+            tablas[1][(b >> 40) & 0xFF]++;
+            tablas[2][(b >> 48) & 0xFF]++;
+            tablas[3][b >> 56]++;
+        }
+        for (; i < tramo; i++) {
+            tablas[i & 3][buffer[i]]++;
+        }
+
+        for (int s = 0; s < 256; s++) {
+            frequencies[s] += (unsigned long)tablas[0][s] + tablas[1][s] + tablas[2][s] + tablas[3][s];
+        }
+        buffer += tramo;
+        n -= tramo;
     }
-    
-    unsigned char buffer[4096];
-    ssize_t bytes_leidos;
-    unsigned long total_bytes = 0;
-    
-    while ((bytes_leidos = read(fd_in, buffer, 4096)) > 0) {
-        for (ssize_t i = 0; i < bytes_leidos; i++) {
-            frequencies[buffer[i]]++;
-            total_bytes++;
+}
+
+/**
+ * contar_bits - Bits que ocupan n bytes codificados
+ * Retorna: la cantidad de bits, o -1 si algún byte no tiene código
+ */
+static long long contar_bits(const HuffmanCode *codes, const unsigned char *buffer, size_t n) {
+    long long bits[4] = {0};
+    int sin_codigo = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        int a = codes[buffer[i]].length, b = codes[buffer[i + 1]].length;
+        int c = codes[buffer[i + 2]].length, d = codes[buffer[i + 3]].length;
+        sin_codigo |= (a == 0) | (b == 0) | (c == 0) | (d == 0);
+        bits[0] += a;
+        bits[1] += b;
+        bits[2] += c;
+        bits[3] += d;
+    }
+    for (; i < n; i++) {
+        sin_codigo |= codes[buffer[i]].length == 0;
+        bits[0] += codes[buffer[i]].length;
+    }
+    return sin_codigo ? -1 : bits[0] + bits[1] + bits[2] + bits[3];
+}
+
+// Codificar un bloque con la tabla de códigos
+int codificar_bloque(const HuffmanCode *codes, const unsigned char *buffer, size_t n, BitWriter *bw) {
+    for (size_t i = 0; i < n; i++) {
+        const HuffmanCode *hc = &codes[buffer[i]];
+        if (bw_write(bw, hc->bits, hc->length) != 0) {
+            return -1;
         }
     }
-    
-    close(fd_in);
-    
-    if (total_bytes == 0) {
-        escribir_salida("Archivo vacio\n");
-        return -1;
+    return 0;
+}
+
+// Como codificar_bloque, pero retorna 1 si un byte no tiene código (histograma estimado)
+static int codificar_bloque_verificado(const HuffmanCode *codes, const unsigned char *buffer, size_t n,
+                                       BitWriter *bw) {
+    for (size_t i = 0; i < n; i++) {
+        const HuffmanCode *hc = &codes[buffer[i]];
+        if (hc->length == 0) return 1;
+        if (bw_write(bw, hc->bits, hc->length) != 0) {
+            return -1;
+        }
     }
-    
-    // Paso 2: Construir árbol de Huffman
-    HuffmanNode *root = construir_arbol_huffman(frequencies);
+    return 0;
+}
+
+// Árbol y códigos a partir del histograma (pasos 2 y 3)
+int preparar_codigos(HuffmanContexto *ctx, unsigned long *frequencies, HuffmanCode *codes) {
+    HuffmanNode *root = construir_arbol_huffman(ctx, frequencies);
     if (!root) {
         escribir_salida("Error al construir arbol\n");
         return -1;
     }
-    
-    // Paso 3: Generar códigos
-    HuffmanCode codes[256] = {0};
-    unsigned char code[MAX_CODE_LENGTH];
-    generar_codigos(root, code, 0, codes);
-    
-    // Paso 4: Escribir archivo comprimido
-    int fd_out = open(salida, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-    if (fd_out == -1) {
-        escribir_salida("Error: No se pudo crear archivo de salida\n");
-        return -1;
+
+    generar_codigos(root, 0, 0, codes);
+    return 0;
+}
+
+/**
+ * limitar_longitudes - Acota las longitudes de los códigos a max bits
+ *
+ * Los códigos más largos se recortan a max, lo que rompe la desigualdad de
+ * Kraft; se compensa alargando en un bit los códigos más largos que todavía
+ * tienen lugar (entre ellos, los menos frecuentes). El espacio que sobre al
+ * final se devuelve acortando los símbolos más frecuentes.
+ */
+static void limitar_longitudes(HuffmanCode *codes, const unsigned long *frequencies, int max) {
+    const unsigned long long limite = 1ULL << max;
+    unsigned long long kraft = 0;
+    int presentes = 0;
+
+    for (int s = 0; s < 256; s++) {
+        if (codes[s].length == 0) continue;
+        if (codes[s].length > max) codes[s].length = max;
+        kraft += 1ULL << (max - codes[s].length);
+        presentes++;
     }
-    
-    // Escribir encabezado: total_bytes
-    write(fd_out, &total_bytes, sizeof(unsigned long));
-    
-    // Escribir frecuencias
-    write(fd_out, frequencies, sizeof(frequencies));
-    
-    // Comprimir datos
-    fd_in = open(entrada, O_RDONLY);
-    BitWriter bw;
-    bw_init(&bw);
-    
-    while ((bytes_leidos = read(fd_in, buffer, 4096)) > 0) {
-        for (ssize_t i = 0; i < bytes_leidos; i++) {
-            HuffmanCode *hc = &codes[buffer[i]];
-            for (int j = 0; j < hc->length; j++) {
-                bw_write_bit(&bw, hc->bits[j]);
-                
-                if (bw.byte_pos >= 4000) {
-                    if (bw_flush(&bw, fd_out) != 0) {
-                        close(fd_in);
-                        close(fd_out);
-                        return -1;
-                    }
-                }
+    if (presentes < 2) return;
+
+    while (kraft > limite) {
+        int elegido = -1;
+        for (int s = 0; s < 256; s++) {
+            int l = codes[s].length;
+            if (l == 0 || l >= max) continue;
+            if (elegido < 0 || l > codes[elegido].length ||
+                (l == codes[elegido].length && frequencies[s] < frequencies[elegido])) {
+                elegido = s;
             }
         }
+        kraft -= 1ULL << (max - codes[elegido].length - 1);
+        codes[elegido].length++;
+    }
+
+    // Símbolos de mayor a menor frecuencia (inserción: son a lo sumo 256)
+    int orden[256];
+    int k = 0;
+    for (int s = 0; s < 256; s++) {
+        if (codes[s].length == 0) continue;
+        int i = k++;
+        while (i > 0 && frequencies[orden[i - 1]] < frequencies[s]) {
+            orden[i] = orden[i - 1];
+            i--;
+        }
+        orden[i] = s;
+    }
+    for (int i = 0; i < k; i++) {
+        HuffmanCode *c = &codes[orden[i]];
+        while (c->length > 1 && kraft + (1ULL << (max - c->length)) <= limite) {
+            kraft += 1ULL << (max - c->length);
+            c->length--;
+        }
+    }
+}
+
+/**
+ * asignar_canonicos - Códigos canónicos a partir de las longitudes
+ *
+ * Los códigos de cada longitud son consecutivos y siguen el orden de los
+ * símbolos, así que las longitudes alcanzan para reconstruirlos.
+ */
+static void asignar_canonicos(HuffmanCode *codes) {
+    int cuenta[HUFFMAN_MAX_LONGITUD + 1] = {0};
+    for (int s = 0; s < 256; s++) cuenta[codes[s].length]++;
+    cuenta[0] = 0;
+
+    unsigned long long siguiente[HUFFMAN_MAX_LONGITUD + 1];
+    unsigned long long codigo = 0;
+    for (int l = 1; l <= HUFFMAN_MAX_LONGITUD; l++) {
+        codigo = (codigo + cuenta[l - 1]) << 1;
+        siguiente[l] = codigo;
+    }
+    for (int s = 0; s < 256; s++) {
+        if (codes[s].length > 0) codes[s].bits = siguiente[codes[s].length]++;
+    }
+}
+
+// Origen sobre fd_in: lectura directa, o en tubería si hay configuración
+static int origen_abrir(Origen *o, int fd_in, const ConfigTuberia *config) {
+    memset(o, 0, sizeof(*o));
+    o->fd = fd_in;
+    if (config) {
+        o->tuberia = lector_tuberia_crear(fd_in, config);
+        if (!o->tuberia) return -1;
+    }
+    return 0;
+}
+
+static void origen_cerrar(Origen *o) {
+    lector_tuberia_destruir(o->tuberia);
+    o->tuberia = NULL;
+}
+
+// Lee hasta n bytes (menos solo al final de la entrada)
+static ssize_t origen_leer_todo(Origen *o, void *buf, size_t n) {
+    size_t total = 0;
+    while (total < n) {
+        ssize_t r = origen_leer(o, (unsigned char *)buf + total, n - total);
+        if (r < 0) return -1;
+        if (r == 0) break;
+        total += r;
+    }
+    return total;
+}
+
+static int destino_abrir(Destino *d, int fd_out, const ConfigTuberia *config) {
+    memset(d, 0, sizeof(*d));
+    d->fd = fd_out;
+    if (config) {
+        d->tuberia = escritor_tuberia_crear(fd_out, config);
+        if (!d->tuberia) return -1;
     }
-    
-    bw_flush(&bw, fd_out);
-    
-    close(fd_in);
-    close(fd_out);
-    
     return 0;
 }
 
-// Leer bits
+static int destino_cerrar(Destino *d) {
+    if (!d->tuberia) return 0;
+    int r = escritor_tuberia_cerrar(d->tuberia);
+    d->tuberia = NULL;
+    return r;
+}
+
+// Leer bits (de un buffer, o directamente de la memoria del origen)
 typedef struct {
     unsigned char buffer[4096];
-    int byte_pos;
+    const unsigned char *datos;
+    size_t byte_pos;
     int bit_pos;
-    int bytes_available;
-    int fd;
+    size_t bytes_available;
+    Origen *origen;
 } BitReader;
 
-void br_init(BitReader *br, int fd) {
+void br_init(BitReader *br, Origen *origen) {
     br->byte_pos = 0;
     br->bit_pos = 0;
     br->bytes_available = 0;
-    br->fd = fd;
+    br->origen = origen;
 }
 
 int br_read_bit(BitReader *br) {
     if (br->byte_pos >= br->bytes_available) {
-        br->bytes_available = read(br->fd, br->buffer, 4096);
-        if (br->bytes_available <= 0) return -1;
+        Origen *o = br->origen;
+        if (o->mem) {
+            // Tomar todo lo que queda sin copiarlo
+            br->datos = o->mem + o->pos;
+            br->bytes_available = o->len - o->pos;
+            o->pos = o->len;
+        } else {
+            ssize_t leidos = origen_leer(o, br->buffer, 4096);
+            br->datos = br->buffer;
+            br->bytes_available = leidos > 0 ? leidos : 0;
+        }
+        if (br->bytes_available == 0) return -1;
         br->byte_pos = 0;
         br->bit_pos = 0;
     }
     
-    int bit = (br->buffer[br->byte_pos] >> (7 - br->bit_pos)) & 1;
+    int bit = (br->datos[br->byte_pos] >> (7 - br->bit_pos)) & 1;
     
     br->bit_pos++;
     if (br->bit_pos == 8) {
@@ -330,50 +561,337 @@ int br_read_bit(BitReader *br) {
     return bit;
 }
 
-// Descomprimir archivo
-int descomprimir_archivo_huffman(const char *entrada, const char *salida) {
-    node_pool_index = 0;
-    
-    int fd_in = open(entrada, O_RDONLY);
-    if (fd_in == -1) {
-        escribir_salida("Error: No se pudo abrir archivo de entrada\n");
-        return -1;
+/**
+ * Decodificación por tablas: en vez de bajar por el árbol bit a bit, se miran
+ * los próximos TABLA_BITS bits del acumulador y una sola consulta a la tabla
+ * da el símbolo (o los dos símbolos, si ambos códigos caben) y cuántos bits
+ * consume. Los códigos más largos que TABLA_BITS siguen en subtablas de
+ * SUBTABLA_BITS bits, encadenadas las veces que haga falta.
+ */
+#define TABLA_BITS          11
+#define FLUJOS_BLOQUE       4       // flujos intercalados de un bloque grande
+#define SUBTABLA_BITS       8
+#define MAX_LONGITUD_TABLA  56      // bits que garantiza el acumulador tras llenarlo
+
+enum { ENTRADA_INVALIDA, ENTRADA_SIMBOLO, ENTRADA_PAR, ENTRADA_SUBTABLA };
+
+typedef struct {
+    unsigned int valor;         // símbolo(s), el primero en el byte bajo; o inicio de la subtabla
+    unsigned char tipo;
+    unsigned char bits;         // bits que consume la entrada (en subtablas: bits del índice)
+    unsigned char bits1;        // bits del primer símbolo (en subtablas: bits ya consumidos)
+    unsigned char relleno;
+} EntradaDecodificacion;
+
+typedef struct {
+    EntradaDecodificacion *entradas;    // [0, 1 << TABLA_BITS) es la tabla principal
+    size_t cantidad;
+    size_t capacidad;
+} TablaDecodificacion;
+
+// Tabla preentrenada: códigos para los 256 bytes y su tabla de decodificación
+struct TablaHuffman {
+    unsigned int id;
+    HuffmanCode codes[256];
+    TablaDecodificacion decodificacion;
+};
+
+// Agrega n entradas inválidas al final. Retorna: su posición, o -1
+static long tabla_reservar(TablaDecodificacion *t, size_t n) {
+    if (t->cantidad + n > t->capacidad) {
+        size_t capacidad = t->capacidad ? t->capacidad : 4096;
+        while (capacidad < t->cantidad + n) capacidad *= 2;
+        EntradaDecodificacion *nuevas = realloc(t->entradas, capacidad * sizeof(*nuevas));
+        if (!nuevas) return -1;
+        t->entradas = nuevas;
+        t->capacidad = capacidad;
     }
-    
-    // Leer encabezado
-    unsigned long total_bytes;
-    if (read(fd_in, &total_bytes, sizeof(unsigned long)) != sizeof(unsigned long)) {
-        escribir_salida("Error al leer encabezado\n");
-        close(fd_in);
-        return -1;
+    memset(t->entradas + t->cantidad, 0, n * sizeof(*t->entradas));
+    long base = t->cantidad;
+    t->cantidad += n;
+    return base;
+}
+
+/**
+ * Llena la tabla de 2^k entradas en base, que resuelve los bits
+ * [prefijo, prefijo + k) de los códigos que empiezan con valor_prefijo.
+ */
+static int tabla_llenar(TablaDecodificacion *t, size_t base, int prefijo, int k,
+                        unsigned long long valor_prefijo, const HuffmanCode *codes) {
+    for (int s = 0; s < 256; s++) {
+        int l = codes[s].length;
+        unsigned long long codigo = codes[s].bits;
+        if (l <= prefijo) continue;
+        if (prefijo > 0 && (codigo >> (l - prefijo)) != valor_prefijo) continue;
+
+        if (l <= prefijo + k) {
+            // Todas las entradas cuyos primeros bits son el resto del código
+            int libres = prefijo + k - l;
+            size_t inicio = (codigo & ((1ULL << (l - prefijo)) - 1)) << libres;
+            for (size_t i = 0; i < ((size_t)1 << libres); i++) {
+                EntradaDecodificacion *e = &t->entradas[base + inicio + i];
+                e->tipo = ENTRADA_SIMBOLO;
+                e->valor = s;
+                e->bits = l;
+            }
+        } else {
+            // Marca la entrada; bits guarda por ahora el código más largo que cae ahí
+            size_t i = (codigo >> (l - prefijo - k)) & ((1ULL << k) - 1);
+            EntradaDecodificacion *e = &t->entradas[base + i];
+            e->tipo = ENTRADA_SUBTABLA;
+            if (l > e->bits) e->bits = l;
+        }
     }
-    
-    // Leer frecuencias
-    unsigned long frequencies[256];
-    if (read(fd_in, frequencies, sizeof(frequencies)) != sizeof(frequencies)) {
-        escribir_salida("Error al leer frecuencias\n");
-        close(fd_in);
-        return -1;
+
+    for (size_t i = 0; i < ((size_t)1 << k); i++) {
+        if (t->entradas[base + i].tipo != ENTRADA_SUBTABLA) continue;
+
+        int resto = t->entradas[base + i].bits - (prefijo + k);
+        int sub_k = resto < SUBTABLA_BITS ? resto : SUBTABLA_BITS;
+        long sub = tabla_reservar(t, (size_t)1 << sub_k);
+        if (sub < 0) return -1;
+
+        EntradaDecodificacion *e = &t->entradas[base + i];   // realloc pudo moverla
+        e->valor = sub;
+        e->bits = sub_k;
+        e->bits1 = prefijo + k;
+        if (tabla_llenar(t, sub, prefijo + k, sub_k, (valor_prefijo << k) | i, codes) != 0) {
+            return -1;
+        }
     }
-    
-    // Reconstruir árbol
-    HuffmanNode *root = construir_arbol_huffman(frequencies);
-    if (!root) {
-        escribir_salida("Error al reconstruir arbol\n");
-        close(fd_in);
+    return 0;
+}
+
+/**
+ * tabla_construir - Tabla de decodificación a partir de los códigos
+ *
+ * Ningún código puede pasar de MAX_LONGITUD_TABLA bits.
+ * Retorna: 0 si se construyó, -1 si no hubo memoria
+ */
+static int tabla_construir(TablaDecodificacion *t, const HuffmanCode *codes) {
+    memset(t, 0, sizeof(*t));
+    if (tabla_reservar(t, (size_t)1 << TABLA_BITS) != 0 ||
+        tabla_llenar(t, 0, 0, TABLA_BITS, 0, codes) != 0) {
+        free(t->entradas);
+        t->entradas = NULL;
         return -1;
     }
-    
-    // Descomprimir
-    int fd_out = open(salida, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-    if (fd_out == -1) {
-        escribir_salida("Error: No se pudo crear archivo de salida\n");
-        close(fd_in);
-        return -1;
+
+    // Segundo símbolo: si después del primero queda otro código entero dentro
+    // de los TABLA_BITS bits, la entrada de la tabla principal da los dos
+    const size_t n = (size_t)1 << TABLA_BITS;
+    EntradaDecodificacion simples[1 << TABLA_BITS];
+    memcpy(simples, t->entradas, sizeof(simples));
+    for (size_t i = 0; i < n; i++) {
+        EntradaDecodificacion *e = &t->entradas[i];
+        if (e->tipo != ENTRADA_SIMBOLO || e->bits >= TABLA_BITS) continue;
+
+        const EntradaDecodificacion *segunda = &simples[(i << e->bits) & (n - 1)];
+        if (segunda->tipo != ENTRADA_SIMBOLO || e->bits + segunda->bits > TABLA_BITS) continue;
+
+        e->tipo = ENTRADA_PAR;
+        e->bits1 = e->bits;
+        e->valor |= segunda->valor << 8;
+        e->bits += segunda->bits;
     }
-    
+    return 0;
+}
+
+// Leer bits de 64 en 64: el próximo bit es el más significativo del acumulador
+typedef struct {
+    unsigned long long acumulador;
+    int disponibles;
+    const unsigned char *datos;
+    size_t pos;
+    size_t len;
+    unsigned char buffer[4096];
+    Origen *origen;
+} LectorBits;
+
+static void lector_bits_init(LectorBits *lb, Origen *origen) {
+    memset(lb, 0, offsetof(LectorBits, buffer));
+    lb->origen = origen;
+}
+
+// Deja al menos MAX_LONGITUD_TABLA bits en el acumulador, salvo al final
+static void lector_bits_llenar(LectorBits *lb) {
+    while (lb->disponibles < MAX_LONGITUD_TABLA) {
+        if (lb->pos + 8 <= lb->len) {
+            // Carga 8 bytes de una vez; los bits que no entran se vuelven a
+            // cargar (iguales) en la próxima vuelta
+            const unsigned char *p = lb->datos + lb->pos;
+            unsigned long long v = ((unsigned long long)p[0] << 56) | ((unsigned long long)p[1] << 48) |
+                                   ((unsigned long long)p[2] << 40) | ((unsigned long long)p[3] << 32) |
+                                   ((unsigned long long)p[4] << 24) | ((unsigned long long)p[5] << 16) |
+                                   ((unsigned long long)p[6] << 8)  |  (unsigned long long)p[7];
+            int bytes = (63 - lb->disponibles) >> 3;
+            lb->acumulador |= v >> lb->disponibles;
+            lb->pos += bytes;
+            lb->disponibles += bytes * 8;
+            return;
+        }
+        if (lb->pos < lb->len) {
+            lb->acumulador |= (unsigned long long)lb->datos[lb->pos++] << (56 - lb->disponibles);
+            lb->disponibles += 8;
+            continue;
+        }
+
+        Origen *o = lb->origen;
+        if (o->mem) {
+            lb->datos = o->mem + o->pos;
+            lb->len = o->len - o->pos;
+            o->pos = o->len;
+        } else {
+            ssize_t leidos = origen_leer(o, lb->buffer, sizeof(lb->buffer));
+            lb->datos = lb->buffer;
+            lb->len = leidos > 0 ? leidos : 0;
+        }
+        lb->pos = 0;
+        if (lb->len == 0) return;
+    }
+}
+
+static void lector_bits_consumir(LectorBits *lb, int bits) {
+    lb->acumulador <<= bits;
+    lb->disponibles -= bits;
+}
+
+/**
+ * decodificar_segmento - Decodifica n símbolos de lb en salida
+ *
+ * Retorna: los símbolos decodificados (menos de n si la entrada se acaba), o
+ * -1 si aparece un código inválido
+ */
+static ssize_t decodificar_segmento(const TablaDecodificacion *t, LectorBits *lb,
+                                    unsigned char *salida, size_t n) {
+    size_t out_pos = 0;
+
+    while (out_pos < n) {
+        lector_bits_llenar(lb);
+        if (lb->disponibles == 0) break;
+
+        const EntradaDecodificacion *e = &t->entradas[lb->acumulador >> (64 - TABLA_BITS)];
+        while (e->tipo == ENTRADA_SUBTABLA) {
+            e = &t->entradas[e->valor + ((lb->acumulador << e->bits1) >> (64 - e->bits))];
+        }
+
+        if (e->tipo == ENTRADA_PAR && e->bits <= lb->disponibles && out_pos + 2 <= n) {
+            salida[out_pos++] = e->valor & 0xFF;
+            salida[out_pos++] = e->valor >> 8;
+            lector_bits_consumir(lb, e->bits);
+        } else {
+            if (e->tipo == ENTRADA_INVALIDA) {
+                escribir_salida("Error: codigo Huffman invalido\n");
+                return -1;
+            }
+            int bits = e->tipo == ENTRADA_PAR ? e->bits1 : e->bits;
+            if (bits > lb->disponibles) break;  // entrada truncada
+            salida[out_pos++] = e->valor & 0xFF;
+            lector_bits_consumir(lb, bits);
+        }
+    }
+    return out_pos;
+}
+
+// Decodificar total_bytes símbolos con la tabla
+static int decodificar_tabla(const TablaDecodificacion *t, Origen *origen, Destino *destino,
+                             unsigned long total_bytes) {
+    LectorBits lb;
+    lector_bits_init(&lb, origen);
+
+    if (destino->mem) {
+        ssize_t n = decodificar_segmento(t, &lb, destino->mem + destino->pos, total_bytes);
+        if (n < 0) return -1;
+        destino->pos += n;
+        return 0;
+    }
+
+    unsigned char out_buffer[16384];
+    for (unsigned long escritos = 0; escritos < total_bytes; ) {
+        size_t pedidos = total_bytes - escritos < sizeof(out_buffer) ? total_bytes - escritos : sizeof(out_buffer);
+        ssize_t n = decodificar_segmento(t, &lb, out_buffer, pedidos);
+        if (n < 0) return -1;
+        if (n > 0 && destino_escribir(destino, out_buffer, n) != 0) return -1;
+        if ((size_t)n < pedidos) break;
+        escritos += n;
+    }
+    return 0;
+}
+
+// Un paso de decodificar_flujos: uno o dos símbolos, sin revisar los límites
+static inline int paso_tabla(const TablaDecodificacion *t, LectorBits *lb, unsigned char **salida) {
+    const EntradaDecodificacion *e = &t->entradas[lb->acumulador >> (64 - TABLA_BITS)];
+    while (e->tipo == ENTRADA_SUBTABLA) {
+        e = &t->entradas[e->valor + ((lb->acumulador << e->bits1) >> (64 - e->bits))];
+    }
+    if (e->tipo == ENTRADA_INVALIDA) return -1;
+
+    (*salida)[0] = e->valor & 0xFF;
+    (*salida)[1] = e->valor >> 8;     // se pisa en el paso siguiente si era uno solo
+    *salida += e->tipo == ENTRADA_PAR ? 2 : 1;
+    lector_bits_consumir(lb, e->bits);
+    return 0;
+}
+
+/**
+ * decodificar_flujos - Decodifica un bloque partido en FLUJOS_BLOQUE flujos
+ *
+ * El flujo j tiene los símbolos del segmento j de la salida. Como las
+ * posiciones de bits de un flujo no dependen de las de los otros, el bucle
+ * principal avanza los cuatro lectores a la vez y el procesador puede
+ * solapar sus consultas a la tabla. Los códigos no pasan de
+ * HUFFMAN_MAX_LONGITUD bits. Retorna: 0, o -1 si los datos son inválidos
+ */
+static int decodificar_flujos(const TablaDecodificacion *t, const unsigned char **datos,
+                              const size_t *len, unsigned char *salida, size_t n) {
+    Origen origen[FLUJOS_BLOQUE];
+    LectorBits lb[FLUJOS_BLOQUE];
+    unsigned char *out[FLUJOS_BLOQUE];
+    unsigned char *fin[FLUJOS_BLOQUE];
+    size_t segmento = (n + FLUJOS_BLOQUE - 1) / FLUJOS_BLOQUE;
+    if ((FLUJOS_BLOQUE - 1) * segmento > n) return -1;     // bloque demasiado chico
+
+    for (int j = 0; j < FLUJOS_BLOQUE; j++) {
+        origen[j] = (Origen){ -1, datos[j], len[j], 0, NULL };
+        lector_bits_init(&lb[j], &origen[j]);
+        out[j] = salida + j * segmento;
+        fin[j] = j < FLUJOS_BLOQUE - 1 ? out[j] + segmento : salida + n;
+    }
+
+    // Tres pasos por vuelta: hasta 6 símbolos y 3 códigos de cada flujo
+    while (1) {
+        int seguir = 1;
+        for (int j = 0; j < FLUJOS_BLOQUE; j++) {
+            lector_bits_llenar(&lb[j]);
+            if (lb[j].disponibles < 3 * HUFFMAN_MAX_LONGITUD || fin[j] - out[j] < 7) seguir = 0;
+        }
+        if (!seguir) break;
+
+        int error = 0;
+        for (int paso = 0; paso < 3; paso++) {
+            error |= paso_tabla(t, &lb[0], &out[0]);
+            error |= paso_tabla(t, &lb[1], &out[1]);
+            error |= paso_tabla(t, &lb[2], &out[2]);
+            error |= paso_tabla(t, &lb[3], &out[3]);
+        }
+        if (error) {
+            escribir_salida("Error: codigo Huffman invalido\n");
+            return -1;
+        }
+    }
+
+    for (int j = 0; j < FLUJOS_BLOQUE; j++) {
+        size_t faltan = fin[j] - out[j];
+        if (decodificar_segmento(t, &lb[j], out[j], faltan) != (ssize_t)faltan) return -1;
+    }
+    return 0;
+}
+
+// Decodificar bajando por el árbol bit a bit (códigos de más de MAX_LONGITUD_TABLA bits)
+static int decodificar_arbol(HuffmanNode *root, Origen *origen, Destino *destino,
+                             unsigned long total_bytes) {
     BitReader br;
-    br_init(&br, fd_in);
+    br_init(&br, origen);
     
     unsigned char out_buffer[4096];
     int out_pos = 0;
@@ -388,28 +906,1489 @@ int descomprimir_archivo_huffman(const char *entrada, const char *salida) {
         current = (bit == 0) ? current->left : current->right;
         
         if (!current->left && !current->right) {
-            // Nodo hoja
-            out_buffer[out_pos++] = current->byte;
+            // Nodo hoja (en memoria se escribe directo en el destino)
+            if (destino->mem) {
+                destino->mem[destino->pos++] = current->byte;
+            } else {
+                out_buffer[out_pos++] = current->byte;
+            }
             bytes_escritos++;
             current = root;
             
             if (out_pos >= 4096) {
-                write(fd_out, out_buffer, out_pos);
+                if (destino_escribir(destino, out_buffer, out_pos) != 0) return -1;
                 out_pos = 0;
             }
         }
     }
     
     if (out_pos > 0) {
-        write(fd_out, out_buffer, out_pos);
+        if (destino_escribir(destino, out_buffer, out_pos) != 0) return -1;
     }
     
-    close(fd_in);
-    close(fd_out);
+    return 0;
+}
+
+// Decodificar total_bytes símbolos con una tabla armada a partir de los códigos
+static int decodificar_codigos(const HuffmanCode *codes, Origen *origen, Destino *destino,
+                               unsigned long total_bytes) {
+    TablaDecodificacion tabla;
+    if (tabla_construir(&tabla, codes) != 0) {
+        escribir_salida("Error: memoria insuficiente\n");
+        return -1;
+    }
+    int resultado = decodificar_tabla(&tabla, origen, destino, total_bytes);
+    free(tabla.entradas);
+    return resultado;
+}
+
+// Escribir total_bytes copias de un byte (bloques con un solo símbolo)
+static int rellenar_destino(Destino *destino, unsigned char byte, unsigned long total_bytes) {
+    unsigned char relleno[4096];
+    memset(relleno, byte, sizeof(relleno));
+    for (unsigned long escritos = 0; escritos < total_bytes; ) {
+        size_t n = total_bytes - escritos < sizeof(relleno) ? total_bytes - escritos : sizeof(relleno);
+        if (destino_escribir(destino, relleno, n) != 0) return -1;
+        escritos += n;
+    }
+    return 0;
+}
+
+/**
+ * Descomprimir desde un origen hacia un destino. El encabezado ya fue leído:
+ * total_bytes y frequencies vienen de él.
+ */
+int decodificar_huffman(HuffmanContexto *ctx, Origen *origen, Destino *destino,
+                        unsigned long total_bytes, unsigned long *frequencies) {
+    // Reconstruir árbol
+    HuffmanNode *root = construir_arbol_huffman(ctx, frequencies);
+    if (!root) {
+        escribir_salida("Error al reconstruir arbol\n");
+        return -1;
+    }
+    
+    // Un solo símbolo: el árbol es una hoja y no hay bits que leer
+    if (!root->left && !root->right) {
+        return rellenar_destino(destino, root->byte, total_bytes);
+    }
     
+    // Códigos del árbol (los de más de 64 bits quedan truncados, pero esos
+    // nunca llegan a la tabla)
+    HuffmanCode codes[256];
+    memset(codes, 0, sizeof(codes));
+    generar_codigos(root, 0, 0, codes);
+
+    for (int s = 0; s < 256; s++) {
+        if (codes[s].length > MAX_LONGITUD_TABLA) {
+            return decodificar_arbol(root, origen, destino, total_bytes);
+        }
+    }
+    return decodificar_codigos(codes, origen, destino, total_bytes);
+}
+
+/**
+ * Formato por bloques:
+ *   [magia: 8 bytes][uint32 tamaño de bloque]
+ *   por bloque: [uint32 longitud][uint32 n][longitudes de los códigos][bits]
+ *   [uint32 0] al final
+ *
+ * Cada bloque tiene su propia tabla y se codifica de forma independiente, así
+ * que varios hilos pueden comprimirlo o descomprimirlo a la vez. longitud
+ * cuenta los bytes del bloque después de ese campo, para ubicar los bloques
+ * sin decodificarlos. El último byte de la magia es 0xFF: leído como el
+ * total_bytes del formato anterior (un solo flujo) sería un tamaño absurdo,
+ * así que los archivos viejos se siguen reconociendo y leyendo.
+ *
+ * Los códigos son canónicos y de hasta HUFFMAN_MAX_LONGITUD bits, así que el
+ * bloque solo guarda sus longitudes: un byte con la longitud máxima y después
+ * 4 bits por símbolo, donde un 0 seguido de k marca k + 1 símbolos ausentes.
+ * Longitud máxima 0 es un bloque de un solo símbolo: ese byte va a
+ * continuación y no hay bits. La versión 2 guardaba en su lugar las 256
+ * frecuencias (1 KB por bloque) y se sigue leyendo.
+ *
+ * Un bloque de entrada puede ir en varios registros (cada uno con su n y su
+ * tabla) si su distribución de bytes cambia por el camino: ver
+ * dividir_bloque. El decodificador solo necesita que ninguno supere el
+ * tamaño de bloque.
+ *
+ * Con una tabla preentrenada (--table) la magia es la de la versión 4, al
+ * tamaño de bloque le sigue el uint32 id de la tabla y los registros no
+ * llevan longitudes: [uint32 longitud][uint32 n][saltos si hay flujos][bits].
+ *
+ * Con --comp-alg ans la magia es la de la versión 5 y cada registro es
+ * [uint32 longitud][uint32 n][bloque rANS] (formato en ans.h): mismo
+ * contenedor, mismos hilos y misma división en tramos que Huffman.
+ *
+ * En bloques de MIN_BLOQUE_FLUJOS bytes o más, el bit 0x80 del byte de
+ * longitud máxima indica que los bits van en FLUJOS_BLOQUE flujos, uno por
+ * cuarto del bloque, precedidos por los tamaños en bytes de los tres
+ * primeros (uint32 cada uno): así se decodifican los cuatro a la vez.
+ */
+static const unsigned char MAGIA_BLOQUES[8] = { 'H', 'U', 'F', 'B', 'L', 'K', 0x03, 0xFF };
+static const unsigned char MAGIA_BLOQUES_V2[8] = { 'H', 'U', 'F', 'B', 'L', 'K', 0x02, 0xFF };
+static const unsigned char MAGIA_BLOQUES_TABLA[8] = { 'H', 'U', 'F', 'B', 'L', 'K', 0x04, 0xFF };
+static const unsigned char MAGIA_BLOQUES_ANS[8] = { 'H', 'U', 'F', 'B', 'L', 'K', 0x05, 0xFF };
+static const unsigned char MAGIA_TABLA[8] = { 'H', 'U', 'F', 'T', 'A', 'B', 'L', 0x01 };
+
+#define TAM_ENCABEZADO_BLOQUES  12
+#define TAM_ENCABEZADO_TABLA    (TAM_ENCABEZADO_BLOQUES + 4)
+#define TAM_TABLA_V2            (256 * 4)
+#define MAX_TAM_LONGITUDES      (1 + 192)   // peor caso: 128 longitudes y 128 huecos sueltos
+#define MARCA_FLUJOS            0x80
+#define MIN_BLOQUE_FLUJOS       (16 * 1024)
+
+// --sample: el histograma de un bloque grande se estima con un trozo de
+// MUESTRA_TAM bytes de cada MUESTRA_PASO
+#define MUESTRA_TAM             4096
+#define MUESTRA_PASO            8
+#define MIN_BLOQUE_MUESTREO     (256 * 1024)
+#define TAM_SALTOS              (4 * (FLUJOS_BLOQUE - 1))
+#define MAX_TAM_BLOQUE          (64L * 1024 * 1024)
+
+// División adaptativa: se compara una muestra de MUESTRA_DIVISION bytes al
+// comienzo de cada ventana con el histograma del tramo en curso
+#define VENTANA_DIVISION        (32 * 1024)
+#define MUESTRA_DIVISION        4096
+#define MAX_TRAMOS              ((HUFFMAN_TAM_BLOQUE + VENTANA_DIVISION - 1) / VENTANA_DIVISION)
+#define GANANCIA_DIVISION       1024    // bytes por ventana que tiene que ahorrar un corte
+
+typedef enum {
+    FASE_MEDIR,         // histograma, códigos y tamaño del bloque codificado
+    FASE_CODIFICAR,     // medir y escribir el bloque en salida
+    FASE_DECODIFICAR    // datos es el bloque codificado (sin el campo longitud)
+} FaseBloque;
+
+typedef struct {
+    FaseBloque fase;
+    const unsigned char *datos;
+    size_t n;
+    unsigned char *salida;      // NULL: se reserva con malloc
+    size_t n_salida;
+    unsigned char *propio;      // memoria de datos a liberar, si la hay
+    int version;                // versión del formato al decodificar
+    unsigned long frequencies[256];
+    unsigned char longitudes[MAX_TAM_LONGITUDES];
+    size_t n_longitudes;
+    int flujos;                 // 1 o FLUJOS_BLOQUE
+    size_t tam_flujo[FLUJOS_BLOQUE];
+    int muestreo;               // estimar el histograma (--sample)
+    const TablaHuffman *tabla;  // tabla preentrenada (versión 4), NULL: una por registro
+    int ans;                    // registros rANS (versión 5)
+    int cota;                   // n_salida es una cota: el tamaño real sale al codificar
+    int resultado;
+} BloqueHuffman;
+
+// Versión del formato por bloques según la magia (0: formato anterior)
+static int version_bloques(const unsigned char *magia) {
+    if (memcmp(magia, MAGIA_BLOQUES, 8) == 0) return 3;
+    if (memcmp(magia, MAGIA_BLOQUES_V2, 8) == 0) return 2;
+    if (memcmp(magia, MAGIA_BLOQUES_TABLA, 8) == 0) return 4;
+    if (memcmp(magia, MAGIA_BLOQUES_ANS, 8) == 0) return 5;
     return 0;
 }
 
+// Versión que escribe la compresión con este contexto
+static int version_compresion(const HuffmanContexto *ctx) {
+    if (ctx->ans) return 5;
+    return ctx->tabla ? 4 : 3;
+}
+
+static size_t tam_encabezado(int version) {
+    return version == 4 ? TAM_ENCABEZADO_TABLA : TAM_ENCABEZADO_BLOQUES;
+}
+
+// Bytes mínimos de un bloque después del campo longitud
+static size_t minimo_registro(int version) {
+    if (version >= 4) return 4;
+    return version == 2 ? 4 + TAM_TABLA_V2 : 4 + 2;
+}
+
+static void poner_nibble(unsigned char *p, size_t i, int v) {
+    if (i % 2 == 0) p[i / 2] = v << 4;
+    else p[i / 2] |= v;
+}
+
+static int tomar_nibble(const unsigned char *p, size_t i) {
+    return i % 2 == 0 ? p[i / 2] >> 4 : p[i / 2] & 0x0F;
+}
+
+// Longitudes de los códigos de un bloque en p. Retorna: bytes escritos
+static size_t escribir_longitudes(const HuffmanCode *codes, const unsigned long *frequencies,
+                                  int flujos, unsigned char *p) {
+    int max = 0;
+    for (int s = 0; s < 256; s++) {
+        if (codes[s].length > max) max = codes[s].length;
+    }
+    p[0] = max;
+    if (flujos > 1) p[0] |= MARCA_FLUJOS;
+    if (max == 0) {
+        int s = 0;
+        while (s < 255 && frequencies[s] == 0) s++;
+        p[1] = s;
+        return 2;
+    }
+
+    size_t nibbles = 0;
+    for (int s = 0; s < 256; ) {
+        if (codes[s].length > 0) {
+            poner_nibble(p + 1, nibbles++, codes[s].length);
+            s++;
+            continue;
+        }
+        int ausentes = 1;
+        while (s + ausentes < 256 && ausentes < 16 && codes[s + ausentes].length == 0) ausentes++;
+        poner_nibble(p + 1, nibbles++, 0);
+        poner_nibble(p + 1, nibbles++, ausentes - 1);
+        s += ausentes;
+    }
+    return 1 + (nibbles + 1) / 2;
+}
+
+/**
+ * leer_longitudes - Lee las longitudes de un bloque y arma sus códigos
+ *
+ * simbolo queda en el byte de un bloque de un solo símbolo, o en -1.
+ * Retorna: bytes leídos, o -1 si las longitudes son inválidas
+ */
+static ssize_t leer_longitudes(const unsigned char *p, size_t n, HuffmanCode *codes, int *simbolo,
+                               int *flujos) {
+    memset(codes, 0, 256 * sizeof(HuffmanCode));
+    *simbolo = -1;
+    if (n < 2) return -1;
+
+    *flujos = p[0] & MARCA_FLUJOS ? FLUJOS_BLOQUE : 1;
+    int max = p[0] & ~MARCA_FLUJOS;
+    if (max == 0) {
+        *simbolo = p[1];
+        return *flujos == 1 ? 2 : -1;
+    }
+    if (max > HUFFMAN_MAX_LONGITUD) return -1;
+
+    size_t disponibles = (n - 1) * 2;
+    size_t i = 0;
+    for (int s = 0; s < 256; ) {
+        if (i >= disponibles) return -1;
+        int v = tomar_nibble(p + 1, i++);
+        if (v > 0) {
+            if (v > max) return -1;
+            codes[s++].length = v;
+            continue;
+        }
+        if (i >= disponibles) return -1;
+        int ausentes = tomar_nibble(p + 1, i++) + 1;
+        if (s + ausentes > 256) return -1;
+        s += ausentes;
+    }
+
+    // Con más códigos de los que caben los canónicos se pisarían
+    unsigned long long kraft = 0;
+    for (int s = 0; s < 256; s++) {
+        if (codes[s].length > 0) kraft += 1ULL << (HUFFMAN_MAX_LONGITUD - codes[s].length);
+    }
+    if (kraft > 1ULL << HUFFMAN_MAX_LONGITUD) return -1;
+
+    asignar_canonicos(codes);
+    return 1 + (i + 1) / 2;
+}
+
+/**
+ * Tablas preentrenadas (--train / --table). Archivo de tabla:
+ *   [magia: 8 bytes][uint32 id][longitudes de los códigos, como en un bloque]
+ *
+ * Todos los bytes tienen código, así que cualquier entrada se puede
+ * codificar. El id es un hash de las longitudes: los archivos comprimidos
+ * guardan solo el id y se descomprimen con la misma tabla.
+ */
+static unsigned int id_tabla(const HuffmanCode *codes) {
+    unsigned int h = 2166136261u;   // FNV-1a
+    for (int s = 0; s < 256; s++) {
+        h ^= (unsigned int)codes[s].length;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static TablaHuffman *tabla_crear(const HuffmanCode *codes) {
+    TablaHuffman *tabla = calloc(1, sizeof(TablaHuffman));
+    if (!tabla) return NULL;
+    memcpy(tabla->codes, codes, sizeof(tabla->codes));
+    tabla->id = id_tabla(codes);
+    if (tabla_construir(&tabla->decodificacion, codes) != 0) {
+        free(tabla);
+        return NULL;
+    }
+    return tabla;
+}
+
+// Tabla a partir del histograma de un corpus (los bytes que faltan cuentan 1)
+TablaHuffman *huffman_tabla_entrenar(const unsigned long *frequencies) {
+    unsigned long suavizadas[256];
+    for (int s = 0; s < 256; s++) suavizadas[s] = frequencies[s] + 1;
+
+    HuffmanContexto *ctx = malloc(sizeof(HuffmanContexto));
+    if (!ctx) return NULL;
+    huffman_contexto_init(ctx);
+
+    HuffmanCode codes[256];
+    memset(codes, 0, sizeof(codes));
+    int resultado = preparar_codigos(ctx, suavizadas, codes);
+    free(ctx);
+    if (resultado != 0) return NULL;
+
+    limitar_longitudes(codes, suavizadas, LONGITUD_LIMITE);
+    asignar_canonicos(codes);
+    return tabla_crear(codes);
+}
+
+int huffman_tabla_guardar(const TablaHuffman *tabla, int fd) {
+    unsigned char buf[12 + MAX_TAM_LONGITUDES];
+    memcpy(buf, MAGIA_TABLA, 8);
+    escribir_u32(buf + 8, tabla->id);
+    size_t n = 12 + escribir_longitudes(tabla->codes, NULL, 1, buf + 12);
+    return escribir_completo(fd, buf, n);
+}
+
+TablaHuffman *huffman_tabla_cargar(int fd) {
+    unsigned char buf[12 + MAX_TAM_LONGITUDES];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n < 12 || memcmp(buf, MAGIA_TABLA, 8) != 0) {
+        escribir_salida("Error: archivo de tabla invalido\n");
+        return NULL;
+    }
+
+    HuffmanCode codes[256];
+    int simbolo, flujos;
+    int completa = leer_longitudes(buf + 12, n - 12, codes, &simbolo, &flujos) >= 0 && simbolo < 0;
+    for (int s = 0; completa && s < 256; s++) {
+        if (codes[s].length == 0) completa = 0;
+    }
+    if (!completa || id_tabla(codes) != leer_u32(buf + 8)) {
+        escribir_salida("Error: archivo de tabla invalido\n");
+        return NULL;
+    }
+    return tabla_crear(codes);
+}
+
+void huffman_tabla_liberar(TablaHuffman *tabla) {
+    if (!tabla) return;
+    free(tabla->decodificacion.entradas);
+    free(tabla);
+}
+
+// Flujos en que se parte un bloque de n bytes, y el tamaño de cada segmento
+static int flujos_bloque(size_t n, size_t *segmento) {
+    int flujos = n >= MIN_BLOQUE_FLUJOS ? FLUJOS_BLOQUE : 1;
+    *segmento = (n + flujos - 1) / flujos;
+    return flujos;
+}
+
+// Histograma estimado: un trozo de cada MUESTRA_PASO
+static void estimar_frecuencias(const BloqueHuffman *b, unsigned long *frequencies) {
+    memset(frequencies, 0, 256 * sizeof(unsigned long));
+    for (size_t pos = 0; pos < b->n; pos += (size_t)MUESTRA_TAM * MUESTRA_PASO) {
+        size_t n = b->n - pos < MUESTRA_TAM ? b->n - pos : MUESTRA_TAM;
+        contar_frecuencias(b->datos + pos, n, frequencies);
+    }
+}
+
+// log2(x) en punto fijo con 8 bits de fracción (interpolación lineal, x > 0)
+unsigned int log2_fijo(unsigned long x) {
+    int e = 63 - __builtin_clzl(x);
+    unsigned long mantisa = e >= 8 ? x >> (e - 8) : x << (8 - e);
+    return ((unsigned int)e << 8) + (unsigned int)(mantisa - 256);
+}
+
+// Bits (en punto fijo) de codificar h con las probabilidades de ref (ref >= h)
+unsigned long long coste_histograma(const unsigned long *h, const unsigned long *ref,
+                                    unsigned long total_ref) {
+    unsigned int log_total = log2_fijo(total_ref);
+    unsigned long long bits = 0;
+    for (int i = 0; i < 256; i++) {
+        if (h[i]) bits += (unsigned long long)h[i] * (log_total - log2_fijo(ref[i]));
+    }
+    return bits;
+}
+
+/**
+ * dividir_bloque - Cortes del bloque donde conviene cambiar de tabla
+ *
+ * Recorre el bloque en ventanas de VENTANA_DIVISION bytes y cuenta solo una
+ * muestra de cada una. Si codificar la muestra con la tabla del tramo en
+ * curso (incluida la muestra) cuesta, escalado a la ventana, más de
+ * GANANCIA_DIVISION bytes por encima de su propia entropía, la ventana
+ * empieza un tramo nuevo. Así una tabla extra solo aparece cuando se paga.
+ * Retorna: la cantidad de tramos; fin[i] es donde termina el tramo i
+ */
+static int dividir_bloque(const BloqueHuffman *b, size_t *fin) {
+    unsigned long tramo[256], muestra[256], union_[256];
+    unsigned long total = 0;
+    int tramos = 0;
+
+    // Con una tabla preentrenada no hay tablas que cambiar
+    if (b->tabla) {
+        fin[0] = b->n;
+        return 1;
+    }
+
+    memset(tramo, 0, sizeof(tramo));
+    for (size_t pos = 0; pos < b->n; pos += VENTANA_DIVISION) {
+        size_t m = b->n - pos < MUESTRA_DIVISION ? b->n - pos : MUESTRA_DIVISION;
+        memset(muestra, 0, sizeof(muestra));
+        contar_frecuencias(b->datos + pos, m, muestra);
+
+        // Una cola corta no alcanza para decidir: queda en el tramo en curso
+        if (total > 0 && m == MUESTRA_DIVISION) {
+            for (int i = 0; i < 256; i++) union_[i] = tramo[i] + muestra[i];
+            unsigned long long juntos = coste_histograma(muestra, union_, total + m);
+            unsigned long long solos = coste_histograma(muestra, muestra, m);
+            unsigned long long ganancia = (juntos - solos) * (VENTANA_DIVISION / MUESTRA_DIVISION) / (8 * 256);
+            if (juntos > solos && ganancia > GANANCIA_DIVISION) {
+                fin[tramos++] = pos;
+                memset(tramo, 0, sizeof(tramo));
+                total = 0;
+            }
+        }
+        for (int i = 0; i < 256; i++) tramo[i] += muestra[i];
+        total += m;
+    }
+    fin[tramos++] = b->n;
+    return tramos;
+}
+
+// Lo más que puede ocupar el registro de un tramo de n bytes
+static size_t cota_tramo(size_t n) {
+    return 8 + MAX_TAM_LONGITUDES + TAM_SALTOS + FLUJOS_BLOQUE + (n * LONGITUD_LIMITE + 7) / 8;
+}
+
+// Con la tabla preentrenada no hay histograma: solo se suman las longitudes
+static int medir_con_tabla(BloqueHuffman *b, int exacto) {
+    size_t segmento;
+    b->flujos = flujos_bloque(b->n, &segmento);
+    b->n_longitudes = 0;
+    b->n_salida = 8 + (b->flujos > 1 ? TAM_SALTOS : 0);
+    b->cota = !exacto;
+    if (b->cota) {
+        b->n_salida += FLUJOS_BLOQUE + (b->n * HUFFMAN_MAX_LONGITUD + 7) / 8;
+        return 0;
+    }
+
+    for (int j = 0; j < b->flujos; j++) {
+        size_t inicio = j * segmento;
+        size_t n = b->n - inicio < segmento ? b->n - inicio : segmento;
+        b->tam_flujo[j] = (contar_bits(b->tabla->codes, b->datos + inicio, n) + 7) / 8;
+        b->n_salida += b->tam_flujo[j];
+    }
+    return 0;
+}
+
+/**
+ * medir_bloque - Histograma, códigos y tamaño del bloque codificado
+ *
+ * Con el histograma completo el tamaño de cada flujo sale de los histogramas
+ * de sus segmentos. Con uno estimado hay que sumar las longitudes de todo el
+ * bloque; si exacto es 0 se evita esa pasada y n_salida queda en una cota.
+ * Un histograma estimado no da código a los bytes que no salieron en la
+ * muestra: si aparece uno se vuelve a medir con el histograma completo.
+ */
+static int medir_bloque(HuffmanContexto *ctx, BloqueHuffman *b, HuffmanCode *codes, int exacto) {
+    if (b->tabla) return medir_con_tabla(b, exacto);
+
+    size_t segmento;
+    int flujos;
+    int estimado = b->muestreo && b->n >= MIN_BLOQUE_MUESTREO;
+    unsigned long parcial[FLUJOS_BLOQUE][256];
+
+medir:
+    flujos = flujos_bloque(b->n, &segmento);
+    ctx->node_pool_index = 0;
+    if (estimado) {
+        estimar_frecuencias(b, b->frequencies);
+    } else {
+        // Un histograma por segmento, para saber cuánto ocupa cada flujo
+        memset(parcial, 0, flujos * sizeof(parcial[0]));
+        for (int j = 0; j < flujos; j++) {
+            size_t inicio = j * segmento;
+            size_t n = b->n - inicio < segmento ? b->n - inicio : segmento;
+            contar_frecuencias(b->datos + inicio, n, parcial[j]);
+        }
+        for (int i = 0; i < 256; i++) {
+            b->frequencies[i] = 0;
+            for (int j = 0; j < flujos; j++) b->frequencies[i] += parcial[j][i];
+        }
+    }
+
+    memset(codes, 0, 256 * sizeof(HuffmanCode));
+    if (preparar_codigos(ctx, b->frequencies, codes) != 0) return -1;
+    limitar_longitudes(codes, b->frequencies, LONGITUD_LIMITE);
+    asignar_canonicos(codes);
+
+    // Un solo símbolo: los códigos miden 0 bits y no hay flujos
+    int un_simbolo = 1;
+    for (int i = 0; i < 256; i++) {
+        if (codes[i].length > 0) un_simbolo = 0;
+    }
+    if (un_simbolo && estimado) {
+        // Sin bits no hay cómo verificar que no aparezca otro byte fuera de la muestra
+        estimado = 0;
+        goto medir;
+    }
+    b->flujos = un_simbolo ? 1 : flujos;
+    if (b->flujos == 1) segmento = b->n;
+
+    b->n_longitudes = escribir_longitudes(codes, b->frequencies, b->flujos, b->longitudes);
+    b->n_salida = 8 + b->n_longitudes + (b->flujos > 1 ? TAM_SALTOS : 0);
+    b->cota = estimado && !exacto;
+    if (b->cota) {
+        // Alcanza también si al codificar hay que volver a medir
+        b->n_salida = cota_tramo(b->n);
+        return 0;
+    }
+
+    for (int j = 0; j < b->flujos; j++) {
+        unsigned long long bits = 0;
+        if (estimado) {
+            size_t inicio = j * segmento;
+            size_t n = b->n - inicio < segmento ? b->n - inicio : segmento;
+            long long medidos = contar_bits(codes, b->datos + inicio, n);
+            if (medidos < 0) {
+                estimado = 0;
+                goto medir;
+            }
+            bits = medidos;
+        } else {
+            for (int i = 0; i < 256; i++) {
+                bits += (unsigned long long)(b->flujos > 1 ? parcial[j][i] : b->frequencies[i]) * codes[i].length;
+            }
+        }
+        b->tam_flujo[j] = (bits + 7) / 8;
+        b->n_salida += b->tam_flujo[j];
+    }
+    return 0;
+}
+
+// Retorna: 0, -1 si hubo error, o 1 si el histograma estimado no alcanzó
+static int codificar_registro(BloqueHuffman *b, const HuffmanCode *codes) {
+    unsigned char *p = b->salida;
+    escribir_u32(p + 4, b->n);
+    memcpy(p + 8, b->longitudes, b->n_longitudes);
+
+    size_t saltos = 8 + b->n_longitudes;
+    size_t pos = saltos + (b->flujos > 1 ? TAM_SALTOS : 0);
+
+    size_t segmento;
+    flujos_bloque(b->n, &segmento);
+    if (b->flujos == 1) segmento = b->n;
+
+    // Con un solo símbolo los códigos miden 0 bits y no hay nada que escribir
+    int hay_bits = b->tabla || (b->longitudes[0] & ~MARCA_FLUJOS) != 0;
+
+    Destino destino = { -1, p, pos, NULL };
+    BitWriter bw;
+    bw.destino = &destino;
+    for (int j = 0; j < b->flujos; j++) {
+        size_t inicio = j * segmento;
+        size_t n = b->n - inicio < segmento ? b->n - inicio : segmento;
+        size_t antes = destino.pos;
+
+        bw_init(&bw);
+        if (hay_bits && b->cota) {
+            if (codificar_bloque_verificado(codes, b->datos + inicio, n, &bw) != 0) return 1;
+        } else if (hay_bits) {
+            codificar_bloque(codes, b->datos + inicio, n, &bw);
+        }
+        bw_flush(&bw);
+
+        if (b->cota) b->tam_flujo[j] = destino.pos - antes;
+        else if (destino.pos - antes != b->tam_flujo[j]) return -1;
+    }
+    if (b->flujos > 1) {
+        for (int j = 0; j < FLUJOS_BLOQUE - 1; j++) escribir_u32(p + saltos + 4 * j, b->tam_flujo[j]);
+    }
+
+    if (b->cota) b->n_salida = destino.pos;
+    else if (destino.pos != b->n_salida) return -1;
+    escribir_u32(p, b->n_salida - 4);
+    return 0;
+}
+
+// Ubica los flujos de un bloque con la tabla de saltos
+static int ubicar_flujos(const Origen *origen, const unsigned char **datos, size_t *len) {
+    size_t quedan = origen->len - origen->pos;
+    if (quedan < TAM_SALTOS) return -1;
+
+    const unsigned char *p = origen->mem + origen->pos + TAM_SALTOS;
+    quedan -= TAM_SALTOS;
+    for (int j = 0; j < FLUJOS_BLOQUE; j++) {
+        len[j] = j < FLUJOS_BLOQUE - 1 ? leer_u32(origen->mem + origen->pos + 4 * j) : quedan;
+        if (len[j] > quedan) return -1;
+        datos[j] = p;
+        p += len[j];
+        quedan -= len[j];
+    }
+    return 0;
+}
+
+// Decodifica juntos los flujos de un bloque
+static int decodificar_registro_flujos(const HuffmanCode *codes, Origen *origen, Destino *destino,
+                                       unsigned long total) {
+    const unsigned char *datos[FLUJOS_BLOQUE];
+    size_t len[FLUJOS_BLOQUE];
+    if (ubicar_flujos(origen, datos, len) != 0) return -1;
+
+    TablaDecodificacion tabla;
+    if (tabla_construir(&tabla, codes) != 0) {
+        escribir_salida("Error: memoria insuficiente\n");
+        return -1;
+    }
+    int resultado = decodificar_flujos(&tabla, datos, len, destino->mem + destino->pos, total);
+    free(tabla.entradas);
+    if (resultado == 0) destino->pos += total;
+    return resultado;
+}
+
+static int decodificar_registro(HuffmanContexto *ctx, BloqueHuffman *b) {
+    if (b->n < minimo_registro(b->version)) return -1;
+
+    unsigned long total = leer_u32(b->datos);
+    if (total > HUFFMAN_TAM_BLOQUE) return -1;
+    if (!b->salida) {
+        b->salida = malloc(total > 0 ? total : 1);
+        if (!b->salida) return -1;
+    }
+    b->n_salida = total;
+
+    Destino destino = { -1, b->salida, 0, NULL };
+    int resultado;
+    if (b->version == 2) {
+        unsigned long frequencies[256];
+        for (int i = 0; i < 256; i++) frequencies[i] = leer_u32(b->datos + 4 + 4 * i);
+
+        ctx->node_pool_index = 0;
+        size_t inicio = 4 + TAM_TABLA_V2;
+        Origen origen = { -1, b->datos + inicio, b->n - inicio, 0, NULL };
+        resultado = decodificar_huffman(ctx, &origen, &destino, total, frequencies);
+    } else if (b->version == 5) {
+        if (ans_decodificar(b->datos + 4, b->n - 4, b->salida, total) != 0) return -1;
+        destino.pos = total;
+        resultado = 0;
+    } else if (b->version == 4) {
+        // La tabla de decodificación ya está construida: ni longitudes ni árbol
+        const TablaDecodificacion *t = &b->tabla->decodificacion;
+        size_t segmento;
+        Origen origen = { -1, b->datos + 4, b->n - 4, 0, NULL };
+        if (flujos_bloque(total, &segmento) == 1) {
+            resultado = decodificar_tabla(t, &origen, &destino, total);
+        } else {
+            const unsigned char *datos[FLUJOS_BLOQUE];
+            size_t len[FLUJOS_BLOQUE];
+            resultado = ubicar_flujos(&origen, datos, len) != 0 ? -1 :
+                        decodificar_flujos(t, datos, len, destino.mem, total);
+            if (resultado == 0) destino.pos = total;
+        }
+    } else {
+        HuffmanCode codes[256];
+        int simbolo, flujos;
+        ssize_t leidos = leer_longitudes(b->datos + 4, b->n - 4, codes, &simbolo, &flujos);
+        if (leidos < 0) {
+            escribir_salida("Error: longitudes de codigos invalidas\n");
+            return -1;
+        }
+
+        size_t inicio = 4 + leidos;
+        Origen origen = { -1, b->datos + inicio, b->n - inicio, 0, NULL };
+        if (simbolo >= 0) resultado = rellenar_destino(&destino, simbolo, total);
+        else if (flujos == 1) resultado = decodificar_codigos(codes, &origen, &destino, total);
+        else resultado = decodificar_registro_flujos(codes, &origen, &destino, total);
+    }
+    if (resultado != 0) return -1;
+    return destino.pos == total ? 0 : -1;
+}
+
+// Tramo [inicio, fin) de b como un registro propio
+static void preparar_tramo(const BloqueHuffman *b, BloqueHuffman *t, size_t inicio, size_t fin) {
+    t->datos = b->datos + inicio;
+    t->n = fin - inicio;
+    t->muestreo = b->muestreo;
+    t->tabla = b->tabla;
+}
+
+// Mide y escribe un tramo en t->salida (exacto: el tamaño no puede ser una cota)
+static int codificar_tramo(HuffmanContexto *ctx, BloqueHuffman *t, int exacto) {
+    HuffmanCode codes[256];
+    if (medir_bloque(ctx, t, codes, exacto) != 0) return -1;
+    int r = codificar_registro(t, t->tabla ? t->tabla->codes : codes);
+    if (r == 1) {
+        // Un byte quedó fuera de la muestra: medir con el histograma completo
+        t->muestreo = 0;
+        if (medir_bloque(ctx, t, codes, 1) != 0) return -1;
+        r = codificar_registro(t, codes);
+    }
+    return r;
+}
+
+/**
+ * procesar_bloque_ans - Medir o codificar un bloque con rANS
+ *
+ * El tamaño de un registro rANS solo se sabe al codificarlo: al medir (plan)
+ * el bloque ya se codifica en b->propio y al codificar solo se copia.
+ */
+static int procesar_bloque_ans(BloqueHuffman *b) {
+    if (b->fase == FASE_CODIFICAR && b->propio) {
+        memcpy(b->salida, b->propio, b->n_salida);
+        free(b->propio);
+        b->propio = NULL;
+        return 0;
+    }
+
+    size_t fin[MAX_TRAMOS];
+    int tramos = dividir_bloque(b, fin);
+    size_t cota = 0;
+    for (int i = 0; i < tramos; i++) cota += 8 + ans_cota(fin[i] - (i > 0 ? fin[i - 1] : 0));
+    unsigned char *p = malloc(cota);
+    if (!p) return -1;
+
+    size_t pos = 0;
+    for (int i = 0; i < tramos; i++) {
+        size_t inicio = i > 0 ? fin[i - 1] : 0;
+        size_t n = fin[i] - inicio;
+        unsigned long frequencies[256] = {0};
+        contar_frecuencias(b->datos + inicio, n, frequencies);
+
+        size_t bytes = ans_codificar(b->datos + inicio, n, frequencies, p + pos + 8);
+        escribir_u32(p + pos, bytes + 4);
+        escribir_u32(p + pos + 4, n);
+        pos += 8 + bytes;
+    }
+    b->n_salida = pos;
+
+    if (b->fase == FASE_MEDIR) {
+        b->propio = p;
+    } else if (b->salida) {
+        memcpy(b->salida, p, pos);
+        free(p);
+    } else {
+        b->salida = p;
+    }
+    return 0;
+}
+
+static int procesar_bloque(HuffmanContexto *ctx, BloqueHuffman *b) {
+    HuffmanCode codes[256];
+    if (b->ans && b->fase != FASE_DECODIFICAR) return procesar_bloque_ans(b);
+
+    BloqueHuffman tramo;
+    size_t fin[MAX_TRAMOS];
+    int tramos;
+
+    switch (b->fase) {
+        case FASE_MEDIR:
+            tramos = dividir_bloque(b, fin);
+            b->n_salida = 0;
+            for (int i = 0; i < tramos; i++) {
+                preparar_tramo(b, &tramo, i > 0 ? fin[i - 1] : 0, fin[i]);
+                if (medir_bloque(ctx, &tramo, codes, 1) != 0) return -1;
+                b->n_salida += tramo.n_salida;
+            }
+            return 0;
+
+        case FASE_CODIFICAR: {
+            // Si la salida ya está ubicada (plan) el tamaño tiene que ser exacto
+            int exacto = b->salida != NULL;
+            tramos = dividir_bloque(b, fin);
+            if (!b->salida) {
+                size_t cota = 0;
+                for (int i = 0; i < tramos; i++) cota += cota_tramo(fin[i] - (i > 0 ? fin[i - 1] : 0));
+                b->salida = malloc(cota);
+                if (!b->salida) return -1;
+            }
+
+            size_t pos = 0;
+            for (int i = 0; i < tramos; i++) {
+                preparar_tramo(b, &tramo, i > 0 ? fin[i - 1] : 0, fin[i]);
+                tramo.salida = b->salida + pos;
+                if (codificar_tramo(ctx, &tramo, exacto) != 0) return -1;
+                pos += tramo.n_salida;
+            }
+            b->n_salida = pos;
+            return 0;
+        }
+
+        case FASE_DECODIFICAR:
+            return decodificar_registro(ctx, b);
+    }
+    return -1;
+}
+
+static void trabajo_bloque(void *arg, void *contexto) {
+    BloqueHuffman *b = arg;
+    b->resultado = procesar_bloque(contexto, b);
+}
+
+static void *crear_contexto_bloques(void) {
+    HuffmanContexto *ctx = malloc(sizeof(HuffmanContexto));
+    if (ctx) huffman_contexto_init(ctx);
+    return ctx;
+}
+
+// Procesa k bloques: en el pool si hay uno, si no en el hilo actual
+static int ejecutar_bloques(HuffmanContexto *ctx, Pool *pool, BloqueHuffman *bloques, size_t k) {
+    if (!pool || k == 1) {
+        for (size_t i = 0; i < k; i++) bloques[i].resultado = procesar_bloque(ctx, &bloques[i]);
+    } else {
+        for (size_t i = 0; i < k; i++) {
+            if (pool_enviar(pool, trabajo_bloque, &bloques[i]) != 0) {
+                bloques[i].resultado = procesar_bloque(ctx, &bloques[i]);
+            }
+        }
+        pool_esperar(pool);
+    }
+
+    for (size_t i = 0; i < k; i++) {
+        if (bloques[i].resultado != 0) return -1;
+    }
+    return 0;
+}
+
+// Pool para los bloques de un archivo (NULL si basta con el hilo actual)
+static Pool *crear_pool_bloques(HuffmanContexto *ctx, size_t num_bloques) {
+    if (ctx->hilos <= 1 || num_bloques <= 1) return NULL;
+    int hilos = (size_t)ctx->hilos < num_bloques ? ctx->hilos : (int)num_bloques;
+    return pool_crear(hilos, crear_contexto_bloques, free);
+}
+
+// Retorna: el tamaño del encabezado
+static size_t escribir_encabezado_bloques(unsigned char *p, const HuffmanContexto *ctx) {
+    int version = version_compresion(ctx);
+    if (version == 5) memcpy(p, MAGIA_BLOQUES_ANS, 8);
+    else memcpy(p, version == 4 ? MAGIA_BLOQUES_TABLA : MAGIA_BLOQUES, 8);
+    escribir_u32(p + 8, HUFFMAN_TAM_BLOQUE);
+    if (version != 4) return TAM_ENCABEZADO_BLOQUES;
+    escribir_u32(p + TAM_ENCABEZADO_BLOQUES, ctx->tabla->id);
+    return TAM_ENCABEZADO_TABLA;
+}
+
+// Un archivo de la versión 4 solo se lee con la misma tabla (id en p)
+static int comprobar_tabla(const HuffmanContexto *ctx, const unsigned char *p) {
+    if (!ctx->tabla) {
+        escribir_salida("Error: el archivo se comprimio con una tabla preentrenada (--table)\n");
+        return -1;
+    }
+    if (leer_u32(p) != ctx->tabla->id) {
+        escribir_salida("Error: la tabla preentrenada no es la del archivo\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Siguiente bloque de hasta n bytes: en memoria sin copiar, si no leído en buf
+static ssize_t origen_bloque(Origen *o, unsigned char *buf, size_t n, const unsigned char **datos) {
+    if (o->mem) {
+        size_t quedan = o->len - o->pos;
+        if (n > quedan) n = quedan;
+        *datos = o->mem + o->pos;
+        o->pos += n;
+        return n;
+    }
+    *datos = buf;
+    return origen_leer_todo(o, buf, n);
+}
+
+/**
+ * Compresión en una sola pasada: se leen hasta 2 bloques por hilo, se
+ * codifican en paralelo y se escriben en orden. El resultado no depende de la
+ * cantidad de hilos.
+ */
+static int comprimir_flujo(HuffmanContexto *ctx, Origen *origen, Destino *destino) {
+    unsigned char encabezado[TAM_ENCABEZADO_TABLA];
+    size_t tam = escribir_encabezado_bloques(encabezado, ctx);
+    if (destino_escribir(destino, encabezado, tam) != 0) return -1;
+
+    size_t ventana = ctx->hilos > 1 ? 2 * (size_t)ctx->hilos : 1;
+    BloqueHuffman *bloques = calloc(ventana, sizeof(BloqueHuffman));
+    unsigned char *entrada = origen->mem ? NULL : malloc(ventana * HUFFMAN_TAM_BLOQUE);
+    if (!bloques || (!origen->mem && !entrada)) {
+        free(bloques);
+        free(entrada);
+        return -1;
+    }
+
+    Pool *pool = NULL;
+    int resultado = 0;
+    int fin = 0;
+    while (resultado == 0 && !fin) {
+        size_t k = 0;
+        while (k < ventana) {
+            BloqueHuffman *b = &bloques[k];
+            ssize_t n = origen_bloque(origen, entrada + k * HUFFMAN_TAM_BLOQUE, HUFFMAN_TAM_BLOQUE, &b->datos);
+            if (n < 0) {
+                resultado = -1;
+                break;
+            }
+            if (n == 0) {
+                fin = 1;
+                break;
+            }
+            b->fase = FASE_CODIFICAR;
+            b->n = n;
+            b->salida = NULL;
+            b->muestreo = ctx->muestreo;
+            b->tabla = ctx->ans ? NULL : ctx->tabla;
+            b->ans = ctx->ans;
+            k++;
+            if ((size_t)n < HUFFMAN_TAM_BLOQUE) {
+                fin = 1;
+                break;
+            }
+        }
+
+        if (!pool && k > 1) pool = crear_pool_bloques(ctx, ventana);
+        if (resultado == 0 && k > 0) resultado = ejecutar_bloques(ctx, pool, bloques, k);
+
+        for (size_t i = 0; i < k; i++) {
+            if (resultado == 0) resultado = destino_escribir(destino, bloques[i].salida, bloques[i].n_salida);
+            free(bloques[i].salida);
+            bloques[i].salida = NULL;
+        }
+    }
+
+    unsigned char final[4] = {0};
+    if (resultado == 0) resultado = destino_escribir(destino, final, sizeof(final));
+
+    if (pool) pool_destruir(pool);
+    free(entrada);
+    free(bloques);
+    return resultado;
+}
+
+// Bloques de un archivo completo en memoria, con su tamaño total de salida
+typedef struct {
+    BloqueHuffman *bloques;
+    size_t num;
+    size_t total;
+    int legado;                 // formato anterior: un solo flujo
+    unsigned long frequencies[256];
+    const unsigned char *bits;  // flujo del formato anterior
+    size_t n_bits;
+} PlanBloques;
+
+static void liberar_plan(PlanBloques *plan) {
+    // Registros rANS ya codificados al medir (si quedó alguno sin copiar)
+    for (size_t i = 0; plan->bloques && i < plan->num; i++) free(plan->bloques[i].propio);
+    free(plan->bloques);
+    plan->bloques = NULL;
+}
+
+// Mide todos los bloques de la entrada en paralelo
+static int planificar_compresion(HuffmanContexto *ctx, Pool *pool, const unsigned char *entrada,
+                                 size_t n, PlanBloques *plan) {
+    memset(plan, 0, sizeof(*plan));
+    plan->num = (n + HUFFMAN_TAM_BLOQUE - 1) / HUFFMAN_TAM_BLOQUE;
+    plan->bloques = calloc(plan->num > 0 ? plan->num : 1, sizeof(BloqueHuffman));
+    if (!plan->bloques) return -1;
+
+    for (size_t i = 0; i < plan->num; i++) {
+        BloqueHuffman *b = &plan->bloques[i];
+        b->fase = FASE_MEDIR;
+        b->muestreo = ctx->muestreo;
+        b->tabla = ctx->ans ? NULL : ctx->tabla;
+        b->ans = ctx->ans;
+        b->datos = entrada + i * HUFFMAN_TAM_BLOQUE;
+        b->n = n - i * HUFFMAN_TAM_BLOQUE < HUFFMAN_TAM_BLOQUE ? n - i * HUFFMAN_TAM_BLOQUE : HUFFMAN_TAM_BLOQUE;
+    }
+    if (ejecutar_bloques(ctx, pool, plan->bloques, plan->num) != 0) {
+        liberar_plan(plan);
+        return -1;
+    }
+
+    plan->total = tam_encabezado(version_compresion(ctx)) + 4;
+    for (size_t i = 0; i < plan->num; i++) plan->total += plan->bloques[i].n_salida;
+    return 0;
+}
+
+// Codifica cada bloque directamente en su posición de salida (plan->total bytes)
+static int codificar_plan(HuffmanContexto *ctx, Pool *pool, PlanBloques *plan, unsigned char *salida) {
+    size_t pos = escribir_encabezado_bloques(salida, ctx);
+    for (size_t i = 0; i < plan->num; i++) {
+        plan->bloques[i].fase = FASE_CODIFICAR;
+        plan->bloques[i].salida = salida + pos;
+        pos += plan->bloques[i].n_salida;
+    }
+    escribir_u32(salida + pos, 0);
+
+    return ejecutar_bloques(ctx, pool, plan->bloques, plan->num);
+}
+
+/**
+ * En el formato anterior total_bytes es la suma de las frecuencias, y con más
+ * de un símbolo cada byte ocupa al menos un bit: un total que no cumple eso
+ * está corrupto y no se usa para reservar la salida.
+ */
+static int total_legado_valido(unsigned long total, const unsigned long *frequencies, size_t n_bits) {
+    unsigned long suma = 0;
+    int simbolos = 0;
+    for (int i = 0; i < 256; i++) {
+        if (frequencies[i] > total - suma) return 0;
+        suma += frequencies[i];
+        simbolos += frequencies[i] != 0;
+    }
+    return suma == total && (simbolos <= 1 || total / 8 <= n_bits);
+}
+
+/**
+ * Ubica los bloques de un archivo comprimido completo en memoria y calcula
+ * el tamaño descomprimido. También acepta el formato anterior.
+ */
+static int planificar_descompresion(const HuffmanContexto *ctx, const unsigned char *entrada, size_t n,
+                                    PlanBloques *plan) {
+    memset(plan, 0, sizeof(*plan));
+
+    int version = n >= 8 ? version_bloques(entrada) : 0;
+    if (version == 0) {
+        size_t encabezado = sizeof(unsigned long) + 256 * sizeof(unsigned long);
+        if (n < encabezado) {
+            escribir_salida("Error al leer encabezado\n");
+            return -1;
+        }
+        plan->legado = 1;
+        memcpy(&plan->total, entrada, sizeof(unsigned long));
+        memcpy(plan->frequencies, entrada + sizeof(unsigned long), sizeof(plan->frequencies));
+        plan->bits = entrada + encabezado;
+        plan->n_bits = n - encabezado;
+        if (!total_legado_valido(plan->total, plan->frequencies, plan->n_bits)) {
+            escribir_salida("Error: encabezado inválido\n");
+            return -1;
+        }
+        return 0;
+    }
+
+    size_t pos = tam_encabezado(version);
+    if (n < pos) {
+        escribir_salida("Error al leer encabezado\n");
+        return -1;
+    }
+    if (version == 4 && comprobar_tabla(ctx, entrada + TAM_ENCABEZADO_BLOQUES) != 0) return -1;
+
+    size_t capacidad = 16;
+    plan->bloques = malloc(capacidad * sizeof(BloqueHuffman));
+    if (!plan->bloques) return -1;
+
+    while (1) {
+        if (pos + 4 > n) {
+            escribir_salida("Error: archivo comprimido truncado\n");
+            liberar_plan(plan);
+            return -1;
+        }
+        size_t longitud = leer_u32(entrada + pos);
+        pos += 4;
+        if (longitud == 0) break;
+
+        if (longitud < minimo_registro(version) || longitud > n - pos) {
+            escribir_salida("Error: bloque comprimido inválido\n");
+            liberar_plan(plan);
+            return -1;
+        }
+
+        if (plan->num == capacidad) {
+            capacidad *= 2;
+            BloqueHuffman *nuevos = realloc(plan->bloques, capacidad * sizeof(BloqueHuffman));
+            if (!nuevos) {
+                liberar_plan(plan);
+                return -1;
+            }
+            plan->bloques = nuevos;
+        }
+
+        BloqueHuffman *b = &plan->bloques[plan->num++];
+        memset(b, 0, sizeof(*b));
+        b->fase = FASE_DECODIFICAR;
+        b->version = version;
+        b->tabla = ctx->tabla;
+        b->datos = entrada + pos;
+        b->n = longitud;
+        b->n_salida = leer_u32(entrada + pos);
+        // Ningún registro descomprime más que un bloque de entrada
+        if (b->n_salida > HUFFMAN_TAM_BLOQUE) {
+            escribir_salida("Error: bloque comprimido inválido\n");
+            liberar_plan(plan);
+            return -1;
+        }
+        plan->total += b->n_salida;
+        pos += longitud;
+    }
+    return 0;
+}
+
+// Decodifica cada bloque directamente en su posición de salida (plan->total bytes)
+static int decodificar_plan(HuffmanContexto *ctx, Pool *pool, PlanBloques *plan, unsigned char *salida,
+                            size_t *n_salida) {
+    if (plan->legado) {
+        ctx->node_pool_index = 0;
+        Origen origen = { -1, plan->bits, plan->n_bits, 0, NULL };
+        Destino destino = { -1, salida, 0, NULL };
+        int resultado = decodificar_huffman(ctx, &origen, &destino, plan->total, plan->frequencies);
+        *n_salida = destino.pos;
+        return resultado;
+    }
+
+    size_t pos = 0;
+    for (size_t i = 0; i < plan->num; i++) {
+        plan->bloques[i].salida = salida + pos;
+        pos += plan->bloques[i].n_salida;
+    }
+    *n_salida = pos;
+    return ejecutar_bloques(ctx, pool, plan->bloques, plan->num);
+}
+
+/**
+ * Descompresión en una sola pasada: se leen hasta 2 bloques por hilo, se
+ * decodifican en paralelo y se escriben en orden.
+ */
+static int descomprimir_bloques_flujo(HuffmanContexto *ctx, Origen *origen, Destino *destino,
+                                      int version) {
+    unsigned char tam[4];
+    if (origen_leer_todo(origen, tam, 4) != 4) {
+        escribir_salida("Error al leer encabezado\n");
+        return -1;
+    }
+    size_t tam_bloque = leer_u32(tam);
+    if (tam_bloque == 0 || tam_bloque > MAX_TAM_BLOQUE) {
+        escribir_salida("Error: tamaño de bloque inválido\n");
+        return -1;
+    }
+    if (version == 4) {
+        unsigned char id[4];
+        if (origen_leer_todo(origen, id, 4) != 4) {
+            escribir_salida("Error al leer encabezado\n");
+            return -1;
+        }
+        if (comprobar_tabla(ctx, id) != 0) return -1;
+    }
+    size_t max_longitud = minimo_registro(2) + tam_bloque * (MAX_CODE_LENGTH / 8);
+
+    size_t ventana = ctx->hilos > 1 ? 2 * (size_t)ctx->hilos : 1;
+    BloqueHuffman *bloques = calloc(ventana, sizeof(BloqueHuffman));
+    if (!bloques) return -1;
+
+    Pool *pool = NULL;
+    int resultado = 0;
+    int fin = 0;
+    while (resultado == 0 && !fin) {
+        size_t k = 0;
+        while (k < ventana) {
+            unsigned char campo[4];
+            if (origen_leer_todo(origen, campo, 4) != 4) {
+                escribir_salida("Error: archivo comprimido truncado\n");
+                resultado = -1;
+                break;
+            }
+            size_t longitud = leer_u32(campo);
+            if (longitud == 0) {
+                fin = 1;
+                break;
+            }
+            if (longitud < minimo_registro(version) || longitud > max_longitud) {
+                escribir_salida("Error: bloque comprimido inválido\n");
+                resultado = -1;
+                break;
+            }
+
+            BloqueHuffman *b = &bloques[k];
+            b->propio = malloc(longitud);
+            if (!b->propio) {
+                resultado = -1;
+                break;
+            }
+            k++;
+            if (origen_leer_todo(origen, b->propio, longitud) != (ssize_t)longitud) {
+                escribir_salida("Error: archivo comprimido truncado\n");
+                resultado = -1;
+                break;
+            }
+            b->fase = FASE_DECODIFICAR;
+            b->version = version;
+            b->tabla = ctx->tabla;
+            b->datos = b->propio;
+            b->n = longitud;
+            b->salida = NULL;
+        }
+
+        if (!pool && k > 1) pool = crear_pool_bloques(ctx, ventana);
+        if (resultado == 0 && k > 0) resultado = ejecutar_bloques(ctx, pool, bloques, k);
+
+        for (size_t i = 0; i < k; i++) {
+            if (resultado == 0) resultado = destino_escribir(destino, bloques[i].salida, bloques[i].n_salida);
+            free(bloques[i].salida);
+            free(bloques[i].propio);
+            bloques[i].salida = NULL;
+            bloques[i].propio = NULL;
+        }
+    }
+
+    if (pool) pool_destruir(pool);
+    free(bloques);
+    return resultado;
+}
+
+// Descomprimir un origen en cualquiera de los dos formatos
+static int descomprimir_flujo(HuffmanContexto *ctx, Origen *origen, Destino *destino) {
+    ctx->node_pool_index = 0;
+
+    // Leer encabezado: la magia del formato por bloques o total_bytes
+    unsigned char magia[8];
+    if (origen_leer_todo(origen, magia, 8) != 8) {
+        escribir_salida("Error al leer encabezado\n");
+        return -1;
+    }
+    int version = version_bloques(magia);
+    if (version != 0) {
+        return descomprimir_bloques_flujo(ctx, origen, destino, version);
+    }
+
+    unsigned long total_bytes;
+    memcpy(&total_bytes, magia, sizeof(unsigned long));
+
+    // Leer frecuencias
+    unsigned long frequencies[256];
+    if (origen_leer_todo(origen, frequencies, sizeof(frequencies)) != sizeof(frequencies)) {
+        escribir_salida("Error al leer frecuencias\n");
+        return -1;
+    }
+    // En flujo no se sabe cuántos bits quedan: solo se comprueba la suma
+    if (!total_legado_valido(total_bytes, frequencies, (size_t)-1)) {
+        escribir_salida("Error: encabezado inválido\n");
+        return -1;
+    }
+
+    return decodificar_huffman(ctx, origen, destino, total_bytes, frequencies);
+}
+
+// Compresión por descriptores (en tubería si config != NULL)
+static int comprimir_huffman_flujo(HuffmanContexto *ctx, int fd_in, int fd_out,
+                                   const ConfigTuberia *config) {
+    Origen origen;
+    if (origen_abrir(&origen, fd_in, config) != 0) return -1;
+    Destino destino;
+    if (destino_abrir(&destino, fd_out, config) != 0) {
+        origen_cerrar(&origen);
+        return -1;
+    }
+
+    int resultado = comprimir_flujo(ctx, &origen, &destino);
+
+    origen_cerrar(&origen);
+    if (destino_cerrar(&destino) != 0) resultado = -1;
+    return resultado;
+}
+
+static int descomprimir_huffman_flujo(HuffmanContexto *ctx, int fd_in, int fd_out,
+                                      const ConfigTuberia *config) {
+    Origen origen;
+    if (origen_abrir(&origen, fd_in, config) != 0) return -1;
+    Destino destino;
+    if (destino_abrir(&destino, fd_out, config) != 0) {
+        origen_cerrar(&origen);
+        return -1;
+    }
+
+    int resultado = descomprimir_flujo(ctx, &origen, &destino);
+
+    origen_cerrar(&origen);
+    if (destino_cerrar(&destino) != 0) resultado = -1;
+    return resultado;
+}
+
+int comprimir_huffman_fd(HuffmanContexto *ctx, int fd_in, int fd_out) {
+    return comprimir_huffman_flujo(ctx, fd_in, fd_out, NULL);
+}
+
+int descomprimir_huffman_fd(HuffmanContexto *ctx, int fd_in, int fd_out) {
+    return descomprimir_huffman_flujo(ctx, fd_in, fd_out, NULL);
+}
+
+int comprimir_huffman_tuberia(HuffmanContexto *ctx, int fd_in, int fd_out, const ConfigTuberia *config) {
+    return comprimir_huffman_flujo(ctx, fd_in, fd_out, config);
+}
+
+int descomprimir_huffman_tuberia(HuffmanContexto *ctx, int fd_in, int fd_out, const ConfigTuberia *config) {
+    return descomprimir_huffman_flujo(ctx, fd_in, fd_out, config);
+}
+
+/**
+ * Comprimir un buffer completo en memoria. Primero se miden todos los
+ * bloques, así *salida se reserva con malloc con el tamaño exacto.
+ */
+int comprimir_huffman_memoria(HuffmanContexto *ctx, const unsigned char *entrada, size_t n,
+                              unsigned char **salida, size_t *n_salida) {
+    Pool *pool = crear_pool_bloques(ctx, (n + HUFFMAN_TAM_BLOQUE - 1) / HUFFMAN_TAM_BLOQUE);
+
+    PlanBloques plan;
+    int resultado = planificar_compresion(ctx, pool, entrada, n, &plan);
+    if (resultado == 0) {
+        *salida = malloc(plan.total);
+        resultado = *salida ? codificar_plan(ctx, pool, &plan, *salida) : -1;
+        *n_salida = plan.total;
+        liberar_plan(&plan);
+    }
+
+    if (pool) pool_destruir(pool);
+    return resultado;
+}
+
+/**
+ * Comprimir con la entrada mapeada (una sola lectura para histograma y
+ * codificación) y la salida reservada con su tamaño exacto y mapeada: cada
+ * bloque se codifica directamente en su lugar. fd_out debe estar abierto con
+ * O_RDWR.
+ */
+int comprimir_huffman_mapeado(HuffmanContexto *ctx, int fd_in, int fd_out) {
+    const unsigned char *entrada;
+    size_t n;
+    if (mapear_entrada(fd_in, &entrada, &n) != 0) {
+        escribir_salida("Error: No se pudo mapear la entrada\n");
+        return -1;
+    }
+
+    Pool *pool = crear_pool_bloques(ctx, (n + HUFFMAN_TAM_BLOQUE - 1) / HUFFMAN_TAM_BLOQUE);
+
+    PlanBloques plan;
+    int resultado = planificar_compresion(ctx, pool, entrada, n, &plan);
+    if (resultado == 0) {
+        unsigned char *salida;
+        if (mapear_salida(fd_out, plan.total, &salida) != 0) {
+            escribir_salida("Error: No se pudo reservar la salida\n");
+            resultado = -1;
+        } else {
+            resultado = codificar_plan(ctx, pool, &plan, salida);
+            desmapear(salida, plan.total);
+        }
+        liberar_plan(&plan);
+    }
+
+    if (pool) pool_destruir(pool);
+    desmapear(entrada, n);
+    return resultado;
+}
+
+// Descomprimir un buffer completo en memoria (*salida se reserva con malloc)
+int descomprimir_huffman_memoria(HuffmanContexto *ctx, const unsigned char *entrada, size_t n, size_t maximo,
+                                 unsigned char **salida, size_t *n_salida) {
+    PlanBloques plan;
+    if (planificar_descompresion(ctx, entrada, n, &plan) != 0) return -1;
+    if (plan.total > maximo) {
+        liberar_plan(&plan);
+        return -1;
+    }
+
+    Pool *pool = crear_pool_bloques(ctx, plan.num);
+    *salida = malloc(plan.total > 0 ? plan.total : 1);
+    int resultado = *salida ? decodificar_plan(ctx, pool, &plan, *salida, n_salida) : -1;
+
+    if (pool) pool_destruir(pool);
+    liberar_plan(&plan);
+    return resultado;
+}
+
+/**
+ * Descomprimir con la entrada mapeada y la salida reservada con el tamaño
+ * total (suma de los bloques, o total_bytes en el formato anterior) y
+ * mapeada: cada bloque se decodifica directamente en su lugar.
+ * fd_out debe estar abierto con O_RDWR.
+ */
+int descomprimir_huffman_mapeado(HuffmanContexto *ctx, int fd_in, int fd_out) {
+    const unsigned char *entrada;
+    size_t n;
+    if (mapear_entrada(fd_in, &entrada, &n) != 0) {
+        escribir_salida("Error: No se pudo mapear la entrada\n");
+        return -1;
+    }
+
+    PlanBloques plan;
+    if (planificar_descompresion(ctx, entrada, n, &plan) != 0) {
+        desmapear(entrada, n);
+        return -1;
+    }
+
+    unsigned char *salida;
+    if (mapear_salida(fd_out, plan.total, &salida) != 0) {
+        escribir_salida("Error: No se pudo reservar la salida\n");
+        liberar_plan(&plan);
+        desmapear(entrada, n);
+        return -1;
+    }
+
+    Pool *pool = crear_pool_bloques(ctx, plan.num);
+    size_t escritos = 0;
+    int resultado = decodificar_plan(ctx, pool, &plan, salida, &escritos);
+    if (pool) pool_destruir(pool);
+
+    desmapear(salida, plan.total);
+    desmapear(entrada, n);
+
+    // Si el flujo terminó antes de tiempo, dejar solo lo decodificado
+    if (escritos < plan.total && ftruncate(fd_out, escritos) != 0) resultado = -1;
+    liberar_plan(&plan);
+    return resultado;
+}
+
+// Comprimir archivo
+int comprimir_archivo_huffman_ctx(HuffmanContexto *ctx, const char *entrada, const char *salida) {
+    int fd_in = open(entrada, O_RDONLY);
+    if (fd_in == -1) {
+        escribir_salida("Error: No se pudo abrir archivo de entrada\n");
+        return -1;
+    }
+    
+    int fd_out = open(salida, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_out == -1) {
+        escribir_salida("Error: No se pudo crear archivo de salida\n");
+        close(fd_in);
+        return -1;
+    }
+    
+    int resultado = comprimir_huffman_fd(ctx, fd_in, fd_out);
+    
+    close(fd_in);
+    close(fd_out);
+    
+    return resultado;
+}
+
+// Descomprimir archivo
+int descomprimir_archivo_huffman_ctx(HuffmanContexto *ctx, const char *entrada, const char *salida) {
+    int fd_in = open(entrada, O_RDONLY);
+    if (fd_in == -1) {
+        escribir_salida("Error: No se pudo abrir archivo de entrada\n");
+        return -1;
+    }
+    
+    int fd_out = open(salida, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_out == -1) {
+        escribir_salida("Error: No se pudo crear archivo de salida\n");
+        close(fd_in);
+        return -1;
+    }
+    
+    int resultado = descomprimir_huffman_fd(ctx, fd_in, fd_out);
+    
+    close(fd_in);
+    close(fd_out);
+    
+    return resultado;
+}
+
+// Versiones sin contexto: usan un contexto local en la pila
+int comprimir_archivo_huffman(const char *entrada, const char *salida) {
+    HuffmanContexto ctx;
+    huffman_contexto_init(&ctx);
+    return comprimir_archivo_huffman_ctx(&ctx, entrada, salida);
+}
+
+int descomprimir_archivo_huffman(const char *entrada, const char *salida) {
+    HuffmanContexto ctx;
+    huffman_contexto_init(&ctx);
+    return descomprimir_archivo_huffman_ctx(&ctx, entrada, salida);
+}
+
 void mostrar_ayuda() {
     escribir_salida("Uso: ./huffman [opciones]\n\n");
     escribir_salida("Opciones:\n");
@@ -1,11 +1,78 @@
 #ifndef HUFFMAN_H
 #define HUFFMAN_H
 
+#include <stddef.h>
+#include "tuberia.h"
+
+#define MAX_TREE_NODES 512
+
+// Los datos se comprimen en bloques independientes de este tamaño
+#define HUFFMAN_TAM_BLOQUE (1024 * 1024)
+
+// Estructura para nodo del árbol de Huffman
+typedef struct HuffmanNode {
+    unsigned char byte;
+    unsigned long frequency;
+    struct HuffmanNode *left;
+    struct HuffmanNode *right;
+} HuffmanNode;
+
+// Tabla de códigos preentrenada con un corpus (--train / --table)
+typedef struct TablaHuffman TablaHuffman;
+
+// Contexto reentrante: pool de nodos propio (uno por hilo trabajador)
+typedef struct {
+    HuffmanNode node_pool[MAX_TREE_NODES];
+    int node_pool_index;
+    int hilos;              // hilos para los bloques de un mismo archivo (1 por defecto)
+    int muestreo;           // estimar el histograma de los bloques grandes (--sample)
+    const TablaHuffman *tabla;  // comprimir sin histograma ni longitudes (--table)
+    int ans;                // comprimir con rANS en lugar de códigos Huffman (--comp-alg ans)
+} HuffmanContexto;
+
+void huffman_contexto_init(HuffmanContexto *ctx);
+
 // Funciones principales
 int comprimir_archivo_huffman(const char *entrada, const char *salida);
 int descomprimir_archivo_huffman(const char *entrada, const char *salida);
 void mostrar_ayuda(void);
 
+// Variantes reentrantes con contexto explícito
+int comprimir_archivo_huffman_ctx(HuffmanContexto *ctx, const char *entrada, const char *salida);
+int descomprimir_archivo_huffman_ctx(HuffmanContexto *ctx, const char *entrada, const char *salida);
+
+// Variantes sobre descriptores ya abiertos
+int comprimir_huffman_fd(HuffmanContexto *ctx, int fd_in, int fd_out);
+int descomprimir_huffman_fd(HuffmanContexto *ctx, int fd_in, int fd_out);
+
+// Igual que las anteriores pero leyendo y escribiendo en tubería (archivos grandes)
+int comprimir_huffman_tuberia(HuffmanContexto *ctx, int fd_in, int fd_out, const ConfigTuberia *config);
+int descomprimir_huffman_tuberia(HuffmanContexto *ctx, int fd_in, int fd_out, const ConfigTuberia *config);
+
+// Variantes con la entrada y la salida mapeadas en memoria (fd_out con O_RDWR)
+int comprimir_huffman_mapeado(HuffmanContexto *ctx, int fd_in, int fd_out);
+int descomprimir_huffman_mapeado(HuffmanContexto *ctx, int fd_in, int fd_out);
+
+// Variantes sobre buffers completos en memoria (*salida se reserva con malloc).
+// Al descomprimir, una entrada que declara más de maximo bytes se rechaza
+// sin reservar nada (SIZE_MAX: sin tope)
+int comprimir_huffman_memoria(HuffmanContexto *ctx, const unsigned char *entrada, size_t n,
+                              unsigned char **salida, size_t *n_salida);
+int descomprimir_huffman_memoria(HuffmanContexto *ctx, const unsigned char *entrada, size_t n, size_t maximo,
+                                 unsigned char **salida, size_t *n_salida);
+
+// Histogramas y su costo de orden 0 (también los usa el filtro delta)
+void contar_frecuencias(const unsigned char *buffer, size_t n, unsigned long *frequencies);
+unsigned int log2_fijo(unsigned long x);
+unsigned long long coste_histograma(const unsigned long *h, const unsigned long *ref,
+                                    unsigned long total_ref);
+
+// Tablas preentrenadas: histograma de un corpus, tabla y archivo de tabla
+TablaHuffman *huffman_tabla_entrenar(const unsigned long *frequencies);
+int huffman_tabla_guardar(const TablaHuffman *tabla, int fd);
+TablaHuffman *huffman_tabla_cargar(int fd);
+void huffman_tabla_liberar(TablaHuffman *tabla);
+
 // Funciones auxiliares de uso general
 void escribir_salida(const char *msg);
 int longitud_cadena(const char *str);
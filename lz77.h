@@ -0,0 +1,49 @@
+#ifndef LZ77_H
+#define LZ77_H
+
+#include <stddef.h>
+#include "huffman.h"
+
+/**
+ * Compresión LZ77 + Huffman (--comp-alg lz77), del estilo de DEFLATE.
+ *
+ * La entrada se procesa en trozos independientes de LZ77_TAM_TROZO bytes.
+ * En cada uno, un buscador con cadenas de hash encuentra repeticiones dentro
+ * de la ventana y el trozo se describe como secuencias de literales seguidos
+ * de una copia (longitud, distancia). Literales, longitudes y distancias van
+ * en flujos de bytes separados, y cada flujo se comprime con el formato por
+ * bloques de Huffman, así que cada uno tiene sus propias tablas.
+ *
+ * El nivel (1 a 9) cambia cuánto se busca: los bajos miran pocas posiciones
+ * de cada cadena y no hacen búsqueda perezosa; los altos recorren cadenas
+ * largas y prueban si empezar un byte después da una copia mejor.
+ */
+
+#define LZ77_NIVEL_MIN          1
+#define LZ77_NIVEL_MAX          9
+#define LZ77_NIVEL_DEFECTO      6
+#define LZ77_TAM_TROZO          (8 * 1024 * 1024)
+#define LZ77_VENTANA_MIN        (4 * 1024)
+#define LZ77_VENTANA_DEFECTO    (1024 * 1024)
+
+typedef struct {
+    int nivel;
+    size_t ventana;         // potencia de 2 entre LZ77_VENTANA_MIN y LZ77_TAM_TROZO
+} ConfigLZ77;
+
+// Variantes sobre descriptores (lectura y escritura secuenciales: sirven
+// también para tuberías)
+int comprimir_lz77_fd(HuffmanContexto *ctx, const ConfigLZ77 *config, int fd_in, int fd_out);
+int descomprimir_lz77_fd(HuffmanContexto *ctx, int fd_in, int fd_out);
+
+// Variantes sobre buffers completos en memoria (*salida se reserva con malloc)
+int comprimir_lz77_memoria(HuffmanContexto *ctx, const ConfigLZ77 *config, const unsigned char *entrada,
+                           size_t n, unsigned char **salida, size_t *n_salida);
+int descomprimir_lz77_memoria(HuffmanContexto *ctx, const unsigned char *entrada, size_t n,
+                              unsigned char **salida, size_t *n_salida);
+
+// Lo corre --selftest. Retorna: 0 si un flujo que declara más de lo que cabe
+// en su trozo se rechaza antes de reservarlo, -1 si no
+int lz77_verificar(void);
+
+#endif // LZ77_H
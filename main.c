@@ -1,407 +1,1087 @@
-#include <unistd.h>
-#include <fcntl.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <sys/wait.h>
-#include <stdio.h>
-#include <dirent.h>
-#include <string.h>
-#include <stdlib.h>
-#include "huffman.h"
-#include "aes.h"
-#include "rle.h"
-
-void print_error(const char *msg) {
-    write(2, msg, strlen(msg));
-}
-
-
-int esDirectorio(const char *path) {
-    struct stat s;
-
-    if (stat(path, &s) != 0) {  // 0 si es exitoso
-        perror("stat");
-        return -1; // error
-    }
-
-    if (S_ISDIR(s.st_mode)) {
-        return 1;  // es directorio
-    }
-
-    if (S_ISREG(s.st_mode)) {
-        return 0;  // es archivo regular
-    }
-
-    return -1; // otro tipo (enlace, socket, etc.)
-}
-
-
-
-char *procesarNombreSalida(char *inputFile, int actions[]){
-    char output[100] = {0};
-    char extension[100] = {0};
-    
-    for(int i = 0; inputFile[i] != '\0'; i++){
-        if(inputFile[i] != '.'){
-            output[i] = inputFile[i];
-        }
-        if(inputFile[i] == '.'){
-            int k = 0;
-            for(int j = i; inputFile[j] != '\0'; j++){
-                extension[k] = inputFile[j];
-                k++;
-            }
-            
-        }
-     
-    }
-    
-    if(actions[0]){ // Compresion
-        strcat(output,"Comprimido.dat");
-    }else if(actions[1]){// descompresion
-        strcat(output, "_Descomprimido");
-        strcat(output, ".desconocido");
-    }    else if(actions[2]) { // cifrar
-        strcat(output, "_Cifrado.enc");
-    } 
-    else if(actions[3]) { // descifrar
-        strcat(output, "_Descifrado.dec");
-    }
-    // completar con lo de encriptacion
-
-     // Reservar memoria dinámica para devolver el nombre
-    char *resultado = malloc(strlen(output) + 1);
-    if (!resultado) return NULL;
-
-    strcpy(resultado, output);
-    return resultado; 
-}
-
-/**
- * Funcion encargada de procesar la accion(encriptar, comprimir, etc) para directorios
- */
-int procesar_archivo(const char *input_file, const char *output_file, int actions[], const char *alg) {
-    unsigned char in_buf[4096];
-    unsigned char out_buf[8192];
-
-    if (alg == NULL) {
-        print_error("Error: No se especificó algoritmo\n");
-        return 1;
-    }
-
-    // **Huffman**
-    if (strcmp(alg, "Huffman") == 0) {
-        if (actions[0]) {
-            return comprimir_archivo_huffman(input_file, output_file);
-        } else if (actions[1]) {
-            return descomprimir_archivo_huffman(input_file, output_file);
-        }
-    }
-    // **RLE**
-    else if (strcmp(alg, "rle") == 0) {
-        int fd_in = open(input_file, O_RDONLY);
-        if (fd_in < 0) { perror("open input"); return 1; }
-        int fd_out = open(output_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-        if (fd_out < 0) { perror("open output"); close(fd_in); return 1; }
-
-        ssize_t bytes_read;
-        while ((bytes_read = read(fd_in, in_buf, sizeof(in_buf))) > 0) {
-            int result_size;
-            if (actions[0]) { // comprimir
-                result_size = comprimir_rle(in_buf, bytes_read, out_buf);
-            } else { // descomprimir
-                result_size = descomprimir_rle(in_buf, bytes_read, out_buf);
-            }
-            write(fd_out, out_buf, result_size);
-        }
-        close(fd_in);
-        close(fd_out);
-        return 0;
-    }
-    // **AES**
-    else if (strcmp(alg, "aes") == 0) {
-        unsigned char clave[16] = {0}; // aquí podrías usar una clave fija o pedirla
-        generar_clave_aes("clave123", clave);
-        if (actions[2]) return cifrar_archivo_aes(input_file, output_file, clave);
-        if (actions[3]) return descifrar_archivo_aes(input_file, output_file, clave);
-    }
-
-    print_error("Algoritmo no soportado\n");
-    return 1;
-}
-
-char *actualizarPath(const char *path,  char *outputFile){
-    int slash = -1;
-    char output[200] = {0};
-    int len = strlen(path);
-    // logica para tomar la posicion donde empieza el nombre del archivo en el path
-            for(int i = len-1; i >= 0; i--){
-                if(path[i] == '/'){
-                    slash = i; 
-                    break;
-                }
-                
-                }
-        
-
-    if(slash != -1){
-    strncpy(output, path, slash+1);  
-    strcat(output, outputFile);
-
-         // Reservar memoria dinámica para devolver el nombre
-    char *resultado = malloc(strlen(output) + 1);
-    if (!resultado) return NULL;
-
-    strcpy(resultado, output);
-    return resultado; 
-    
-    }else{
-        char *res = malloc(strlen(outputFile) + 1);
-        strcpy(res, outputFile);
-        return res;
-    } 
-}
-
-
-
-void procesar_directorio(const char *path, char *outputFile, int actions[], const char *alg) {
-    DIR *dir;
-    struct dirent *entry;
-    char pathIFile[500];
-
-    dir = opendir(path);
-    if (!dir) {
-        perror("opendir");
-        return;
-    }
-
-    char *pathDir = actualizarPath(path, outputFile);
-    if (!pathDir) {
-        closedir(dir);
-        return;
-    }
-
-    if (mkdir(pathDir, 0755) == -1) {
-        perror("mkdir");
-        closedir(dir);
-        free(pathDir);
-        return;
-    }
-    
-    printf("[PID %d] Procesando directorio: %s -> %s\n", getpid(), path, pathDir);
-    
-    // Array dinámico de PIDs
-    pid_t *pids = NULL;
-    int num_procesos = 0;
-    int capacity = 10;
-    
-    pids = malloc(capacity * sizeof(pid_t));
-    if (!pids) {
-        perror("malloc");
-        closedir(dir);
-        free(pathDir);
-        return;
-    }
-    
-    // Leer entradas
-    while ((entry = readdir(dir)) != NULL) {
-        // ignorar . y ..
-        if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
-            continue;
-
-        // Expandir array si es necesario
-        if (num_procesos >= capacity) {
-            capacity *= 2;
-            pid_t *new_pids = realloc(pids, capacity * sizeof(pid_t));
-            if (!new_pids) {
-                perror("realloc");
-                break;
-            }
-            pids = new_pids;
-        }
-
-        // reconstruir path input
-        snprintf(pathIFile, sizeof(pathIFile), "%s/%s", path, entry->d_name);
-
-        // generar nombre de salida
-        char *newName = procesarNombreSalida(entry->d_name, actions);
-        if (!newName) continue;
-
-        // generar path de salida
-        char fullOutputPath[500];
-        snprintf(fullOutputPath, sizeof(fullOutputPath), "%s/%s", pathDir, newName);
-
-        /**
-         * Bloque para crear procesos hijo con fork
-         */
-        pid_t pid = fork();
-        
-        if (pid < 0) {
-            // en caso de error al crear proceso
-            perror("fork");
-            free(newName);
-            continue;
-        }
-        else if (pid == 0) {
-            /**
-             * Codigo pa procesar hijos
-             */
-            closedir(dir);    // El hijo cierra el directorio y lista pids
-            free(pids);       
-            
-            printf("[HIJO PID %d] Procesando: %s\n", getpid(), pathIFile);
-            
-            // Procesar archivo o directorio
-            if (esDirectorio(pathIFile) == 1) {
-    procesar_directorio(pathIFile, fullOutputPath, actions, alg);
-            } else {
-                procesar_archivo(pathIFile, fullOutputPath, actions, alg);
-            }
-            
-            free(newName);
-            free(pathDir);
-            exit(0);  // el hijo termina aqui
-        }
-        else {
-            // 
-            pids[num_procesos++] = pid;
-            printf("[PADRE PID %d] Creó hijo PID %d para: %s\n", 
-                   getpid(), pid, pathIFile);
-        }
-        
-        free(newName);
-    }
-
-    closedir(dir);
-
-    // el padre debe esperar los procesos hijos
-    printf("[PADRE PID %d] Esperando a %d procesos hijos...\n", 
-           getpid(), num_procesos);
-    
-    for (int i = 0; i < num_procesos; i++) {
-        int status;
-        pid_t finished_pid = waitpid(pids[i], &status, 0);
-        
-        if (finished_pid > 0) {
-            if (WIFEXITED(status)) {
-                int exit_code = WEXITSTATUS(status);
-                if (exit_code == 0) {
-                    printf("[PADRE PID %d] ✓ Hijo PID %d terminó exitosamente\n", 
-                           getpid(), finished_pid);
-                } else {
-                    printf("[PADRE PID %d] ✗ Hijo PID %d terminó con error (código %d)\n", 
-                           getpid(), finished_pid, exit_code);
-                }
-            } else {
-                printf("[PADRE PID %d] ✗ Hijo PID %d terminó anormalmente\n", 
-                       getpid(), finished_pid);
-            }
-        } else {
-            perror("waitpid");
-        }
-    }
-    
-    printf("[PADRE PID %d] ✓ Todos los procesos completados para: %s\n", 
-           getpid(), path);
-
-    free(pids);
-    free(pathDir);
-}
-
-
-int procesarEntrada(const char *inputFile, char *outputFile, int actions[], const char *alg) {
-    if (esDirectorio(inputFile) == 1) {
-        procesar_directorio(inputFile, outputFile, actions, alg);
-        return 0;
-    } else if (esDirectorio(inputFile) == 0) {
-        return procesar_archivo(inputFile, outputFile, actions, alg);
-    } else {
-        print_error("Error: Ruta no válida\n");
-        return 1;
-    }
-}
-
-
-int str_cmp(const char *s1, const char *s2) {
-    int i = 0;
-    while (s1[i] != '\0' && s2[i] != '\0') {
-        if (s1[i] != s2[i]) return s1[i] - s2[i];
-        i++;
-    }
-    return s1[i] - s2[i];
-}
-
-
-
-
-
-int main(int argc, char *argv[]) {
-    int actions[4] = {0, 0, 0, 0}; // 0: comprimir, 1: descomprimir, 2: cifrar, 3: descifrar
-    int isEmpty = 1;
-
-    const char *input_file = NULL;
-    char *output_file = NULL;
-    const char *comp_alg = NULL;
-    const char *enc_alg = NULL;
-    const char *alg = NULL;
-
-    // Parsear argumentos
-   for (int i = 1; i < argc; i++) {
-    if (argv[i][0] == '-') {
-        if (argv[i][1] != '-') {
-            // opciones cortas
-            if (argv[i][1] == 'c') actions[0] = 1;
-            else if (argv[i][1] == 'd') actions[1] = 1;
-            else if (argv[i][1] == 'e') actions[2] = 1;
-            else if (argv[i][1] == 'u') actions[3] = 1;
-            else if (argv[i][1] == 'i' && i + 1 < argc) input_file = argv[++i];
-            else if (argv[i][1] == 'o' && i + 1 < argc) output_file = argv[++i];
-            else {
-                print_error("Opción desconocida\n");
-                return 1;
-            }
-        } else {
-            // opciones largas "--comp-alg" o "--enc-alg"
-            if (strcmp(argv[i], "--comp-alg") == 0 && i + 1 < argc) {
-                comp_alg = argv[++i];
-            } else if (strcmp(argv[i], "--enc-alg") == 0 && i + 1 < argc) {
-                enc_alg = argv[++i];
-            } else {
-                print_error("Opción desconocida\n");
-                return 1;
-            }
-        }
-    }
-}
-
-
-    if (comp_alg && enc_alg) {
-        print_error("Error: No puede usar dos algoritmos al mismo tiempo\n");
-        return 1;
-    }
-
-    // Determinar algoritmo a usar
-    if (actions[0] || actions[1]) alg = "Huffman"; // por defecto compresión
-    else if (actions[2] || actions[3]) alg = "aes"; // por defecto cifrado
-
-    if (comp_alg != NULL && (actions[0] || actions[1])) {
-        if (strcmp(comp_alg, "rle") == 0) alg = "rle";
-        else if (strcmp(comp_alg, "huffman") == 0) alg = "Huffman";
-    }
-
-    if (enc_alg != NULL && (actions[2] || actions[3])) {
-        if (strcmp(enc_alg, "aes") == 0) alg = "aes";
-    }
-
-    // Verificar que se haya especificado alguna acción
-    for (int i = 0; i < 4; i++)
-        if (actions[i]) { isEmpty = 0; break; }
-
-    if (isEmpty) {
-        print_error("Error: Debe especificar -c (comprimir), -d (descomprimir), -e (cifrar) o -u (descifrar)\n");
-        return 1;
-    }
-
-    // Llamada final
-    return procesarEntrada(input_file, output_file, actions, alg);
-}
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include "huffman.h"
+#include "aes.h"
+#include "es.h"
+#include "rle.h"
+#include "lz77.h"
+#include "filtro.h"
+#include "pool.h"
+#include "planificador.h"
+#include "recorrido.h"
+#include "uring.h"
+#include "tuberia.h"
+#include "mapeo.h"
+
+void print_error(const char *msg) {
+    write(2, msg, strlen(msg));
+}
+
+
+int esDirectorio(const char *path) {
+    struct stat s;
+
+    if (stat(path, &s) != 0) {  // 0 si es exitoso
+        perror("stat");
+        return -1; // error
+    }
+
+    if (S_ISDIR(s.st_mode)) {
+        return 1;  // es directorio
+    }
+
+    if (S_ISREG(s.st_mode)) {
+        return 0;  // es archivo regular
+    }
+
+    return -1; // otro tipo (enlace, socket, etc.)
+}
+
+
+
+/**
+ * Nombre de salida: la parte del nombre antes del primer '.' más el sufijo de
+ * la acción. Se arma en memoria dinámica, sin límite de longitud.
+ */
+char *procesarNombreSalida(const char *inputFile, int actions[]){
+    const char *sufijo = "";
+    
+    if(actions[0]){ // Compresion
+        sufijo = "Comprimido.dat";
+    }else if(actions[1]){// descompresion
+        sufijo = "_Descomprimido.desconocido";
+    }    else if(actions[2]) { // cifrar
+        sufijo = "_Cifrado.enc";
+    } 
+    else if(actions[3]) { // descifrar
+        sufijo = "_Descifrado.dec";
+    }
+
+    size_t base = strcspn(inputFile, ".");
+
+     // Reservar memoria dinámica para devolver el nombre
+    char *resultado = malloc(base + strlen(sufijo) + 1);
+    if (!resultado) return NULL;
+
+    memcpy(resultado, inputFile, base);
+    strcpy(resultado + base, sufijo);
+    return resultado; 
+}
+
+// Estado privado de cada hilo trabajador (buffers y contexto de Huffman)
+typedef struct {
+    HuffmanContexto huffman;
+    unsigned char in_buf[RLE_TAM_TROZO];
+    unsigned char out_buf[RLE_TAM_SALIDA];
+    AnilloES anillo;
+    int anillo_estado;      // 0: sin iniciar, 1: listo, -1: no disponible
+} ContextoCodec;
+
+// Histograma de Huffman estimado con muestras en bloques grandes (--sample)
+static int huffman_muestreo = 0;
+
+// Tabla preentrenada para comprimir y descomprimir sin histograma (--table)
+static TablaHuffman *huffman_tabla = NULL;
+
+// --comp-alg ans: el mismo contenedor por bloques, codificado con rANS
+static int huffman_ans = 0;
+
+// Nivel y ventana de --comp-alg lz77 (--level, --window)
+static ConfigLZ77 config_lz77 = { LZ77_NIVEL_DEFECTO, LZ77_VENTANA_DEFECTO };
+
+// Filtro delta antes del codec y después del decodificador (--filter)
+static ConfigFiltro config_filtro = { 0, FILTRO_PASO_AUTO };
+
+// --mode ctr: AES en modo contador en vez de ECB (al cifrar y al descifrar)
+static int aes_ctr = 0;
+
+void *crear_contexto_codec(void) {
+    ContextoCodec *ctx = malloc(sizeof(ContextoCodec));
+    if (ctx) {
+        huffman_contexto_init(&ctx->huffman);
+        ctx->huffman.muestreo = huffman_muestreo;
+        ctx->huffman.tabla = huffman_tabla;
+        ctx->huffman.ans = huffman_ans;
+        ctx->anillo.fd = -1;
+        ctx->anillo_estado = 0;
+    }
+    return ctx;
+}
+
+void destruir_contexto_codec(void *contexto) {
+    ContextoCodec *ctx = contexto;
+    if (ctx && ctx->anillo_estado == 1) anillo_cerrar(&ctx->anillo);
+    free(ctx);
+}
+
+// Configuración de la tubería lectura -> codec -> escritura (--buffer-size, --direct)
+static ConfigTuberia config_tuberia = { TUBERIA_BUFFER_DEFECTO, TUBERIA_NUM_BUFFERS, 0 };
+
+// Archivos regulares mapeados en memoria en vez de read/write (--io=mmap)
+static int io_mapeada = 0;
+
+// La salida se abre O_RDWR cuando hay que mapearla
+// Lectura también: para mapear la salida y para deshacer el filtro delta en el lugar
+static int flags_salida(void) {
+    return O_RDWR | O_CREAT | O_TRUNC;
+}
+
+static int es_regular(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+// Solo vale la pena para archivos regulares de varios buffers (y la tubería
+// escribe con pwrite: la salida también tiene que ser un archivo regular)
+static int usar_tuberia(int fd_in, int fd_out) {
+    struct stat st;
+    if (fstat(fd_in, &st) != 0 || !S_ISREG(st.st_mode) || !es_regular(fd_out)) return 0;
+    return st.st_size >= 2 * (off_t)config_tuberia.tam_buffer;
+}
+
+/**
+ * Un archivo en RLE: la salida (un descriptor, el escritor de la tubería o
+ * un buffer en memoria que crece) y el estado del codificador o del
+ * decodificador entre un trozo y el siguiente. Se comprime siempre al
+ * formato 2; al descomprimir el formato lo indica el comienzo del archivo.
+ */
+typedef struct {
+    int comprimir;
+    CodificadorRLE codificador;
+    DecodificadorRLE decodificador;
+    int fd;
+    EscritorTuberia *escritor;
+    unsigned char *buffer;
+    size_t usado, capacidad;
+} ArchivoRLE;
+
+static void archivo_rle_init(ArchivoRLE *a, int actions[], int fd, EscritorTuberia *escritor) {
+    memset(a, 0, sizeof(*a));
+    a->comprimir = actions[0];
+    a->fd = fd;
+    a->escritor = escritor;
+    rle_codificador_init(&a->codificador);
+    rle_decodificador_init(&a->decodificador);
+}
+
+static int rle_escribir(ArchivoRLE *a, const unsigned char *datos, size_t n) {
+    // Sin datos no hay nada que copiar, y a->buffer puede seguir en NULL
+    if (n == 0) return 0;
+    if (a->escritor) return escritor_tuberia_escribir(a->escritor, datos, n);
+    if (a->fd >= 0) return escribir_completo(a->fd, datos, n);
+
+    if (a->usado + n > a->capacidad) {
+        size_t capacidad = (a->usado + n) * 2;
+        unsigned char *nuevo = realloc(a->buffer, capacidad);
+        if (!nuevo) return -1;
+        a->buffer = nuevo;
+        a->capacidad = capacidad;
+    }
+    memcpy(a->buffer + a->usado, datos, n);
+    a->usado += n;
+    return 0;
+}
+
+// Procesa un trozo de a lo sumo RLE_TAM_TROZO bytes. Retorna: 0, o -1
+static int rle_trozo(ContextoCodec *ctx, ArchivoRLE *a, const unsigned char *in, size_t n) {
+    if (a->comprimir) return rle_escribir(a, ctx->out_buf, rle_codificar(&a->codificador, in, n, ctx->out_buf));
+
+    // Una corrida puede dar más que out_buf: se vacía hasta que no quede nada
+    size_t consumido, producido;
+    do {
+        if (rle_decodificar(&a->decodificador, in, n, &consumido, ctx->out_buf, RLE_TAM_SALIDA, &producido) != 0) {
+            print_error("Error: datos RLE inválidos\n");
+            return -1;
+        }
+        if (rle_escribir(a, ctx->out_buf, producido) != 0) return -1;
+        in += consumido;
+        n -= consumido;
+    } while (n > 0 || producido == RLE_TAM_SALIDA);
+    return 0;
+}
+
+// Cierra el archivo: la corrida pendiente, o comprobar que no falte nada
+static int rle_terminar(ContextoCodec *ctx, ArchivoRLE *a) {
+    if (a->comprimir) return rle_escribir(a, ctx->out_buf, rle_codificador_terminar(&a->codificador, ctx->out_buf));
+    if (!rle_decodificador_completo(&a->decodificador)) {
+        print_error("Error: archivo RLE truncado\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int escribir_archivo_rle(void *destino, const unsigned char *datos, size_t n) {
+    return rle_escribir(destino, datos, n);
+}
+
+/**
+ * Un archivo grande mapeado con varios hilos: al comprimir cada hilo toma un
+ * trozo y se escriben en orden; al descomprimir se mide cuánto produce cada
+ * tramo, se reserva la salida completa y los hilos la llenan en su lugar.
+ */
+static int procesar_rle_paralelo(ContextoCodec *ctx, const unsigned char *entrada, size_t n,
+                                 int fd_out, int actions[]) {
+    int hilos = ctx->huffman.hilos;
+    if (actions[0]) {
+        ArchivoRLE archivo;
+        archivo_rle_init(&archivo, actions, fd_out, NULL);
+        return comprimir_rle_paralelo(hilos, entrada, n, escribir_archivo_rle, &archivo) != 0;
+    }
+
+    PlanRLE plan;
+    if (rle_planificar(&plan, hilos, entrada, n) != 0) {
+        print_error("Error: datos RLE inválidos\n");
+        rle_liberar_plan(&plan);
+        return 1;
+    }
+    size_t total = plan.salida[plan.num];
+    unsigned char *salida;
+    int resultado = mapear_salida(fd_out, total, &salida);
+    if (resultado != 0) {
+        print_error("Error: No se pudo reservar la salida\n");
+    } else {
+        resultado = rle_descomprimir_plan(&plan, hilos, entrada, salida);
+        if (resultado != 0) print_error("Error: datos RLE inválidos\n");
+        desmapear(salida, total);
+    }
+    rle_liberar_plan(&plan);
+    return resultado != 0;
+}
+
+// RLE con la entrada mapeada: mismos trozos de RLE_TAM_TROZO, sin read()
+static int procesar_rle_mapeado(ContextoCodec *ctx, int fd_in, int fd_out, int actions[]) {
+    const unsigned char *entrada;
+    size_t n;
+    if (mapear_entrada(fd_in, &entrada, &n) != 0) return 1;
+    if (ctx->huffman.hilos > 1 && n > RLE_TAM_TROZO) {
+        int resultado = procesar_rle_paralelo(ctx, entrada, n, fd_out, actions);
+        desmapear(entrada, n);
+        return resultado;
+    }
+
+    ArchivoRLE archivo;
+    archivo_rle_init(&archivo, actions, fd_out, NULL);
+    int resultado = 0;
+    for (size_t pos = 0; pos < n && resultado == 0; pos += RLE_TAM_TROZO) {
+        size_t len = n - pos < RLE_TAM_TROZO ? n - pos : RLE_TAM_TROZO;
+        resultado = rle_trozo(ctx, &archivo, entrada + pos, len);
+    }
+    if (resultado == 0) resultado = rle_terminar(ctx, &archivo);
+
+    desmapear(entrada, n);
+    return resultado != 0;
+}
+
+// RLE en tubería: mismos trozos de RLE_TAM_TROZO que la lectura directa
+static int procesar_rle_tuberia(ContextoCodec *ctx, int fd_in, int fd_out, int actions[]) {
+    LectorTuberia *lector = lector_tuberia_crear(fd_in, &config_tuberia);
+    if (!lector) return 1;
+    EscritorTuberia *escritor = escritor_tuberia_crear(fd_out, &config_tuberia);
+    if (!escritor) {
+        lector_tuberia_destruir(lector);
+        return 1;
+    }
+
+    ArchivoRLE archivo;
+    archivo_rle_init(&archivo, actions, fd_out, escritor);
+    int resultado = 0;
+    ssize_t bytes_read;
+    while (resultado == 0 && (bytes_read = lector_tuberia_leer(lector, ctx->in_buf, RLE_TAM_TROZO)) > 0) {
+        resultado = rle_trozo(ctx, &archivo, ctx->in_buf, bytes_read);
+    }
+    if (bytes_read < 0) resultado = 1;
+    if (resultado == 0) resultado = rle_terminar(ctx, &archivo);
+
+    lector_tuberia_destruir(lector);
+    if (escritor_tuberia_cerrar(escritor) != 0) resultado = 1;
+    return resultado != 0;
+}
+
+/**
+ * Funcion encargada de procesar la accion(encriptar, comprimir, etc) sobre
+ * descriptores ya abiertos. Los archivos grandes van en tubería.
+ */
+static int procesar_codec(ContextoCodec *ctx, int fd_in, int fd_out, int actions[], const char *alg) {
+    unsigned char *in_buf = ctx->in_buf;
+
+    if (alg == NULL) {
+        print_error("Error: No se especificó algoritmo\n");
+        return 1;
+    }
+
+    int mapear = io_mapeada && es_regular(fd_in) && es_regular(fd_out);
+    const ConfigTuberia *tuberia = !mapear && usar_tuberia(fd_in, fd_out) ? &config_tuberia : NULL;
+    // Tuberías y terminales (-i -, -o -) no admiten pread/pwrite
+    int secuencial = !es_regular(fd_in) || !es_regular(fd_out);
+
+    // **Huffman**
+    if (strcmp(alg, "Huffman") == 0) {
+        if (actions[0]) {
+            if (mapear) return comprimir_huffman_mapeado(&ctx->huffman, fd_in, fd_out);
+            if (tuberia) return comprimir_huffman_tuberia(&ctx->huffman, fd_in, fd_out, tuberia);
+            return comprimir_huffman_fd(&ctx->huffman, fd_in, fd_out);
+        } else if (actions[1]) {
+            if (mapear) return descomprimir_huffman_mapeado(&ctx->huffman, fd_in, fd_out);
+            if (tuberia) return descomprimir_huffman_tuberia(&ctx->huffman, fd_in, fd_out, tuberia);
+            return descomprimir_huffman_fd(&ctx->huffman, fd_in, fd_out);
+        }
+    }
+    // **LZ77**: lectura y escritura secuenciales, por trozos
+    else if (strcmp(alg, "lz77") == 0) {
+        if (actions[0]) return comprimir_lz77_fd(&ctx->huffman, &config_lz77, fd_in, fd_out) != 0;
+        if (actions[1]) return descomprimir_lz77_fd(&ctx->huffman, fd_in, fd_out) != 0;
+    }
+    // **RLE**
+    else if (strcmp(alg, "rle") == 0) {
+        if (mapear) return procesar_rle_mapeado(ctx, fd_in, fd_out, actions);
+        if (tuberia) return procesar_rle_tuberia(ctx, fd_in, fd_out, actions);
+        ArchivoRLE archivo;
+        archivo_rle_init(&archivo, actions, fd_out, NULL);
+        ssize_t bytes_read;
+        while ((bytes_read = leer_completo(fd_in, in_buf, RLE_TAM_TROZO)) > 0) {
+            if (rle_trozo(ctx, &archivo, in_buf, bytes_read) != 0) return 1;
+        }
+        return bytes_read < 0 || rle_terminar(ctx, &archivo) != 0;
+    }
+    // **AES**
+    else if (strcmp(alg, "aes") == 0) {
+        unsigned char clave[16] = {0}; // aquí podrías usar una clave fija o pedirla
+        generar_clave_aes("clave123", clave);
+        if (aes_ctr) {
+            // Sin padding ni dependencias entre bloques: con un archivo regular
+            // los hilos se reparten segmentos con pread/pwrite
+            if (actions[2]) {
+                if (secuencial) return cifrar_aes_ctr_flujo(fd_in, fd_out, clave) != 0;
+                return cifrar_aes_ctr_fd(fd_in, fd_out, clave, ctx->huffman.hilos) != 0;
+            }
+            if (actions[3]) {
+                if (secuencial) return descifrar_aes_ctr_flujo(fd_in, fd_out, clave) != 0;
+                return descifrar_aes_ctr_fd(fd_in, fd_out, clave, ctx->huffman.hilos) != 0;
+            }
+        }
+        if (actions[2]) {
+            if (mapear) return cifrar_aes_mapeado(fd_in, fd_out, clave);
+            if (tuberia) return cifrar_aes_tuberia(fd_in, fd_out, clave, tuberia);
+            if (secuencial) return cifrar_aes_flujo(fd_in, fd_out, clave);
+            return cifrar_aes_fd(fd_in, fd_out, clave);
+        }
+        if (actions[3]) {
+            if (mapear) return descifrar_aes_mapeado(fd_in, fd_out, clave);
+            if (tuberia) return descifrar_aes_tuberia(fd_in, fd_out, clave, tuberia);
+            if (secuencial) return descifrar_aes_flujo(fd_in, fd_out, clave);
+            return descifrar_aes_fd(fd_in, fd_out, clave);
+        }
+    }
+
+    print_error("Algoritmo no soportado\n");
+    return 1;
+}
+
+static int admite_lectura(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    return flags >= 0 && (flags & O_ACCMODE) == O_RDWR;
+}
+
+/**
+ * Con --filter el codec lee la entrada ya filtrada (o escribe lo que hay que
+ * restaurar) por un pipe que atiende el hilo del filtro. Al descomprimir sin
+ * --filter el encabezado se detecta igual: en un archivo regular se deshace
+ * en el lugar después del codec (que sigue con mmap, tubería o hilos), y en
+ * una tubería el hilo deja pasar los datos que no lo tengan.
+ */
+int procesar_descriptores(ContextoCodec *ctx, int fd_in, int fd_out, int actions[], const char *alg) {
+    if (!config_filtro.activo && !actions[1]) return procesar_codec(ctx, fd_in, fd_out, actions, alg);
+    if (!config_filtro.activo && es_regular(fd_out) && admite_lectura(fd_out)) {
+        int resultado = procesar_codec(ctx, fd_in, fd_out, actions, alg);
+        if (resultado == 0 && filtro_restaurar_archivo(fd_out) < 0) resultado = 1;
+        return resultado;
+    }
+
+    HiloFiltro filtro;
+    int fd = actions[0] ? filtro_iniciar_entrada(&filtro, &config_filtro, fd_in)
+                        : filtro_iniciar_salida(&filtro, fd_out, !config_filtro.activo);
+    if (fd < 0) return 1;
+
+    int resultado = actions[0] ? procesar_codec(ctx, fd, fd_out, actions, alg)
+                               : procesar_codec(ctx, fd_in, fd, actions, alg);
+    if (filtro_terminar(&filtro, fd) != 0) resultado = 1;
+    return resultado;
+}
+
+/**
+ * Igual que procesar_codec pero con el archivo completo en memoria
+ * (lo usa el motor io_uring). *salida se reserva con malloc.
+ */
+static int procesar_memoria_codec(ContextoCodec *ctx, TrabajoArchivo *t, const unsigned char *entrada, size_t n,
+                                  unsigned char **salida, size_t *n_salida) {
+    int *actions = t->actions;
+
+    if (strcmp(t->alg, "Huffman") == 0) {
+        if (actions[0]) return comprimir_huffman_memoria(&ctx->huffman, entrada, n, salida, n_salida);
+        if (actions[1]) return descomprimir_huffman_memoria(&ctx->huffman, entrada, n, SIZE_MAX, salida, n_salida);
+    }
+    else if (strcmp(t->alg, "lz77") == 0) {
+        if (actions[0]) return comprimir_lz77_memoria(&ctx->huffman, &config_lz77, entrada, n, salida, n_salida);
+        if (actions[1]) return descomprimir_lz77_memoria(&ctx->huffman, entrada, n, salida, n_salida);
+    }
+    else if (strcmp(t->alg, "rle") == 0) {
+        // mismos trozos de RLE_TAM_TROZO que la versión por descriptores
+        ArchivoRLE archivo;
+        archivo_rle_init(&archivo, actions, -1, NULL);
+        int resultado = 0;
+        for (size_t pos = 0; pos < n && resultado == 0; pos += RLE_TAM_TROZO) {
+            size_t len = n - pos < RLE_TAM_TROZO ? n - pos : RLE_TAM_TROZO;
+            resultado = rle_trozo(ctx, &archivo, entrada + pos, len);
+        }
+        if (resultado == 0) resultado = rle_terminar(ctx, &archivo);
+        if (resultado == 0 && !archivo.buffer) archivo.buffer = malloc(1);   // salida vacía
+        if (resultado != 0 || !archivo.buffer) {
+            free(archivo.buffer);
+            return 1;
+        }
+        *salida = archivo.buffer;
+        *n_salida = archivo.usado;
+        return 0;
+    }
+    else if (strcmp(t->alg, "aes") == 0) {
+        unsigned char clave[16] = {0};
+        generar_clave_aes("clave123", clave);
+        if (aes_ctr && actions[2]) return cifrar_aes_ctr_memoria(entrada, n, salida, n_salida, clave);
+        if (aes_ctr && actions[3]) return descifrar_aes_ctr_memoria(entrada, n, salida, n_salida, clave);
+        if (actions[2]) return cifrar_aes_memoria(entrada, n, salida, n_salida, clave);
+        if (actions[3]) return descifrar_aes_memoria(entrada, n, salida, n_salida, clave);
+    }
+
+    print_error("Algoritmo no soportado\n");
+    return 1;
+}
+
+int procesar_memoria(void *contexto, TrabajoArchivo *t, const unsigned char *entrada, size_t n,
+                     unsigned char **salida, size_t *n_salida) {
+    ContextoCodec *ctx = contexto;
+    if (!config_filtro.activo && !t->actions[1]) return procesar_memoria_codec(ctx, t, entrada, n, salida, n_salida);
+
+    unsigned char *intermedio;
+    size_t n_intermedio;
+    int resultado;
+    if (!config_filtro.activo) {
+        // Descomprimir sin --filter: se deshace solo si trae el encabezado
+        resultado = procesar_memoria_codec(ctx, t, entrada, n, &intermedio, &n_intermedio);
+        if (resultado != 0) return resultado;
+        if (!filtro_tiene_encabezado(intermedio, n_intermedio)) {
+            *salida = intermedio;
+            *n_salida = n_intermedio;
+            return 0;
+        }
+        resultado = restaurar_memoria(intermedio, n_intermedio, salida, n_salida) != 0;
+    } else if (t->actions[0]) {
+        if (filtrar_memoria(&config_filtro, entrada, n, &intermedio, &n_intermedio) != 0) return 1;
+        resultado = procesar_memoria_codec(ctx, t, intermedio, n_intermedio, salida, n_salida);
+    } else {
+        resultado = procesar_memoria_codec(ctx, t, entrada, n, &intermedio, &n_intermedio);
+        if (resultado != 0) return resultado;
+        resultado = restaurar_memoria(intermedio, n_intermedio, salida, n_salida) != 0;
+    }
+    free(intermedio);
+    return resultado;
+}
+
+// "-" como entrada o salida es la entrada o la salida estándar
+static int es_estandar(const char *path) {
+    return path && strcmp(path, "-") == 0;
+}
+
+// Con -o - los datos van a la salida estándar original y los mensajes (que
+// se escriben en stdout) pasan a stderr para no mezclarse con ellos
+static int abrir_salida_estandar(void) {
+    fflush(stdout);
+    int fd = dup(STDOUT_FILENO);
+    if (fd >= 0 && dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int procesar_archivo(ContextoCodec *ctx, const char *input_file, const char *output_file, int actions[], const char *alg) {
+    int fd_in = es_estandar(input_file) ? dup(STDIN_FILENO) : open(input_file, O_RDONLY);
+    if (fd_in < 0) { perror("open input"); return 1; }
+    int fd_out = es_estandar(output_file) ? abrir_salida_estandar() : open(output_file, flags_salida(), 0644);
+    if (fd_out < 0) { perror("open output"); close(fd_in); return 1; }
+
+    int resultado = procesar_descriptores(ctx, fd_in, fd_out, actions, alg);
+
+    close(fd_in);
+    close(fd_out);
+    return resultado;
+}
+
+// Ruta de salida: el directorio de path (si tiene) seguido de outputFile
+char *actualizarPath(const char *path, const char *outputFile){
+    const char *slash = strrchr(path, '/');
+    size_t prefijo = slash ? (size_t)(slash - path) + 1 : 0;
+
+     // Reservar memoria dinámica para devolver el nombre
+    char *resultado = malloc(prefijo + strlen(outputFile) + 1);
+    if (!resultado) return NULL;
+
+    memcpy(resultado, path, prefijo);
+    strcpy(resultado + prefijo, outputFile);
+    return resultado; 
+}
+
+
+
+// Opciones de ejecución que vienen de la línea de comandos
+typedef struct {
+    int num_hilos;                  // 0: un hilo por CPU en linea
+    long long presupuesto_memoria;  // para tareas grandes (--mem-budget)
+    int io_uring;                   // lotes de archivos pequeños con io_uring (--io=uring)
+} OpcionesEjecucion;
+
+// Procesa un archivo del recorrido abriendo relativo a sus directorios
+int procesar_trabajo(void *contexto, TrabajoArchivo *t) {
+    int fd_in = t->fd_in;   // puede venir abierto de la precarga
+    t->fd_in = -1;
+    if (fd_in < 0) fd_in = dir_abrir_archivo(t->dir_in, t->nombre_in, O_RDONLY, 0);
+    if (fd_in < 0) {
+        perror("open input");
+        trabajo_soltar_dirs(t);
+        return 1;
+    }
+    int fd_out = dir_abrir_archivo(t->dir_out, t->nombre_out, flags_salida(), 0644);
+    if (fd_out < 0) {
+        perror("open output");
+        close(fd_in);
+        trabajo_soltar_dirs(t);
+        return 1;
+    }
+
+    int resultado = procesar_descriptores(contexto, fd_in, fd_out, t->actions, t->alg);
+
+    close(fd_in);
+    close(fd_out);
+    trabajo_soltar_dirs(t);
+    return resultado;
+}
+
+/**
+ * Solo AES se puede dividir por ahora: en ECB cada bloque de 16 bytes se
+ * cifra por separado y en CTR cada byte depende solo de su posición, y en
+ * los dos la salida tiene un tamaño conocido de antemano.
+ *
+ * Huffman y ANS también van por bloques independientes, pero sus partes no
+ * encajan en este esquema: al comprimir, dónde empieza la salida de cada
+ * parte se sabe recién al codificar las anteriores, y al descomprimir los
+ * registros tienen largos distintos (no hay una alineación fija). Quedan
+ * para cuando procesar_parte pueda recibir cortes ya medidos; mientras
+ * tanto un archivo grande de esos codecs es una sola tarea.
+ */
+long alineacion_division(const TrabajoArchivo *t) {
+    if (strcmp(t->alg, "aes") == 0) return AES_BLOCK_SIZE;
+    return 0;
+}
+
+int preparar_division(TrabajoArchivo *t) {
+    t->fd_in = dir_abrir_archivo(t->dir_in, t->nombre_in, O_RDONLY, 0);
+    if (t->fd_in < 0) { perror("open input"); return -1; }
+    t->fd_out = dir_abrir_archivo(t->dir_out, t->nombre_out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (t->fd_out < 0) { perror("open output"); close(t->fd_in); return -1; }
+
+    int ok = 0;
+    if (aes_ctr && t->actions[2]) {
+        // CTR: mismo tamaño que el original, detrás del encabezado con el nonce
+        t->tamano_datos = t->tamano;
+        t->tamano_original = t->tamano;
+        ok = aes_ctr_generar_nonce(t->nonce) == 0 &&
+             aes_ctr_escribir_encabezado(t->fd_out, t->nonce) == 0 &&
+             ftruncate(t->fd_out, AES_CTR_TAM_ENCABEZADO + t->tamano) == 0;
+    } else if (aes_ctr && t->actions[3]) {
+        t->tamano_datos = t->tamano - AES_CTR_TAM_ENCABEZADO;
+        t->tamano_original = t->tamano_datos;
+        ok = aes_ctr_leer_encabezado(t->fd_in, t->nonce) == 0 &&
+             ftruncate(t->fd_out, t->tamano_datos) == 0;
+    } else if (t->actions[2]) {
+        // cifrar: encabezado con el tamaño original y salida con su tamaño final
+        t->tamano_datos = t->tamano;
+        t->tamano_original = t->tamano;
+        ok = aes_escribir_encabezado(t->fd_out, t->tamano) == 0 &&
+             ftruncate(t->fd_out, aes_tamano_cifrado(t->tamano)) == 0;
+    } else if (t->actions[3]) {
+        // descifrar: el tamaño original está en el encabezado
+        long datos = t->tamano - (long)sizeof(long);
+        t->tamano_datos = datos - datos % AES_BLOCK_SIZE;
+        ok = aes_leer_encabezado(t->fd_in, &t->tamano_original) == 0 &&
+             t->tamano_datos >= 0;
+        if (ok && t->tamano_original == AES_TAMANO_DESCONOCIDO) {
+            // cifrado desde una tubería: el tamaño sale del padding
+            unsigned char clave[16] = {0};
+            AES_Context aes;
+            generar_clave_aes("clave123", clave);
+            aes_key_expansion(clave, &aes);
+            ok = aes_resolver_tamano(t->fd_in, &aes, t->tamano_datos, &t->tamano_original) == 0;
+        }
+        if (ok) {
+            long final = t->tamano_original < t->tamano_datos ? t->tamano_original : t->tamano_datos;
+            ok = final >= 0 && ftruncate(t->fd_out, final) == 0;
+        }
+    }
+
+    if (!ok) {
+        close(t->fd_in);
+        close(t->fd_out);
+        t->fd_in = t->fd_out = -1;
+        return -1;
+    }
+    return 0;
+}
+
+int procesar_parte(void *contexto, TrabajoArchivo *t, long inicio, long longitud) {
+    (void)contexto;
+    unsigned char clave[16] = {0};
+    AES_Context aes;
+    generar_clave_aes("clave123", clave);
+    aes_key_expansion(clave, &aes);
+
+    if (aes_ctr) {
+        long origen = t->actions[2] ? 0 : AES_CTR_TAM_ENCABEZADO;
+        long destino = t->actions[2] ? AES_CTR_TAM_ENCABEZADO : 0;
+        return aes_ctr_rango(t->fd_in, t->fd_out, &aes, t->nonce, inicio, longitud, origen, destino);
+    }
+    if (t->actions[2]) return cifrar_rango_aes(t->fd_in, t->fd_out, &aes, inicio, longitud);
+    return descifrar_rango_aes(t->fd_in, t->fd_out, &aes, inicio, longitud, t->tamano_original);
+}
+
+void terminar_division(TrabajoArchivo *t) {
+    close(t->fd_in);
+    close(t->fd_out);
+    t->fd_in = t->fd_out = -1;
+    trabajo_soltar_dirs(t);
+}
+
+// Lote completo con io_uring; si el kernel no lo permite se usa la ruta normal
+int procesar_lote_uring(void *contexto, TrabajoArchivo **archivos, int n) {
+    ContextoCodec *ctx = contexto;
+
+    if (ctx->anillo_estado == 0) {
+        ctx->anillo_estado = anillo_iniciar(&ctx->anillo, 256) == 0 ? 1 : -1;
+        if (ctx->anillo_estado < 0) {
+            printf("[HILO %d] io_uring no disponible, se usa E/S normal\n", pool_hilo_actual());
+        }
+    }
+    if (ctx->anillo_estado < 0) return -1;
+
+    return uring_procesar_lote(&ctx->anillo, archivos, n, procesar_memoria, ctx);
+}
+
+static const OperacionesPlanificador operaciones_codec = {
+    procesar_trabajo,
+    alineacion_division,
+    preparar_division,
+    procesar_parte,
+    terminar_division,
+    trabajo_precargar,
+    NULL
+};
+
+int procesar_directorio(const char *path, char *outputFile, int actions[], const char *alg,
+                        const OpcionesEjecucion *opciones) {
+    char *pathDir = actualizarPath(path, outputFile);
+    if (!pathDir) {
+        return 1;
+    }
+
+    if (mkdir(pathDir, 0755) == -1) {
+        perror("mkdir");
+        free(pathDir);
+        return 1;
+    }
+
+    recorrido_ampliar_limite_fds();
+
+    DirAbierto *dir_in = dir_abrir(NULL, path);
+    DirAbierto *dir_out = dir_in ? dir_abrir(NULL, pathDir) : NULL;
+    if (!dir_in || !dir_out) {
+        dir_soltar(dir_in);
+        free(pathDir);
+        return 1;
+    }
+
+    ListaTrabajos lista = {0};
+    int errores = recorrer_directorio_fd(dir_in, dir_out, actions, alg, procesarNombreSalida, &lista);
+
+    // los trabajos retienen los directorios que necesitan
+    dir_soltar(dir_in);
+    dir_soltar(dir_out);
+
+    Pool *pool = pool_crear(opciones->num_hilos, crear_contexto_codec, destruir_contexto_codec);
+    if (!pool) {
+        print_error("Error: No se pudo crear el pool de hilos\n");
+        liberar_trabajos(&lista);
+        free(pathDir);
+        return 1;
+    }
+
+    // planificar por costo y esperar a que terminen todos los trabajos
+    OpcionesPlanificador op_plan = { opciones->presupuesto_memoria };
+    OperacionesPlanificador ops = operaciones_codec;
+    if (opciones->io_uring) ops.procesar_lote = procesar_lote_uring;
+    if (planificar_y_ejecutar(pool, &lista, &ops, &op_plan) != 0) {
+        errores++;
+    }
+    pool_destruir(pool);
+
+    // reportar el resultado de cada trabajo
+    for (int i = 0; i < lista.cantidad; i++) {
+        TrabajoArchivo *t = &lista.items[i];
+        if (t->resultado == 0) {
+            printf("[PID %d] ✓ Trabajo %d (hilo %d) terminó exitosamente: %s\n",
+                   getpid(), i, t->hilo, t->entrada);
+        } else {
+            printf("[PID %d] ✗ Trabajo %d (hilo %d) terminó con error (código %d): %s\n",
+                   getpid(), i, t->hilo, t->resultado, t->entrada);
+            errores++;
+        }
+    }
+
+    printf("[PID %d] ✓ Todos los trabajos completados para: %s\n",
+           getpid(), path);
+
+    liberar_trabajos(&lista);
+    free(pathDir);
+    return errores ? 1 : 0;
+}
+
+
+int procesarEntrada(const char *inputFile, char *outputFile, int actions[], const char *alg,
+                    const OpcionesEjecucion *opciones) {
+    int directorio = es_estandar(inputFile) ? 0 : esDirectorio(inputFile);
+    if (directorio == 1 && es_estandar(outputFile)) {
+        print_error("Error: -o - no se puede usar con un directorio\n");
+        return 1;
+    } else if (directorio == 1) {
+        return procesar_directorio(inputFile, outputFile, actions, alg, opciones);
+    } else if (directorio == 0) {
+        ContextoCodec *ctx = crear_contexto_codec();
+        if (!ctx) {
+            perror("malloc");
+            return 1;
+        }
+        // Un solo archivo: sus bloques de Huffman se reparten entre todos los hilos
+        ctx->huffman.hilos = opciones->num_hilos > 0 ? opciones->num_hilos : pool_hilos_por_defecto();
+        int resultado = procesar_archivo(ctx, inputFile, outputFile, actions, alg);
+        destruir_contexto_codec(ctx);
+        return resultado;
+    } else {
+        print_error("Error: Ruta no válida\n");
+        return 1;
+    }
+}
+
+
+int str_cmp(const char *s1, const char *s2) {
+    int i = 0;
+    while (s1[i] != '\0' && s2[i] != '\0') {
+        if (s1[i] != s2[i]) return s1[i] - s2[i];
+        i++;
+    }
+    return s1[i] - s2[i];
+}
+
+
+
+
+
+// Acumula el histograma de los archivos regulares bajo path (--train)
+static int acumular_corpus(const char *path, unsigned long *frequencies, unsigned char *buf,
+                           long *archivos) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        perror("stat");
+        return -1;
+    }
+
+    if (S_ISREG(st.st_mode)) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) { perror("open input"); return -1; }
+        ssize_t n;
+        while ((n = read(fd, buf, HUFFMAN_TAM_BLOQUE)) > 0) contar_frecuencias(buf, n, frequencies);
+        close(fd);
+        (*archivos)++;
+        return n < 0 ? -1 : 0;
+    }
+    if (!S_ISDIR(st.st_mode)) return 0;
+
+    DIR *dir = opendir(path);
+    if (!dir) {
+        perror("opendir");
+        return -1;
+    }
+    int resultado = 0;
+    struct dirent *entrada;
+    while (resultado == 0 && (entrada = readdir(dir)) != NULL) {
+        if (strcmp(entrada->d_name, ".") == 0 || strcmp(entrada->d_name, "..") == 0) continue;
+        char *ruta = malloc(strlen(path) + strlen(entrada->d_name) + 2);
+        if (!ruta) {
+            resultado = -1;
+            break;
+        }
+        sprintf(ruta, "%s/%s", path, entrada->d_name);
+        resultado = acumular_corpus(ruta, frequencies, buf, archivos);
+        free(ruta);
+    }
+    closedir(dir);
+    return resultado;
+}
+
+// --train: tabla de Huffman con el histograma de todo el corpus
+static int entrenar_tabla(const char *corpus, const char *salida) {
+    unsigned long frequencies[256] = {0};
+    long archivos = 0;
+    unsigned char *buf = malloc(HUFFMAN_TAM_BLOQUE);
+    int resultado = buf ? acumular_corpus(corpus, frequencies, buf, &archivos) : -1;
+    free(buf);
+    if (resultado != 0) return 1;
+
+    TablaHuffman *tabla = huffman_tabla_entrenar(frequencies);
+    if (!tabla) {
+        print_error("Error: No se pudo entrenar la tabla\n");
+        return 1;
+    }
+    int fd = open(salida, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("open output");
+        huffman_tabla_liberar(tabla);
+        return 1;
+    }
+    resultado = huffman_tabla_guardar(tabla, fd);
+    close(fd);
+    huffman_tabla_liberar(tabla);
+    if (resultado != 0) {
+        print_error("Error al escribir la tabla\n");
+        return 1;
+    }
+
+    printf("Tabla entrenada con %ld archivos: %s\n", archivos, salida);
+    return 0;
+}
+
+static int cargar_tabla(const char *ruta) {
+    int fd = open(ruta, O_RDONLY);
+    if (fd < 0) {
+        perror("open table");
+        return -1;
+    }
+    huffman_tabla = huffman_tabla_cargar(fd);
+    close(fd);
+    return huffman_tabla ? 0 : -1;
+}
+
+// --selftest: compara cada implementación con los vectores de referencia
+static int autoverificar(void) {
+    int fallas = 0;
+    if (aes_verificar() == 0) {
+        printf("AES: ok\n");
+    } else {
+        print_error("AES: las implementaciones no coinciden con FIPS-197\n");
+        fallas++;
+    }
+    if (rle_verificar() == 0) {
+        printf("RLE: ok\n");
+    } else {
+        print_error("RLE: el plan de descompresión en paralelo falló\n");
+        fallas++;
+    }
+    if (lz77_verificar() == 0) {
+        printf("LZ77: ok\n");
+    } else {
+        print_error("LZ77: un flujo corrupto no se rechazó\n");
+        fallas++;
+    }
+    return fallas != 0;
+}
+
+int main(int argc, char *argv[]) {
+    int actions[4] = {0, 0, 0, 0}; // 0: comprimir, 1: descomprimir, 2: cifrar, 3: descifrar
+    int isEmpty = 1;
+
+    const char *input_file = NULL;
+    char *output_file = NULL;
+    const char *comp_alg = NULL;
+    const char *enc_alg = NULL;
+    const char *alg = NULL;
+    const char *corpus = NULL;
+    const char *tabla = NULL;
+    int selftest = 0;
+    OpcionesEjecucion opciones = { 0, presupuesto_memoria_por_defecto(), 0 };
+
+    // Parsear argumentos
+   for (int i = 1; i < argc; i++) {
+    if (argv[i][0] == '-') {
+        if (argv[i][1] != '-') {
+            // opciones cortas
+            if (argv[i][1] == 'c') actions[0] = 1;
+            else if (argv[i][1] == 'd') actions[1] = 1;
+            else if (argv[i][1] == 'e') actions[2] = 1;
+            else if (argv[i][1] == 'u') actions[3] = 1;
+            else if (argv[i][1] == 'i' && i + 1 < argc) input_file = argv[++i];
+            else if (argv[i][1] == 'o' && i + 1 < argc) output_file = argv[++i];
+            else if (argv[i][1] == 'j' && i + 1 < argc) {
+                opciones.num_hilos = atoi(argv[++i]);
+                if (opciones.num_hilos <= 0) {
+                    print_error("Error: -j requiere un número de hilos mayor que 0\n");
+                    return 1;
+                }
+            }
+            else {
+                print_error("Opción desconocida\n");
+                return 1;
+            }
+        } else {
+            // opciones largas "--comp-alg" o "--enc-alg"
+            if (strcmp(argv[i], "--comp-alg") == 0 && i + 1 < argc) {
+                comp_alg = argv[++i];
+            } else if (strcmp(argv[i], "--enc-alg") == 0 && i + 1 < argc) {
+                enc_alg = argv[++i];
+            } else if (strcmp(argv[i], "--mem-budget") == 0 && i + 1 < argc) {
+                opciones.presupuesto_memoria = parsear_tamano(argv[++i]);
+                if (opciones.presupuesto_memoria < 0) {
+                    print_error("Error: --mem-budget inválido (ej: 512M, 2G)\n");
+                    return 1;
+                }
+            } else if (strcmp(argv[i], "--buffer-size") == 0 && i + 1 < argc) {
+                long long tam = parsear_tamano(argv[++i]);
+                if (tam < TUBERIA_BUFFER_MIN || tam > TUBERIA_BUFFER_MAX) {
+                    print_error("Error: --buffer-size debe estar entre 1M y 8M\n");
+                    return 1;
+                }
+                config_tuberia.tam_buffer = tam;
+            } else if (strcmp(argv[i], "--direct") == 0) {
+                config_tuberia.directo = 1;
+            } else if (strcmp(argv[i], "--sample") == 0) {
+                huffman_muestreo = 1;
+            } else if (strcmp(argv[i], "--train") == 0 && i + 1 < argc) {
+                corpus = argv[++i];
+            } else if (strcmp(argv[i], "--selftest") == 0) {
+                selftest = 1;
+            } else if (strcmp(argv[i], "--table") == 0 && i + 1 < argc) {
+                tabla = argv[++i];
+            } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+                if (filtro_parsear(argv[++i], &config_filtro) != 0) {
+                    print_error("Error: --filter debe ser delta, delta:auto o delta:N (N entre 1 y 255)\n");
+                    return 1;
+                }
+            } else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+                config_lz77.nivel = atoi(argv[++i]);
+                if (config_lz77.nivel < LZ77_NIVEL_MIN || config_lz77.nivel > LZ77_NIVEL_MAX) {
+                    print_error("Error: --level debe estar entre 1 y 9\n");
+                    return 1;
+                }
+            } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+                long long tam = parsear_tamano(argv[++i]);
+                if (tam < LZ77_VENTANA_MIN || tam > LZ77_TAM_TROZO || (tam & (tam - 1)) != 0) {
+                    print_error("Error: --window debe ser una potencia de 2 entre 4K y 8M\n");
+                    return 1;
+                }
+                config_lz77.ventana = tam;
+            } else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+                const char *modo = argv[++i];
+                if (strcmp(modo, "ctr") == 0) aes_ctr = 1;
+                else if (strcmp(modo, "ecb") == 0) aes_ctr = 0;
+                else {
+                    print_error("Error: --mode debe ser 'ecb' o 'ctr'\n");
+                    return 1;
+                }
+            } else if (strncmp(argv[i], "--io", 4) == 0) {
+                const char *modo = NULL;
+                if (argv[i][4] == '=') modo = argv[i] + 5;
+                else if (argv[i][4] == '\0' && i + 1 < argc) modo = argv[++i];
+
+                if (modo && strcmp(modo, "uring") == 0) opciones.io_uring = 1;
+                else if (modo && strcmp(modo, "mmap") == 0) io_mapeada = 1;
+                else if (modo && strcmp(modo, "sync") == 0) opciones.io_uring = io_mapeada = 0;
+                else {
+                    print_error("Error: --io debe ser 'uring', 'mmap' o 'sync'\n");
+                    return 1;
+                }
+            } else {
+                print_error("Opción desconocida\n");
+                return 1;
+            }
+        }
+    }
+}
+
+
+    if (selftest) return autoverificar();
+
+    if (corpus) {
+        if (!output_file) {
+            print_error("Error: --train requiere -o <tabla>\n");
+            return 1;
+        }
+        return entrenar_tabla(corpus, output_file);
+    }
+
+    if (comp_alg && enc_alg) {
+        print_error("Error: No puede usar dos algoritmos al mismo tiempo\n");
+        return 1;
+    }
+
+    // Determinar algoritmo a usar
+    if (actions[0] || actions[1]) alg = "Huffman"; // por defecto compresión
+    else if (actions[2] || actions[3]) alg = "aes"; // por defecto cifrado
+
+    if (comp_alg != NULL && (actions[0] || actions[1])) {
+        if (strcmp(comp_alg, "rle") == 0) alg = "rle";
+        else if (strcmp(comp_alg, "huffman") == 0) alg = "Huffman";
+        else if (strcmp(comp_alg, "lz77") == 0) alg = "lz77";
+        else if (strcmp(comp_alg, "ans") == 0) {
+            // Comparte todo el camino de Huffman; al descomprimir lo indica la magia
+            alg = "Huffman";
+            huffman_ans = 1;
+        }
+    }
+
+    if (enc_alg != NULL && (actions[2] || actions[3])) {
+        if (strcmp(enc_alg, "aes") == 0) alg = "aes";
+    }
+
+    // Verificar que se haya especificado alguna acción
+    for (int i = 0; i < 4; i++)
+        if (actions[i]) { isEmpty = 0; break; }
+
+    if (isEmpty) {
+        print_error("Error: Debe especificar -c (comprimir), -d (descomprimir), -e (cifrar) o -u (descifrar)\n");
+        return 1;
+    }
+
+    if (tabla && huffman_ans) {
+        print_error("Error: --table es una tabla de Huffman, no se usa con --comp-alg ans\n");
+        return 1;
+    }
+    if (config_filtro.activo && !(actions[0] || actions[1])) {
+        print_error("Error: --filter solo se usa al comprimir o descomprimir\n");
+        return 1;
+    }
+    if (aes_ctr && strcmp(alg, "aes") != 0) {
+        print_error("Error: --mode solo se usa al cifrar o descifrar con AES\n");
+        return 1;
+    }
+    if (tabla && strcmp(alg, "lz77") == 0) {
+        print_error("Error: --table no se usa con --comp-alg lz77 (cada flujo lleva sus tablas)\n");
+        return 1;
+    }
+    if (tabla && cargar_tabla(tabla) != 0) return 1;
+
+    // Llamada final
+    int resultado = procesarEntrada(input_file, output_file, actions, alg, &opciones);
+    huffman_tabla_liberar(huffman_tabla);
+    return resultado;
+}
@@ -0,0 +1,52 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mapeo.h"
+
+int mapear_entrada(int fd, const unsigned char **datos, size_t *n) {
+    struct stat st;
+    *datos = NULL;
+    *n = 0;
+    if (fstat(fd, &st) != 0) return -1;
+    if (st.st_size == 0) return 0;
+
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) return -1;
+
+    // Las dos sugerencias son opcionales: se ignoran si el kernel no las acepta
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(p, st.st_size, MADV_HUGEPAGE);
+#endif
+
+    *datos = p;
+    *n = st.st_size;
+    return 0;
+}
+
+int mapear_salida(int fd, size_t n, unsigned char **datos) {
+    *datos = NULL;
+    if (ftruncate(fd, 0) != 0) return -1;
+    if (n == 0) return 0;
+
+    // fallocate reserva los bloques de una vez; si el sistema de archivos no
+    // lo soporta basta con extender el archivo
+    if (fallocate(fd, 0, 0, n) != 0) {
+        if (errno != EOPNOTSUPP && errno != ENOSYS) return -1;
+        if (ftruncate(fd, n) != 0) return -1;
+    }
+
+    void *p = mmap(NULL, n, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) return -1;
+    madvise(p, n, MADV_SEQUENTIAL);
+
+    *datos = p;
+    return 0;
+}
+
+void desmapear(const void *datos, size_t n) {
+    if (datos && n > 0) munmap((void *)datos, n);
+}
@@ -0,0 +1,33 @@
+#ifndef MAPEO_H
+#define MAPEO_H
+
+#include <stddef.h>
+
+/**
+ * E/S con archivos mapeados en memoria (--io=mmap).
+ *
+ * La entrada se mapea una sola vez y los codecs la recorren directamente
+ * (sin read() ni copias a buffers intermedios). Cuando el tamaño de la
+ * salida se conoce de antemano, se reserva con fallocate, se mapea y el
+ * codec escribe directamente sobre ella. La salida debe estar abierta con
+ * O_RDWR para poder mapearla.
+ */
+
+/**
+ * mapear_entrada - Mapea fd completo para lectura secuencial
+ * Un archivo vacío deja *datos en NULL y *n en 0.
+ * Retorna: 0 si se pudo, -1 si hubo error
+ */
+int mapear_entrada(int fd, const unsigned char **datos, size_t *n);
+
+/**
+ * mapear_salida - Reserva n bytes en fd (fallocate) y los mapea para escritura
+ * Con n == 0 solo deja el archivo vacío y *datos en NULL.
+ * Retorna: 0 si se pudo, -1 si hubo error
+ */
+int mapear_salida(int fd, size_t n, unsigned char **datos);
+
+// Deshace un mapeo de mapear_entrada o mapear_salida (acepta NULL)
+void desmapear(const void *datos, size_t n);
+
+#endif // MAPEO_H
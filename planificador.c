@@ -0,0 +1,404 @@
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "planificador.h"
+#include "recorrido.h"
+
+// Archivos por debajo de este tamaño se agrupan en lotes
+#define UMBRAL_PEQUENO      (64L * 1024)
+#define LOTE_MAX_BYTES      (1L * 1024 * 1024)
+#define LOTE_MAX_ARCHIVOS   256
+
+// Archivos del lote que se abren por adelantado con POSIX_FADV_WILLNEED
+#define VENTANA_PRECARGA    8
+
+// Archivos desde este tamaño se dividen en partes (si el codec lo permite)
+#define UMBRAL_DIVISION     (64L * 1024 * 1024)
+#define TAMANO_PARTE        (16L * 1024 * 1024)
+
+// Tareas desde este tamaño reservan memoria del presupuesto
+#define UMBRAL_GRANDE       (8L * 1024 * 1024)
+#define MEMORIA_MAX_TAREA   (64L * 1024 * 1024)
+
+// Costo fijo de una tarea por archivo (open, close, creat...) en "bytes equivalentes"
+#define COSTO_FIJO_ARCHIVO  (32L * 1024)
+
+typedef enum {
+    TAREA_ARCHIVO,
+    TAREA_LOTE,
+    TAREA_PARTE
+} TipoTarea;
+
+typedef struct Planificacion Planificacion;
+
+typedef struct {
+    TipoTarea tipo;
+    double costo;
+    long memoria;
+    TrabajoArchivo **archivos;  // 1 para ARCHIVO y PARTE, varios para LOTE
+    int num_archivos;
+    long inicio;                // solo PARTE
+    long longitud;
+    int num_parte;
+    int total_partes;
+    Planificacion *plan;
+} Tarea;
+
+struct Planificacion {
+    const OperacionesPlanificador *ops;
+
+    // Presupuesto de memoria compartido por las tareas grandes
+    pthread_mutex_t mutex;
+    pthread_cond_t liberada;
+    long long presupuesto;
+    long long en_uso;
+};
+
+TrabajoArchivo *agregar_trabajo(ListaTrabajos *lista, const char *entrada, const char *salida, long tamano,
+                                int actions[], const char *alg) {
+    if (lista->cantidad >= lista->capacidad) {
+        int nueva_cap = lista->capacidad ? lista->capacidad * 2 : 64;
+        TrabajoArchivo *nuevos = realloc(lista->items, nueva_cap * sizeof(TrabajoArchivo));
+        if (!nuevos) {
+            perror("realloc");
+            return NULL;
+        }
+        lista->items = nuevos;
+        lista->capacidad = nueva_cap;
+    }
+
+    TrabajoArchivo *t = &lista->items[lista->cantidad];
+    memset(t, 0, sizeof(*t));
+    t->entrada = strdup(entrada);
+    t->salida = strdup(salida);
+    if (!t->entrada || !t->salida) {
+        free(t->entrada);
+        free(t->salida);
+        return NULL;
+    }
+    t->tamano = tamano;
+    t->actions = actions;
+    t->alg = alg;
+    t->resultado = -1;
+    t->hilo = -1;
+    t->fd_in = -1;
+    t->fd_out = -1;
+    lista->cantidad++;
+    return t;
+}
+
+void liberar_trabajos(ListaTrabajos *lista) {
+    for (int i = 0; i < lista->cantidad; i++) {
+        if (lista->items[i].fd_in >= 0) close(lista->items[i].fd_in);
+        trabajo_soltar_dirs(&lista->items[i]);
+        free(lista->items[i].entrada);
+        free(lista->items[i].salida);
+    }
+    free(lista->items);
+    lista->items = NULL;
+    lista->cantidad = lista->capacidad = 0;
+}
+
+long long parsear_tamano(const char *texto) {
+    char *fin;
+    errno = 0;
+    long long valor = strtoll(texto, &fin, 10);
+    if (fin == texto || valor < 0 || errno == ERANGE) return -1;
+
+    int desplazamiento;
+    switch (*fin) {
+        case '\0': return valor;
+        case 'k': case 'K': desplazamiento = 10; break;
+        case 'm': case 'M': desplazamiento = 20; break;
+        case 'g': case 'G': desplazamiento = 30; break;
+        case 't': case 'T': desplazamiento = 40; break;
+        default: return -1;
+    }
+    // Un valor que no cabe tras el sufijo se rechaza en vez de desbordar
+    if (fin[1] != '\0' || valor > LLONG_MAX >> desplazamiento) return -1;
+    return valor << desplazamiento;
+}
+
+long long presupuesto_memoria_por_defecto(void) {
+    long paginas = sysconf(_SC_PHYS_PAGES);
+    long tam_pagina = sysconf(_SC_PAGESIZE);
+    if (paginas <= 0 || tam_pagina <= 0) return 0;
+    return (long long)paginas * tam_pagina / 2;
+}
+
+/**
+ * Costo relativo por byte de cada codec, medido con -j 1 contra comprimir con
+ * RLE (texto y binario, 12-32 MB): Huffman ~2-3x en ambos sentidos; LZ77 ~30x
+ * al comprimir por la búsqueda de coincidencias, pero descomprimir es casi solo
+ * copiar (~2x); AES con tablas T o AES-NI queda a la par de RLE en ECB y por
+ * debajo en CTR, así que se cuenta como una pasada.
+ */
+static double factor_costo(const TrabajoArchivo *t) {
+    if (strcmp(t->alg, "Huffman") == 0) return t->actions[0] ? 2.5 : 2.0;
+    if (strcmp(t->alg, "lz77") == 0) return t->actions[0] ? 30.0 : 2.0;
+    return 1.0;
+}
+
+// Memoria estimada de una tarea que procesa n bytes (0 si es pequeña)
+static long estimar_memoria(long n) {
+    if (n < UMBRAL_GRANDE) return 0;
+    return n < MEMORIA_MAX_TAREA ? n : MEMORIA_MAX_TAREA;
+}
+
+static void reservar_memoria(Planificacion *plan, long n) {
+    if (plan->presupuesto == 0 || n == 0) return;
+
+    pthread_mutex_lock(&plan->mutex);
+    // Siempre se deja correr al menos una tarea, aunque exceda el presupuesto
+    while (plan->en_uso > 0 && plan->en_uso + n > plan->presupuesto) {
+        pthread_cond_wait(&plan->liberada, &plan->mutex);
+    }
+    plan->en_uso += n;
+    pthread_mutex_unlock(&plan->mutex);
+}
+
+static void liberar_memoria(Planificacion *plan, long n) {
+    if (plan->presupuesto == 0 || n == 0) return;
+
+    pthread_mutex_lock(&plan->mutex);
+    plan->en_uso -= n;
+    pthread_cond_broadcast(&plan->liberada);
+    pthread_mutex_unlock(&plan->mutex);
+}
+
+static void ejecutar_archivo(Tarea *tarea, TrabajoArchivo *t, void *contexto, int hilo) {
+    t->hilo = hilo;
+    printf("[HILO %d] Procesando: %s\n", hilo, t->entrada);
+    t->resultado = tarea->plan->ops->procesar(contexto, t);
+}
+
+// Trabajo que ejecuta cada hilo del pool
+static void ejecutar_tarea(void *arg, void *contexto) {
+    Tarea *tarea = arg;
+    Planificacion *plan = tarea->plan;
+    int hilo = pool_hilo_actual();
+
+    reservar_memoria(plan, tarea->memoria);
+
+    switch (tarea->tipo) {
+        case TAREA_ARCHIVO:
+            ejecutar_archivo(tarea, tarea->archivos[0], contexto, hilo);
+            break;
+
+        case TAREA_LOTE:
+            printf("[HILO %d] Procesando lote de %d archivos\n", hilo, tarea->num_archivos);
+            if (plan->ops->procesar_lote &&
+                plan->ops->procesar_lote(contexto, tarea->archivos, tarea->num_archivos) == 0) {
+                break;
+            }
+            for (int i = 0; i < tarea->num_archivos; i++) {
+                // Mantener abiertos y en lectura anticipada los siguientes archivos
+                if (plan->ops->precargar) {
+                    for (int k = i; k < i + VENTANA_PRECARGA && k < tarea->num_archivos; k++) {
+                        plan->ops->precargar(tarea->archivos[k]);
+                    }
+                }
+                ejecutar_archivo(tarea, tarea->archivos[i], contexto, hilo);
+            }
+            break;
+
+        case TAREA_PARTE: {
+            TrabajoArchivo *t = tarea->archivos[0];
+            printf("[HILO %d] Procesando parte %d/%d de: %s\n",
+                   hilo, tarea->num_parte + 1, tarea->total_partes, t->entrada);
+
+            int r = plan->ops->procesar_parte(contexto, t, tarea->inicio, tarea->longitud);
+            if (r != 0) __atomic_store_n(&t->resultado, r, __ATOMIC_RELAXED);
+
+            // La última parte en terminar cierra el archivo
+            if (__atomic_sub_fetch(&t->partes_pendientes, 1, __ATOMIC_ACQ_REL) == 0) {
+                t->hilo = hilo;
+                plan->ops->terminar_division(t);
+            }
+            break;
+        }
+    }
+
+    liberar_memoria(plan, tarea->memoria);
+}
+
+static int comparar_tareas(const void *a, const void *b) {
+    const Tarea *ta = a;
+    const Tarea *tb = b;
+    if (ta->costo > tb->costo) return -1;
+    if (ta->costo < tb->costo) return 1;
+    return 0;
+}
+
+// Arreglo dinámico de tareas
+typedef struct {
+    Tarea *items;
+    int cantidad;
+    int capacidad;
+} ListaTareas;
+
+static Tarea *nueva_tarea(ListaTareas *lt, TipoTarea tipo, Planificacion *plan) {
+    if (lt->cantidad >= lt->capacidad) {
+        int nueva_cap = lt->capacidad ? lt->capacidad * 2 : 64;
+        Tarea *nuevas = realloc(lt->items, nueva_cap * sizeof(Tarea));
+        if (!nuevas) {
+            perror("realloc");
+            return NULL;
+        }
+        lt->items = nuevas;
+        lt->capacidad = nueva_cap;
+    }
+    Tarea *tarea = &lt->items[lt->cantidad++];
+    memset(tarea, 0, sizeof(*tarea));
+    tarea->tipo = tipo;
+    tarea->plan = plan;
+    return tarea;
+}
+
+// Intenta dividir t en partes; retorna 1 si lo dividió
+static int dividir_archivo(ListaTareas *lt, Planificacion *plan, TrabajoArchivo **ref) {
+    const OperacionesPlanificador *ops = plan->ops;
+    TrabajoArchivo *t = *ref;
+
+    if (!ops->alineacion_division || t->tamano < UMBRAL_DIVISION) return 0;
+    long alineacion = ops->alineacion_division(t);
+    if (alineacion <= 0) return 0;
+    if (ops->preparar_division(t) != 0) return 0;
+
+    long tam_parte = TAMANO_PARTE - TAMANO_PARTE % alineacion;
+    int total = (int)((t->tamano_datos + tam_parte - 1) / tam_parte);
+    if (total == 0) total = 1;
+
+    t->resultado = 0;
+    t->partes_pendientes = total;
+
+    for (int i = 0; i < total; i++) {
+        Tarea *tarea = nueva_tarea(lt, TAREA_PARTE, plan);
+        if (!tarea) {
+            // Las partes que no se crearon cuentan como terminadas con error
+            t->resultado = -1;
+            t->partes_pendientes -= total - i;
+            if (t->partes_pendientes == 0) ops->terminar_division(t);
+            return 1;
+        }
+        tarea->archivos = ref;
+        tarea->num_archivos = 1;
+        tarea->inicio = (long)i * tam_parte;
+        tarea->longitud = t->tamano_datos - tarea->inicio;
+        if (tarea->longitud > tam_parte) tarea->longitud = tam_parte;
+        tarea->num_parte = i;
+        tarea->total_partes = total;
+        tarea->costo = tarea->longitud * factor_costo(t);
+        tarea->memoria = estimar_memoria(tarea->longitud);
+    }
+    return 1;
+}
+
+int planificar_y_ejecutar(Pool *pool, ListaTrabajos *lista, const OperacionesPlanificador *ops,
+                          const OpcionesPlanificador *opciones) {
+    int num_hilos = pool_num_hilos(pool);
+    Planificacion plan;
+    plan.ops = ops;
+    plan.presupuesto = opciones->presupuesto_memoria;
+    plan.en_uso = 0;
+    pthread_mutex_init(&plan.mutex, NULL);
+    pthread_cond_init(&plan.liberada, NULL);
+
+    ListaTareas lt = {0};
+    TrabajoArchivo **refs = malloc((lista->cantidad + 1) * sizeof(TrabajoArchivo *));
+    double *carga = calloc(num_hilos, sizeof(double));
+    if (!refs || !carga) {
+        perror("malloc");
+        free(refs);
+        free(carga);
+        return -1;
+    }
+
+    // Paso 1: armar tareas (lotes en el orden del recorrido, partes, archivos)
+    int lote = -1;              // índice del lote abierto en lt
+    long bytes_lote = 0;
+    int num_lotes = 0, num_partes = 0;
+
+    for (int i = 0; i < lista->cantidad; i++) {
+        TrabajoArchivo *t = &lista->items[i];
+        refs[i] = t;
+
+        if (t->tamano < UMBRAL_PEQUENO) {
+            if (lote < 0 || bytes_lote >= LOTE_MAX_BYTES ||
+                lt.items[lote].num_archivos >= LOTE_MAX_ARCHIVOS) {
+                Tarea *nuevo = nueva_tarea(&lt, TAREA_LOTE, &plan);
+                if (!nuevo) break;
+                nuevo->archivos = &refs[i];
+                lote = lt.cantidad - 1;
+                bytes_lote = 0;
+                num_lotes++;
+            }
+            lt.items[lote].num_archivos++;
+            lt.items[lote].costo += t->tamano * factor_costo(t) + COSTO_FIJO_ARCHIVO;
+            bytes_lote += t->tamano;
+            continue;
+        }
+
+        // Un archivo grande cierra el lote actual (los lotes son contiguos en refs)
+        lote = -1;
+
+        int antes = lt.cantidad;
+        if (dividir_archivo(&lt, &plan, &refs[i])) {
+            num_partes += lt.cantidad - antes;
+            continue;
+        }
+
+        Tarea *tarea = nueva_tarea(&lt, TAREA_ARCHIVO, &plan);
+        if (!tarea) break;
+        tarea->archivos = &refs[i];
+        tarea->num_archivos = 1;
+        tarea->costo = t->tamano * factor_costo(t) + COSTO_FIJO_ARCHIVO;
+        tarea->memoria = estimar_memoria(t->tamano);
+    }
+
+    // Paso 2: LPT, de la tarea más costosa a la menos costosa
+    qsort(lt.items, lt.cantidad, sizeof(Tarea), comparar_tareas);
+
+    int *hilo_de = malloc((lt.cantidad + 1) * sizeof(int));
+    if (!hilo_de) {
+        perror("malloc");
+        free(lt.items);
+        free(refs);
+        free(carga);
+        return -1;
+    }
+
+    for (int i = 0; i < lt.cantidad; i++) {
+        int menor = 0;
+        for (int h = 1; h < num_hilos; h++) {
+            if (carga[h] < carga[menor]) menor = h;
+        }
+        carga[menor] += lt.items[i].costo;
+        hilo_de[i] = menor;
+    }
+
+    printf("[PID %d] Plan: %d tareas (%d lotes, %d partes) para %d archivos en %d hilos\n",
+           getpid(), lt.cantidad, num_lotes, num_partes, lista->cantidad, num_hilos);
+
+    // Paso 3: encolar en orden ascendente, así cada hilo saca (LIFO) primero su
+    // tarea más costosa y los ladrones se llevan las más baratas
+    for (int i = lt.cantidad - 1; i >= 0; i--) {
+        if (pool_enviar_a(pool, hilo_de[i], ejecutar_tarea, &lt.items[i]) != 0) {
+            fprintf(stderr, "Error: No se pudo encolar tarea\n");
+        }
+    }
+
+    pool_esperar(pool);
+
+    pthread_mutex_destroy(&plan.mutex);
+    pthread_cond_destroy(&plan.liberada);
+    free(hilo_de);
+    free(lt.items);
+    free(refs);
+    free(carga);
+    return 0;
+}
@@ -0,0 +1,110 @@
+#ifndef PLANIFICADOR_H
+#define PLANIFICADOR_H
+
+#include "pool.h"
+
+struct DirAbierto;
+
+/**
+ * Planificador de trabajos para directorios.
+ *
+ * A partir del pre-escaneo (tamaño de cada archivo) arma un modelo de costo y
+ * reparte las tareas con LPT (la más costosa primero, al hilo menos cargado):
+ *  - los archivos pequeños se agrupan en lotes para no pagar el costo fijo
+ *    de una tarea por cada uno (en orden de recorrido, precargando los
+ *    siguientes archivos del lote);
+ *  - los archivos enormes se dividen en partes independientes si el codec lo
+ *    permite;
+ *  - las tareas grandes reservan memoria de un presupuesto (--mem-budget)
+ *    antes de ejecutarse, limitando cuántas corren a la vez.
+ */
+
+// Un archivo a procesar dentro de un directorio
+typedef struct {
+    char *entrada;
+    char *salida;
+    long tamano;
+    int *actions;
+    const char *alg;
+    int resultado;
+    int hilo;
+
+    // Directorios que contienen la entrada y la salida (ver recorrido.h);
+    // nombre_in/nombre_out apuntan al último componente de entrada/salida
+    struct DirAbierto *dir_in;
+    struct DirAbierto *dir_out;
+    const char *nombre_in;
+    const char *nombre_out;
+
+    // Entrada abierta por adelantado (precarga) o para dividir en partes
+    int fd_in;
+    int fd_out;
+    long tamano_datos;          // bytes a repartir entre las partes
+    long tamano_original;       // tamaño del archivo original (descifrado)
+    unsigned char nonce[8];     // AES-CTR: el del encabezado, común a todas las partes
+    int partes_pendientes;
+} TrabajoArchivo;
+
+// Arreglo dinámico de trabajos
+typedef struct {
+    TrabajoArchivo *items;
+    int cantidad;
+    int capacidad;
+} ListaTrabajos;
+
+// Retorna el trabajo agregado (válido hasta el próximo agregar_trabajo), o NULL
+TrabajoArchivo *agregar_trabajo(ListaTrabajos *lista, const char *entrada, const char *salida, long tamano,
+                                int actions[], const char *alg);
+void liberar_trabajos(ListaTrabajos *lista);
+
+/**
+ * Operaciones que el planificador delega en quien conoce los codecs.
+ * Las de división pueden ser NULL si ningún codec soporta partes.
+ */
+typedef struct {
+    // Procesa un archivo completo con el contexto del hilo
+    int (*procesar)(void *contexto, TrabajoArchivo *t);
+
+    // Alineación de las partes (en bytes) si el archivo se puede dividir, 0 si no
+    long (*alineacion_division)(const TrabajoArchivo *t);
+
+    // Abre la entrada/salida, escribe encabezados y fija tamano_datos
+    int (*preparar_division)(TrabajoArchivo *t);
+
+    // Procesa el rango [inicio, inicio + longitud) de los datos
+    int (*procesar_parte)(void *contexto, TrabajoArchivo *t, long inicio, long longitud);
+
+    // Cierra lo abierto por preparar_division
+    void (*terminar_division)(TrabajoArchivo *t);
+
+    // Abre la entrada por adelantado para que el kernel la vaya leyendo (puede ser NULL)
+    void (*precargar)(TrabajoArchivo *t);
+
+    // Procesa un lote completo de una vez (puede ser NULL); si retorna
+    // distinto de 0 el lote se procesa archivo por archivo
+    int (*procesar_lote)(void *contexto, TrabajoArchivo **archivos, int n);
+} OperacionesPlanificador;
+
+typedef struct {
+    long long presupuesto_memoria;   // bytes, 0 = sin límite
+} OpcionesPlanificador;
+
+/**
+ * planificar_y_ejecutar - Arma el plan para la lista y lo ejecuta en el pool
+ *
+ * Retorna cuando terminaron todas las tareas. El resultado de cada archivo
+ * queda en su campo resultado.
+ */
+int planificar_y_ejecutar(Pool *pool, ListaTrabajos *lista, const OperacionesPlanificador *ops,
+                          const OpcionesPlanificador *opciones);
+
+/**
+ * parsear_tamano - Convierte "512M", "2G", "64K" o "1048576" a bytes
+ * Retorna: el tamaño, o -1 si el texto no es válido
+ */
+long long parsear_tamano(const char *texto);
+
+// Presupuesto por defecto: la mitad de la memoria física
+long long presupuesto_memoria_por_defecto(void);
+
+#endif // PLANIFICADOR_H
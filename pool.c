@@ -0,0 +1,325 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "pool.h"
+
+#define DEQUE_CAPACIDAD_INICIAL 64
+
+typedef struct {
+    FuncionTrabajo funcion;
+    void *arg;
+} Trabajo;
+
+// Deque circular protegida por su propio mutex
+typedef struct {
+    Trabajo *items;
+    int capacidad;
+    int frente;      // indice del primer elemento (lado de los ladrones)
+    int cantidad;
+    pthread_mutex_t mutex;
+} Deque;
+
+typedef struct {
+    Pool *pool;
+    int indice;
+    pthread_t hilo;
+    void *contexto;
+} Trabajador;
+
+struct Pool {
+    int num_hilos;
+    int num_deques;
+    Trabajador *trabajadores;
+    Deque *deques;
+
+    void *(*crear_contexto)(void);
+    void (*destruir_contexto)(void *);
+
+    pthread_mutex_t mutex;          // protege los contadores y el cierre
+    pthread_cond_t hay_trabajo;     // se señala al encolar
+    pthread_cond_t terminado;       // se señala cuando pendientes llega a 0
+    long disponibles;               // trabajos encolados sin tomar
+    long pendientes;                // trabajos encolados o en ejecucion
+    int cerrando;
+    unsigned int siguiente;         // round-robin para envios externos
+};
+
+// Indice del hilo actual dentro de su pool (-1 fuera del pool)
+static __thread int hilo_actual = -1;
+static __thread Pool *pool_actual = NULL;
+
+static int deque_init(Deque *dq) {
+    dq->items = malloc(DEQUE_CAPACIDAD_INICIAL * sizeof(Trabajo));
+    if (!dq->items) return -1;
+    dq->capacidad = DEQUE_CAPACIDAD_INICIAL;
+    dq->frente = 0;
+    dq->cantidad = 0;
+    pthread_mutex_init(&dq->mutex, NULL);
+    return 0;
+}
+
+static void deque_destruir(Deque *dq) {
+    free(dq->items);
+    pthread_mutex_destroy(&dq->mutex);
+}
+
+// Agregar al final (lado del dueño)
+static int deque_push(Deque *dq, Trabajo t) {
+    pthread_mutex_lock(&dq->mutex);
+
+    if (dq->cantidad == dq->capacidad) {
+        int nueva_cap = dq->capacidad * 2;
+        Trabajo *nuevos = malloc(nueva_cap * sizeof(Trabajo));
+        if (!nuevos) {
+            pthread_mutex_unlock(&dq->mutex);
+            return -1;
+        }
+        for (int i = 0; i < dq->cantidad; i++) {
+            nuevos[i] = dq->items[(dq->frente + i) % dq->capacidad];
+        }
+        free(dq->items);
+        dq->items = nuevos;
+        dq->capacidad = nueva_cap;
+        dq->frente = 0;
+    }
+
+    dq->items[(dq->frente + dq->cantidad) % dq->capacidad] = t;
+    dq->cantidad++;
+
+    pthread_mutex_unlock(&dq->mutex);
+    return 0;
+}
+
+// Sacar del final (dueño, LIFO)
+static int deque_pop(Deque *dq, Trabajo *t) {
+    int ok = 0;
+    pthread_mutex_lock(&dq->mutex);
+    if (dq->cantidad > 0) {
+        dq->cantidad--;
+        *t = dq->items[(dq->frente + dq->cantidad) % dq->capacidad];
+        ok = 1;
+    }
+    pthread_mutex_unlock(&dq->mutex);
+    return ok;
+}
+
+// Sacar del frente (ladrones, FIFO)
+static int deque_robar(Deque *dq, Trabajo *t) {
+    int ok = 0;
+    pthread_mutex_lock(&dq->mutex);
+    if (dq->cantidad > 0) {
+        *t = dq->items[dq->frente];
+        dq->frente = (dq->frente + 1) % dq->capacidad;
+        dq->cantidad--;
+        ok = 1;
+    }
+    pthread_mutex_unlock(&dq->mutex);
+    return ok;
+}
+
+// Buscar trabajo: primero en la deque propia, luego robando a los demas
+static int obtener_trabajo(Pool *pool, int indice, Trabajo *t) {
+    if (deque_pop(&pool->deques[indice], t)) return 1;
+
+    // num_deques no cambia desde antes de arrancar los hilos; num_hilos sí
+    // (pool_crear lo baja si no arrancaron todos). Las deques de hilos que no
+    // arrancaron nunca reciben trabajo, así que robarles no encuentra nada
+    for (int k = 1; k < pool->num_deques; k++) {
+        int victima = (indice + k) % pool->num_deques;
+        if (deque_robar(&pool->deques[victima], t)) return 1;
+    }
+    return 0;
+}
+
+// Libera los contextos de los trabajadores [desde, hasta) que no llegaron a arrancar
+static void destruir_contextos(Pool *pool, int desde, int hasta) {
+    if (!pool->destruir_contexto) return;
+    for (int i = desde; i < hasta; i++) {
+        if (pool->trabajadores[i].contexto) pool->destruir_contexto(pool->trabajadores[i].contexto);
+    }
+}
+
+static void *bucle_trabajador(void *arg) {
+    Trabajador *tr = arg;
+    Pool *pool = tr->pool;
+    void *contexto = tr->contexto;
+
+    hilo_actual = tr->indice;
+    pool_actual = pool;
+
+    while (1) {
+        Trabajo t;
+        if (obtener_trabajo(pool, tr->indice, &t)) {
+            pthread_mutex_lock(&pool->mutex);
+            pool->disponibles--;
+            pthread_mutex_unlock(&pool->mutex);
+
+            t.funcion(t.arg, contexto);
+
+            pthread_mutex_lock(&pool->mutex);
+            if (--pool->pendientes == 0) {
+                pthread_cond_broadcast(&pool->terminado);
+            }
+            pthread_mutex_unlock(&pool->mutex);
+            continue;
+        }
+
+        // Sin trabajo: dormir hasta que se encole algo o se cierre el pool
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->disponibles <= 0 && !pool->cerrando) {
+            pthread_cond_wait(&pool->hay_trabajo, &pool->mutex);
+        }
+        if (pool->disponibles <= 0 && pool->cerrando) {
+            pthread_mutex_unlock(&pool->mutex);
+            break;
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    if (contexto && pool->destruir_contexto) pool->destruir_contexto(contexto);
+    return NULL;
+}
+
+int pool_hilos_por_defecto(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+Pool *pool_crear(int num_hilos, void *(*crear_contexto)(void), void (*destruir_contexto)(void *)) {
+    if (num_hilos <= 0) num_hilos = pool_hilos_por_defecto();
+
+    Pool *pool = calloc(1, sizeof(Pool));
+    if (!pool) return NULL;
+
+    pool->num_hilos = num_hilos;
+    pool->crear_contexto = crear_contexto;
+    pool->destruir_contexto = destruir_contexto;
+    pool->trabajadores = calloc(num_hilos, sizeof(Trabajador));
+    pool->deques = calloc(num_hilos, sizeof(Deque));
+    if (!pool->trabajadores || !pool->deques) {
+        free(pool->trabajadores);
+        free(pool->deques);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->hay_trabajo, NULL);
+    pthread_cond_init(&pool->terminado, NULL);
+
+    for (int i = 0; i < num_hilos; i++) {
+        if (deque_init(&pool->deques[i]) != 0) {
+            for (int j = 0; j < i; j++) deque_destruir(&pool->deques[j]);
+            free(pool->trabajadores);
+            free(pool->deques);
+            free(pool);
+            return NULL;
+        }
+    }
+    pool->num_deques = num_hilos;
+
+    // Los contextos se crean antes de arrancar los hilos: un trabajador sin
+    // contexto haría fallar a cada codec que le toque, así que el pool no se crea
+    for (int i = 0; crear_contexto && i < num_hilos; i++) {
+        pool->trabajadores[i].contexto = crear_contexto();
+        if (!pool->trabajadores[i].contexto) {
+            destruir_contextos(pool, 0, i);
+            pool->num_hilos = 0;
+            pool_destruir(pool);
+            return NULL;
+        }
+    }
+
+    int creados = 0;
+    for (; creados < num_hilos; creados++) {
+        pool->trabajadores[creados].pool = pool;
+        pool->trabajadores[creados].indice = creados;
+        if (pthread_create(&pool->trabajadores[creados].hilo, NULL, bucle_trabajador,
+                           &pool->trabajadores[creados]) != 0) {
+            // Continuar con los hilos que sí se pudieron crear
+            destruir_contextos(pool, creados, num_hilos);
+            break;
+        }
+    }
+    pool->num_hilos = creados;
+
+    if (pool->num_hilos == 0) {
+        pool_destruir(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+int pool_enviar_a(Pool *pool, int hilo, FuncionTrabajo funcion, void *arg) {
+    Trabajo t = { funcion, arg };
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->pendientes++;
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (deque_push(&pool->deques[hilo % pool->num_hilos], t) != 0) {
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->pendientes == 0) pthread_cond_broadcast(&pool->terminado);
+        pthread_mutex_unlock(&pool->mutex);
+        return -1;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->disponibles++;
+    pthread_cond_signal(&pool->hay_trabajo);
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+int pool_enviar(Pool *pool, FuncionTrabajo funcion, void *arg) {
+    int hilo;
+    if (pool_actual == pool) {
+        hilo = hilo_actual;
+    } else {
+        pthread_mutex_lock(&pool->mutex);
+        hilo = pool->siguiente++ % pool->num_hilos;
+        pthread_mutex_unlock(&pool->mutex);
+    }
+    return pool_enviar_a(pool, hilo, funcion, arg);
+}
+
+void pool_esperar(Pool *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->pendientes > 0) {
+        pthread_cond_wait(&pool->terminado, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void pool_destruir(Pool *pool) {
+    if (!pool) return;
+
+    pool_esperar(pool);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->cerrando = 1;
+    pthread_cond_broadcast(&pool->hay_trabajo);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i = 0; i < pool->num_hilos; i++) {
+        pthread_join(pool->trabajadores[i].hilo, NULL);
+    }
+
+    for (int i = 0; i < pool->num_deques; i++) {
+        deque_destruir(&pool->deques[i]);
+    }
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->hay_trabajo);
+    pthread_cond_destroy(&pool->terminado);
+    free(pool->trabajadores);
+    free(pool->deques);
+    free(pool);
+}
+
+int pool_num_hilos(const Pool *pool) {
+    return pool->num_hilos;
+}
+
+int pool_hilo_actual(void) {
+    return hilo_actual;
+}
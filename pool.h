@@ -0,0 +1,56 @@
+#ifndef POOL_H
+#define POOL_H
+
+/**
+ * Pool de hilos con colas dobles (deques) por trabajador y robo de trabajo.
+ *
+ * Cada hilo saca trabajos de su propia deque por el final (LIFO) y, cuando
+ * se queda sin trabajo, roba del frente de la deque de otro hilo. Cada hilo
+ * tiene ademas un contexto propio (buffers, estado de los codecs) creado con
+ * crear_contexto, de modo que los codecs no comparten estado entre hilos.
+ */
+
+typedef struct Pool Pool;
+
+// Firma de un trabajo: recibe su argumento y el contexto del hilo que lo ejecuta
+typedef void (*FuncionTrabajo)(void *arg, void *contexto);
+
+/**
+ * pool_crear - Crea un pool con num_hilos trabajadores
+ * @num_hilos: Cantidad de hilos (<= 0 usa pool_hilos_por_defecto())
+ * @crear_contexto: Crea el contexto privado de cada hilo (puede ser NULL)
+ * @destruir_contexto: Libera el contexto de cada hilo (puede ser NULL)
+ *
+ * Retorna: El pool, o NULL si hubo error (también si crear_contexto retornó NULL)
+ */
+Pool *pool_crear(int num_hilos, void *(*crear_contexto)(void), void (*destruir_contexto)(void *));
+
+/**
+ * pool_enviar - Encola un trabajo (reparte en round-robin entre los hilos)
+ *
+ * Si se llama desde un hilo del pool, el trabajo va a la deque de ese hilo.
+ * Retorna: 0 si se encoló, -1 si hubo error
+ */
+int pool_enviar(Pool *pool, FuncionTrabajo funcion, void *arg);
+
+/**
+ * pool_enviar_a - Encola un trabajo en la deque de un hilo concreto
+ */
+int pool_enviar_a(Pool *pool, int hilo, FuncionTrabajo funcion, void *arg);
+
+// Espera a que terminen todos los trabajos enviados hasta el momento
+void pool_esperar(Pool *pool);
+
+// Espera los trabajos pendientes, detiene los hilos y libera el pool
+void pool_destruir(Pool *pool);
+
+// Numero de hilos del pool
+int pool_num_hilos(const Pool *pool);
+
+// Indice del hilo del pool que ejecuta la llamada, o -1 si no es un hilo del pool
+int pool_hilo_actual(void);
+
+// Cantidad de CPUs en linea (minimo 1)
+int pool_hilos_por_defecto(void);
+
+#endif // POOL_H
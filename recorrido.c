@@ -0,0 +1,270 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "recorrido.h"
+
+#define TAM_BUFFER_DENTS (64 * 1024)
+
+// Formato de las entradas que devuelve getdents64
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+typedef struct {
+    uint64_t inodo;
+    char *nombre;
+} EntradaDir;
+
+// Directorios con descriptor abierto y tope antes de pasar a modo ruta
+static int dirs_abiertos = 0;
+static int limite_dirs_abiertos = 256;
+
+void recorrido_ampliar_limite_fds(void) {
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) != 0) return;
+
+    if (lim.rlim_cur < lim.rlim_max) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+        getrlimit(RLIMIT_NOFILE, &lim);
+    }
+
+    // Reservar la mitad para archivos, precargas y salida estándar
+    long disponibles = (long)lim.rlim_cur / 2 - 16;
+    if (disponibles < 8) disponibles = 8;
+    limite_dirs_abiertos = disponibles > 1000000 ? 1000000 : (int)disponibles;
+}
+
+static char *unir_ruta(const char *dir, const char *nombre) {
+    size_t ld = strlen(dir), ln = strlen(nombre);
+    char *ruta = malloc(ld + ln + 2);
+    if (!ruta) return NULL;
+    memcpy(ruta, dir, ld);
+    ruta[ld] = '/';
+    memcpy(ruta + ld + 1, nombre, ln + 1);
+    return ruta;
+}
+
+DirAbierto *dir_abrir(DirAbierto *padre, const char *nombre) {
+    DirAbierto *d = malloc(sizeof(DirAbierto));
+    if (!d) return NULL;
+
+    d->ruta = padre ? unir_ruta(padre->ruta, nombre) : strdup(nombre);
+    if (!d->ruta) {
+        free(d);
+        return NULL;
+    }
+
+    if (padre && padre->fd >= 0) {
+        d->fd = openat(padre->fd, nombre, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    } else {
+        d->fd = open(d->ruta, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    if (d->fd < 0) {
+        perror("openat");
+        free(d->ruta);
+        free(d);
+        return NULL;
+    }
+
+    __atomic_add_fetch(&dirs_abiertos, 1, __ATOMIC_RELAXED);
+    d->referencias = 1;
+    return d;
+}
+
+DirAbierto *dir_retener(DirAbierto *d) {
+    __atomic_add_fetch(&d->referencias, 1, __ATOMIC_RELAXED);
+    return d;
+}
+
+static void dir_cerrar_fd(DirAbierto *d) {
+    if (d->fd >= 0) {
+        close(d->fd);
+        d->fd = -1;
+        __atomic_sub_fetch(&dirs_abiertos, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void dir_soltar(DirAbierto *d) {
+    if (!d) return;
+    if (__atomic_sub_fetch(&d->referencias, 1, __ATOMIC_ACQ_REL) == 0) {
+        dir_cerrar_fd(d);
+        free(d->ruta);
+        free(d);
+    }
+}
+
+int dir_abrir_archivo(DirAbierto *d, const char *nombre, int flags, mode_t modo) {
+    if (d->fd >= 0) return openat(d->fd, nombre, flags | O_CLOEXEC, modo);
+
+    char *ruta = unir_ruta(d->ruta, nombre);
+    if (!ruta) return -1;
+    int fd = open(ruta, flags | O_CLOEXEC, modo);
+    free(ruta);
+    return fd;
+}
+
+// Lee todas las entradas del directorio con getdents64 (sin . ni ..)
+static int leer_entradas(int fd, EntradaDir **entradas, int *cantidad) {
+    char *buffer = malloc(TAM_BUFFER_DENTS);
+    if (!buffer) return -1;
+
+    int capacidad = 64;
+    *cantidad = 0;
+    *entradas = malloc(capacidad * sizeof(EntradaDir));
+    if (!*entradas) {
+        free(buffer);
+        return -1;
+    }
+
+    long leidos;
+    while ((leidos = syscall(SYS_getdents64, fd, buffer, TAM_BUFFER_DENTS)) > 0) {
+        for (long pos = 0; pos < leidos; ) {
+            struct linux_dirent64 *de = (struct linux_dirent64 *)(buffer + pos);
+            pos += de->d_reclen;
+
+            // ignorar . y ..
+            if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+                continue;
+
+            if (*cantidad >= capacidad) {
+                capacidad *= 2;
+                EntradaDir *nuevas = realloc(*entradas, capacidad * sizeof(EntradaDir));
+                if (!nuevas) {
+                    leidos = -1;
+                    break;
+                }
+                *entradas = nuevas;
+            }
+            (*entradas)[*cantidad].inodo = de->d_ino;
+            (*entradas)[*cantidad].nombre = strdup(de->d_name);
+            if ((*entradas)[*cantidad].nombre) (*cantidad)++;
+        }
+        if (leidos < 0) break;
+    }
+
+    free(buffer);
+    if (leidos < 0) {
+        perror("getdents64");
+        return -1;
+    }
+    return 0;
+}
+
+static int comparar_inodos(const void *a, const void *b) {
+    const EntradaDir *ea = a;
+    const EntradaDir *eb = b;
+    if (ea->inodo < eb->inodo) return -1;
+    if (ea->inodo > eb->inodo) return 1;
+    return 0;
+}
+
+int recorrer_directorio_fd(DirAbierto *dir_in, DirAbierto *dir_out, int actions[], const char *alg,
+                           FuncionNombreSalida nombrar, ListaTrabajos *lista) {
+    EntradaDir *entradas;
+    int cantidad;
+    int errores = 0;
+
+    if (leer_entradas(dir_in->fd, &entradas, &cantidad) != 0) return 1;
+
+    printf("[PID %d] Procesando directorio: %s -> %s\n", getpid(), dir_in->ruta, dir_out->ruta);
+
+    // Visitar en orden de inodo: mejor localidad en disco para stat y lectura
+    qsort(entradas, cantidad, sizeof(EntradaDir), comparar_inodos);
+
+    for (int i = 0; i < cantidad; i++) {
+        const char *nombre = entradas[i].nombre;
+
+        // generar nombre de salida
+        char *newName = nombrar(nombre, actions);
+        if (!newName) {
+            errores++;
+            continue;
+        }
+
+        // pre-escaneo: el tamaño alimenta el modelo de costo del planificador
+        struct stat st;
+        if (fstatat(dir_in->fd, nombre, &st, 0) != 0) {
+            perror("fstatat");
+            errores++;
+            free(newName);
+            continue;
+        }
+
+        if (S_ISDIR(st.st_mode)) {
+            if (mkdirat(dir_out->fd, newName, 0755) == -1) {
+                perror("mkdirat");
+                errores++;
+                free(newName);
+                continue;
+            }
+
+            DirAbierto *sub_in = dir_abrir(dir_in, nombre);
+            DirAbierto *sub_out = sub_in ? dir_abrir(dir_out, newName) : NULL;
+            if (sub_in && sub_out) {
+                errores += recorrer_directorio_fd(sub_in, sub_out, actions, alg, nombrar, lista);
+            } else {
+                errores++;
+            }
+            dir_soltar(sub_in);
+            dir_soltar(sub_out);
+        } else if (S_ISREG(st.st_mode)) {
+            char *entrada = unir_ruta(dir_in->ruta, nombre);
+            char *salida = unir_ruta(dir_out->ruta, newName);
+            TrabajoArchivo *t = NULL;
+            if (entrada && salida) {
+                t = agregar_trabajo(lista, entrada, salida, st.st_size, actions, alg);
+            }
+            if (t) {
+                t->dir_in = dir_retener(dir_in);
+                t->dir_out = dir_retener(dir_out);
+                t->nombre_in = t->entrada + strlen(dir_in->ruta) + 1;
+                t->nombre_out = t->salida + strlen(dir_out->ruta) + 1;
+            } else {
+                errores++;
+            }
+            free(entrada);
+            free(salida);
+        }
+
+        free(newName);
+    }
+
+    for (int i = 0; i < cantidad; i++) free(entradas[i].nombre);
+    free(entradas);
+
+    // Si hay demasiados directorios abiertos, los trabajos de este usarán la ruta
+    if (__atomic_load_n(&dirs_abiertos, __ATOMIC_RELAXED) > limite_dirs_abiertos) {
+        dir_cerrar_fd(dir_in);
+        dir_cerrar_fd(dir_out);
+    }
+
+    return errores;
+}
+
+void trabajo_precargar(TrabajoArchivo *t) {
+    if (t->fd_in >= 0 || !t->dir_in) return;
+
+    t->fd_in = dir_abrir_archivo(t->dir_in, t->nombre_in, O_RDONLY, 0);
+    if (t->fd_in >= 0) {
+        posix_fadvise(t->fd_in, 0, 0, POSIX_FADV_WILLNEED);
+    }
+}
+
+void trabajo_soltar_dirs(TrabajoArchivo *t) {
+    dir_soltar(t->dir_in);
+    dir_soltar(t->dir_out);
+    t->dir_in = NULL;
+    t->dir_out = NULL;
+}
@@ -0,0 +1,54 @@
+#ifndef RECORRIDO_H
+#define RECORRIDO_H
+
+#include <sys/types.h>
+#include "planificador.h"
+
+/**
+ * Recorrido de directorios relativo a descriptores.
+ *
+ * Cada directorio se mantiene abierto mientras lo usen el recorrido o algún
+ * trabajo, y todo se resuelve con openat/fstatat/mkdirat relativo a él, así
+ * el kernel no vuelve a resolver la ruta completa en cada archivo. Las
+ * entradas se leen en bloque con getdents64 y se visitan en orden de inodo.
+ */
+
+typedef struct DirAbierto {
+    int fd;             // descriptor del directorio (-1: se usa la ruta)
+    char *ruta;         // ruta completa, para mensajes y como respaldo
+    int referencias;
+} DirAbierto;
+
+// Genera el nombre de salida de una entrada (memoria dinámica)
+typedef char *(*FuncionNombreSalida)(const char *nombre, int actions[]);
+
+// Sube el límite blando de descriptores al máximo permitido
+void recorrido_ampliar_limite_fds(void);
+
+/**
+ * dir_abrir - Abre un directorio por ruta (padre == NULL) o relativo a padre
+ * Retorna: el directorio con una referencia, o NULL si hubo error
+ */
+DirAbierto *dir_abrir(DirAbierto *padre, const char *nombre);
+DirAbierto *dir_retener(DirAbierto *d);
+void dir_soltar(DirAbierto *d);
+
+// openat relativo al directorio (o por ruta si no tiene descriptor)
+int dir_abrir_archivo(DirAbierto *d, const char *nombre, int flags, mode_t modo);
+
+/**
+ * recorrer_directorio_fd - Recorre dir_in creando los subdirectorios de salida
+ * en dir_out y agregando a lista un trabajo por cada archivo regular
+ *
+ * Retorna: cantidad de errores encontrados
+ */
+int recorrer_directorio_fd(DirAbierto *dir_in, DirAbierto *dir_out, int actions[], const char *alg,
+                           FuncionNombreSalida nombrar, ListaTrabajos *lista);
+
+// Abre la entrada de t por adelantado y pide al kernel que la lea (WILLNEED)
+void trabajo_precargar(TrabajoArchivo *t);
+
+// Suelta los directorios que retiene t
+void trabajo_soltar_dirs(TrabajoArchivo *t);
+
+#endif // RECORRIDO_H
@@ -1,14 +1,130 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "rle.h"
+#include "pool.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * medir_corrida - Cuántos bytes desde p son iguales a p[0], hasta max
+ *
+ * Compara de a 32 (AVX2) o 16 bytes (SSE2) contra p[0] repetido; el primer
+ * byte distinto es el primer bit en 0 de la máscara de comparación.
+ */
+static inline int medir_corrida(const unsigned char *p, int max) {
+    int n = 0;
+#if defined(__AVX2__)
+    __m256i valor = _mm256_set1_epi8((char)p[0]);
+    for (; n + 32 <= max; n += 32) {
+        __m256i bloque = _mm256_loadu_si256((const __m256i *)(p + n));
+        unsigned int distintos = ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bloque, valor));
+        if (distintos) return n + __builtin_ctz(distintos);
+    }
+#elif defined(__SSE2__)
+    __m128i valor = _mm_set1_epi8((char)p[0]);
+    for (; n + 16 <= max; n += 16) {
+        __m128i bloque = _mm_loadu_si128((const __m128i *)(p + n));
+        unsigned int distintos = ~(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(bloque, valor)) & 0xFFFF;
+        if (distintos) return n + __builtin_ctz(distintos);
+    }
+#endif
+    while (n < max && p[n] == p[0]) n++;
+    return n;
+}
+
+/**
+ * medir_atras - Cuántos bytes antes de fin son iguales a fin[-1], hasta max
+ * El mismo recorrido que medir_corrida, hacia atrás.
+ */
+static inline size_t medir_atras(const unsigned char *fin, size_t max) {
+    size_t n = 0;
+#if defined(__AVX2__)
+    __m256i valor = _mm256_set1_epi8((char)fin[-1]);
+    for (; n + 32 <= max; n += 32) {
+        __m256i bloque = _mm256_loadu_si256((const __m256i *)(fin - n - 32));
+        unsigned int distintos = ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bloque, valor));
+        if (distintos) return n + __builtin_clz(distintos);
+    }
+#elif defined(__SSE2__)
+    __m128i valor = _mm_set1_epi8((char)fin[-1]);
+    for (; n + 16 <= max; n += 16) {
+        __m128i bloque = _mm_loadu_si128((const __m128i *)(fin - n - 16));
+        unsigned int distintos = ~(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(bloque, valor)) & 0xFFFF;
+        if (distintos) return n + __builtin_clz(distintos) - 16;
+    }
+#endif
+    while (n < max && fin[-1 - (ptrdiff_t)n] == fin[-1]) n++;
+    return n;
+}
+
+/**
+ * buscar_corrida - Dónde empieza la primera corrida de RLE2_CORRIDA_MIN
+ * bytes iguales en p, o n si no hay ninguna
+ *
+ * Para saltar los literales de a 32 o 16: compara cada posición con las dos
+ * siguientes en tres cargas desplazadas.
+ */
+static inline size_t buscar_corrida(const unsigned char *p, size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 34 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(p + i + 1));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(p + i + 2));
+        unsigned int iguales = (unsigned int)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, b), _mm256_cmpeq_epi8(b, c)));
+        if (iguales) return i + __builtin_ctz(iguales);
+    }
+#elif defined(__SSE2__)
+    for (; i + 18 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(p + i + 1));
+        __m128i c = _mm_loadu_si128((const __m128i *)(p + i + 2));
+        unsigned int iguales = (unsigned int)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, b), _mm_cmpeq_epi8(b, c)));
+        if (iguales) return i + __builtin_ctz(iguales);
+    }
+#endif
+    for (; i + 2 < n; i++) {
+        if (p[i] == p[i + 1] && p[i] == p[i + 2]) return i;
+    }
+    return n;
+}
+
+/**
+ * expandir_corrida - count copias de valor en out
+ * Con espacio de sobra escribe vectores completos (puede pasarse hasta 15 o
+ * 31 bytes de count, nunca de espacio); si no, memset.
+ */
+static inline void expandir_corrida(unsigned char *out, unsigned char valor, size_t count, size_t espacio) {
+#if defined(__AVX2__)
+    if (espacio >= ((count + 31) & ~(size_t)31)) {
+        __m256i v = _mm256_set1_epi8((char)valor);
+        for (size_t k = 0; k < count; k += 32) _mm256_storeu_si256((__m256i *)(out + k), v);
+        return;
+    }
+#elif defined(__SSE2__)
+    if (espacio >= ((count + 15) & ~(size_t)15)) {
+        __m128i v = _mm_set1_epi8((char)valor);
+        for (size_t k = 0; k < count; k += 16) _mm_storeu_si128((__m128i *)(out + k), v);
+        return;
+    }
+#endif
+    memset(out, valor, count);
+}
+
 int comprimir_rle(const unsigned char *in_buf, int in_size, unsigned char *out_buf) {
     int i = 0, j = 0;
 
     while (i < in_size) {
         unsigned char current = in_buf[i];
-        int count = 1;
 
         // Contar repeticiones
-        while (i + count < in_size && in_buf[i + count] == current && count < 255) {
-            count++;
-        }
+        int restante = in_size - i;
+        int count = medir_corrida(in_buf + i, restante < RLE_MAX_COUNT ? restante : RLE_MAX_COUNT);
 
         // Guardar (count, byte)
         out_buf[j++] = (unsigned char)count;
@@ -39,11 +155,555 @@ int descomprimir_rle(unsigned char *in_buf, int in_size, unsigned char *out_buf)
             count = 8192 - j;
         }
         
-        for(int k = 0; k < count; k++){
-            out_buf[j++] = value;
-        }
+        expandir_corrida(out_buf + j, value, count, RLE_BUFFER_OUT - j);
+        j += count;
         
         i += 2;
     }
     return j;
-}
\ No newline at end of file
+}
+
+const unsigned char RLE2_MAGIA[RLE2_TAM_MAGIA] = { 0x00, 'R', 'L', 0x02 };
+
+enum { FASE_TOKEN, FASE_LITERALES, FASE_VALOR, FASE_CORRIDA };
+
+size_t rle2_cota(size_t n) {
+    // Un paquete literal cuesta a lo sumo 1 byte cada 64 más su varint; el
+    // resto es la magia, los bytes pendientes del trozo anterior y una corrida
+    return n + n / 64 + 32;
+}
+
+static size_t escribir_varint(unsigned char *out, unsigned long long v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (unsigned char)v;
+    return n;
+}
+
+// Un paquete literal: previos copias de valor (lo que quedó del trozo anterior) y n bytes
+static size_t escribir_literales(unsigned char *out, unsigned char valor, size_t previos,
+                                 const unsigned char *literales, size_t n) {
+    if (previos + n == 0) return 0;
+    size_t j = escribir_varint(out, (unsigned long long)(previos + n - 1) << 1);
+    memset(out + j, valor, previos);
+    if (n > 0) memcpy(out + j + previos, literales, n);
+    return j + previos + n;
+}
+
+static size_t escribir_corrida(unsigned char *out, unsigned char valor, unsigned long long count) {
+    size_t j = escribir_varint(out, (count - RLE2_CORRIDA_MIN) << 1 | 1);
+    out[j++] = valor;
+    return j;
+}
+
+void rle_codificador_init(CodificadorRLE *c) {
+    memset(c, 0, sizeof(*c));
+}
+
+/**
+ * Al final de cada trozo quedan sin escribir los últimos bytes iguales (una
+ * corrida, o uno o dos que podrían empezarla): el trozo siguiente decide si
+ * la corrida sigue o si van como literales.
+ */
+size_t rle_codificar(CodificadorRLE *c, const unsigned char *in_buf, size_t in_size, unsigned char *out_buf) {
+    size_t i = 0, j = 0;
+    if (!c->iniciado) {
+        memcpy(out_buf, RLE2_MAGIA, RLE2_TAM_MAGIA);
+        j = RLE2_TAM_MAGIA;
+        c->iniciado = 1;
+    }
+    if (in_size == 0) return j;
+
+    // La corrida pendiente sigue mientras el trozo empiece con su valor
+    unsigned char valor_previo = c->valor;
+    size_t previos = 0;
+    if (c->corrida) {
+        size_t k = 0;
+        while (k < in_size && in_buf[k] == c->valor) {
+            size_t restante = in_size - k;
+            k += medir_corrida(in_buf + k, restante < INT_MAX ? (int)restante : INT_MAX);
+        }
+        c->corrida += k;
+        if (k == in_size) return j;
+
+        // Más corta que RLE2_CORRIDA_MIN: abre el paquete literal de este trozo
+        if (c->corrida >= RLE2_CORRIDA_MIN) j += escribir_corrida(out_buf + j, c->valor, c->corrida);
+        else previos = c->corrida;
+        c->corrida = 0;
+        i = k;
+    }
+
+    size_t inicio_literales = i;
+    while (i < in_size) {
+        i += buscar_corrida(in_buf + i, in_size - i);
+        if (i == in_size) break;
+
+        // medir_corrida mide de a int: una corrida más larga se parte
+        size_t restante = in_size - i;
+        size_t count = medir_corrida(in_buf + i, restante < INT_MAX ? (int)restante : INT_MAX);
+
+        j += escribir_literales(out_buf + j, valor_previo, previos, in_buf + inicio_literales, i - inicio_literales);
+        previos = 0;
+        if (i + count == in_size) {
+            c->valor = in_buf[i];
+            c->corrida = count;
+            return j;
+        }
+        j += escribir_corrida(out_buf + j, in_buf[i], count);
+        i += count;
+        inicio_literales = i;
+    }
+
+    // Sin corrida al final: quedan pendientes el último byte y el anterior si es igual
+    size_t cola = 0;
+    if (in_size > inicio_literales) {
+        cola = 1;
+        if (in_size - inicio_literales >= 2 && in_buf[in_size - 2] == in_buf[in_size - 1]) cola = 2;
+        c->valor = in_buf[in_size - 1];
+        c->corrida = cola;
+    }
+    j += escribir_literales(out_buf + j, valor_previo, previos, in_buf + inicio_literales,
+                            in_size - cola - inicio_literales);
+    return j;
+}
+
+size_t rle_codificador_terminar(CodificadorRLE *c, unsigned char *out_buf) {
+    size_t j = 0;
+    if (!c->iniciado) {
+        memcpy(out_buf, RLE2_MAGIA, RLE2_TAM_MAGIA);
+        j = RLE2_TAM_MAGIA;
+        c->iniciado = 1;
+    }
+    if (c->corrida >= RLE2_CORRIDA_MIN) j += escribir_corrida(out_buf + j, c->valor, c->corrida);
+    else j += escribir_literales(out_buf + j, c->valor, c->corrida, NULL, 0);
+    c->corrida = 0;
+    return j;
+}
+
+void rle_decodificador_init(DecodificadorRLE *d) {
+    memset(d, 0, sizeof(*d));
+    d->fase = FASE_TOKEN;
+}
+
+/**
+ * Los dos formatos comparten las fases: un par (count, byte) es un token de
+ * un byte sin varint seguido del valor de la corrida.
+ */
+int rle_decodificar(DecodificadorRLE *d, const unsigned char *in_buf, size_t in_size, size_t *consumido,
+                    unsigned char *out_buf, size_t capacidad, size_t *producido) {
+    size_t i = 0, j = 0;
+    int resultado = 0;
+
+    while (j < capacidad && resultado == 0) {
+        if (d->fase == FASE_CORRIDA) {
+            size_t k = d->pendiente < capacidad - j ? d->pendiente : capacidad - j;
+            expandir_corrida(out_buf + j, d->valor, k, capacidad - j);
+            j += k;
+            d->pendiente -= k;
+            if (d->pendiente == 0) d->fase = FASE_TOKEN;
+            continue;
+        }
+        if (i == in_size) break;
+
+        if (d->formato == 0) d->formato = in_buf[i] == 0 ? 2 : 1;
+        if (d->formato == 2 && d->n_magia < RLE2_TAM_MAGIA) {
+            if (in_buf[i++] != RLE2_MAGIA[d->n_magia++]) resultado = -1;
+            continue;
+        }
+
+        if (d->fase == FASE_TOKEN) {
+            unsigned char b = in_buf[i++];
+            if (d->formato == 1) {
+                d->pendiente = b;
+                d->fase = FASE_VALOR;
+                continue;
+            }
+            if (d->bits > 56) {
+                resultado = -1;     // más de 63 bits
+                break;
+            }
+            d->token |= (unsigned long long)(b & 0x7F) << d->bits;
+            d->bits += 7;
+            if (b & 0x80) continue;
+
+            if (d->token & 1) {
+                d->pendiente = (d->token >> 1) + RLE2_CORRIDA_MIN;
+                d->fase = FASE_VALOR;
+            } else {
+                d->pendiente = (d->token >> 1) + 1;
+                d->fase = FASE_LITERALES;
+            }
+            d->token = 0;
+            d->bits = 0;
+        } else if (d->fase == FASE_VALOR) {
+            d->valor = in_buf[i++];
+            d->fase = FASE_CORRIDA;
+        } else {
+            size_t k = d->pendiente;
+            if (k > in_size - i) k = in_size - i;
+            if (k > capacidad - j) k = capacidad - j;
+            memcpy(out_buf + j, in_buf + i, k);
+            i += k;
+            j += k;
+            d->pendiente -= k;
+            if (d->pendiente == 0) d->fase = FASE_TOKEN;
+        }
+    }
+
+    *consumido = i;
+    *producido = j;
+    return resultado;
+}
+
+int rle_decodificador_completo(const DecodificadorRLE *d) {
+    if (d->formato == 2 && d->n_magia < RLE2_TAM_MAGIA) return 0;
+    return d->fase == FASE_TOKEN && d->bits == 0;
+}
+
+/*
+ * ------------------------------------------------------------------
+ * Variantes en paralelo
+ * ------------------------------------------------------------------
+ */
+
+// Pool para los trozos de un archivo (NULL si basta con el hilo actual)
+static Pool *crear_pool_trozos(int hilos, size_t num_trozos) {
+    if (hilos <= 1 || num_trozos <= 1) return NULL;
+    return pool_crear((size_t)hilos < num_trozos ? hilos : (int)num_trozos, NULL, NULL);
+}
+
+// Ejecuta k trabajos: en el pool si hay uno, si no en el hilo actual
+static void ejecutar_trozos(Pool *pool, FuncionTrabajo funcion, void *trabajos, size_t tam, size_t k) {
+    for (size_t i = 0; i < k; i++) {
+        void *t = (char *)trabajos + i * tam;
+        if (!pool || pool_enviar(pool, funcion, t) != 0) funcion(t, NULL);
+    }
+    if (pool) pool_esperar(pool);
+}
+
+/**
+ * rle_codificador_desde - Estado del codificador después de datos[0..pos)
+ *
+ * Lo único que queda pendiente al final de un trozo son los últimos bytes
+ * iguales: una corrida, o uno o dos que podrían empezarla. Se miden hacia
+ * atrás desde pos.
+ */
+static void rle_codificador_desde(CodificadorRLE *c, const unsigned char *datos, size_t pos) {
+    rle_codificador_init(c);
+    if (pos == 0) return;
+    c->iniciado = 1;
+    c->valor = datos[pos - 1];
+    c->corrida = medir_atras(datos + pos, pos);
+}
+
+typedef struct {
+    const unsigned char *datos;
+    size_t inicio, n;
+    unsigned char *salida;
+    size_t n_salida;
+} TrozoCodificar;
+
+static void trabajo_codificar(void *arg, void *contexto) {
+    (void)contexto;
+    TrozoCodificar *t = arg;
+    const unsigned char *in = t->datos + t->inicio;
+
+    // Un trozo que sigue la corrida del anterior de punta a punta no escribe
+    // nada: la corrida la escribe el trozo donde termina
+    if (t->inicio > 0 && in[0] == in[-1] && medir_atras(in + t->n, t->n) == t->n) {
+        t->n_salida = 0;
+        return;
+    }
+
+    CodificadorRLE c;
+    rle_codificador_desde(&c, t->datos, t->inicio);
+    t->n_salida = rle_codificar(&c, in, t->n, t->salida);
+}
+
+int comprimir_rle_paralelo(int hilos, const unsigned char *entrada, size_t n,
+                           EscrituraRLE escribir, void *destino) {
+    size_t num_trozos = (n + RLE_TAM_TROZO - 1) / RLE_TAM_TROZO;
+    size_t ventana = hilos > 1 ? 2 * (size_t)hilos : 1;
+    if (ventana > num_trozos) ventana = num_trozos > 0 ? num_trozos : 1;
+
+    TrozoCodificar *trozos = calloc(ventana, sizeof(TrozoCodificar));
+    unsigned char *salida = malloc(ventana * rle2_cota(RLE_TAM_TROZO));
+    if (!trozos || !salida) {
+        free(trozos);
+        free(salida);
+        return -1;
+    }
+
+    Pool *pool = crear_pool_trozos(hilos, num_trozos);
+    int resultado = 0;
+    for (size_t primero = 0; primero < num_trozos && resultado == 0; primero += ventana) {
+        size_t k = num_trozos - primero < ventana ? num_trozos - primero : ventana;
+        for (size_t i = 0; i < k; i++) {
+            TrozoCodificar *t = &trozos[i];
+            t->datos = entrada;
+            t->inicio = (primero + i) * RLE_TAM_TROZO;
+            t->n = n - t->inicio < RLE_TAM_TROZO ? n - t->inicio : RLE_TAM_TROZO;
+            t->salida = salida + i * rle2_cota(RLE_TAM_TROZO);
+        }
+        ejecutar_trozos(pool, trabajo_codificar, trozos, sizeof(TrozoCodificar), k);
+        for (size_t i = 0; i < k && resultado == 0; i++) {
+            resultado = escribir(destino, trozos[i].salida, trozos[i].n_salida);
+        }
+    }
+
+    // La corrida del final (o la magia de una entrada vacía)
+    if (resultado == 0) {
+        CodificadorRLE c;
+        rle_codificador_desde(&c, entrada, n);
+        resultado = escribir(destino, salida, rle_codificador_terminar(&c, salida));
+    }
+
+    if (pool) pool_destruir(pool);
+    free(salida);
+    free(trozos);
+    return resultado;
+}
+
+// Lo más que escribe un tramo de la descompresión, salvo una sola corrida más larga
+#define TAM_TRAMO_SALIDA    (4 * RLE_TAM_TROZO)
+
+/**
+ * Formato 2: los paquetes no se pueden ubicar desde un byte cualquiera, así
+ * que los tramos se cortan recorriendo solo los encabezados (los literales
+ * se saltan sin leerlos). capacidad es lo reservado en plan->entrada y
+ * plan->salida: hacen falta num + 1 lugares. Retorna: 0, o -1 si los datos
+ * no son válidos
+ */
+static int planificar_paquetes(PlanRLE *plan, const unsigned char *in, size_t n, size_t corte,
+                               size_t tope_salida, size_t capacidad) {
+    size_t i = RLE2_TAM_MAGIA, producido = 0, tramo = 0;
+    plan->entrada[0] = i;
+    plan->salida[0] = 0;
+    while (i < n) {
+        unsigned long long token = 0;
+        int bits = 0;
+        unsigned char b;
+        do {
+            if (i == n || bits > 56) return -1;
+            b = in[i++];
+            token |= (unsigned long long)(b & 0x7F) << bits;
+            bits += 7;
+        } while (b & 0x80);
+
+        unsigned long long count = token & 1 ? (token >> 1) + RLE2_CORRIDA_MIN : (token >> 1) + 1;
+        size_t largo = token & 1 ? 1 : count;
+        if (largo > n - i || count > (size_t)-1 - producido) return -1;
+        i += largo;
+        producido += count;
+
+        // Un tramo se corta por lo que lee o por lo que escribe: unos pocos
+        // bytes de corridas largas pueden ser megabytes de salida
+        if ((i - plan->entrada[tramo] >= corte || producido - plan->salida[tramo] >= tope_salida) && i < n) {
+            // El tramo nuevo y el cierre en plan->num = tramo + 2
+            if (tramo + 3 > capacidad) {
+                capacidad *= 2;
+                size_t *entrada = realloc(plan->entrada, capacidad * sizeof(size_t));
+                if (entrada) plan->entrada = entrada;
+                size_t *salida = realloc(plan->salida, capacidad * sizeof(size_t));
+                if (salida) plan->salida = salida;
+                if (!entrada || !salida) return -1;
+            }
+            tramo++;
+            plan->entrada[tramo] = i;
+            plan->salida[tramo] = producido;
+        }
+    }
+    plan->num = tramo + 1;
+    plan->entrada[plan->num] = n;
+    plan->salida[plan->num] = producido;
+    return 0;
+}
+
+typedef struct {
+    const PlanRLE *plan;
+    const unsigned char *entrada;
+    unsigned char *salida;
+    size_t tramo;
+    size_t total;
+    int resultado;
+} TramoRLE;
+
+// Pares (count, byte): lo que produce el tramo es la suma de sus count
+static void trabajo_contar_pares(void *arg, void *contexto) {
+    (void)contexto;
+    TramoRLE *t = arg;
+    const unsigned char *in = t->entrada + t->plan->entrada[t->tramo];
+    size_t n = t->plan->entrada[t->tramo + 1] - t->plan->entrada[t->tramo];
+    size_t total = 0;
+    for (size_t i = 0; i < n; i += 2) total += in[i];
+    t->total = total;
+}
+
+static void trabajo_descomprimir(void *arg, void *contexto) {
+    (void)contexto;
+    TramoRLE *t = arg;
+    const PlanRLE *plan = t->plan;
+    size_t a = plan->entrada[t->tramo], n = plan->entrada[t->tramo + 1] - a;
+    size_t capacidad = plan->salida[t->tramo + 1] - plan->salida[t->tramo];
+
+    DecodificadorRLE d;
+    rle_decodificador_init(&d);
+    d.formato = plan->formato;
+    d.n_magia = RLE2_TAM_MAGIA;
+
+    size_t consumido = 0, producido = 0;
+    t->resultado = 0;
+    if (capacidad > 0 && (rle_decodificar(&d, t->entrada + a, n, &consumido, t->salida + plan->salida[t->tramo],
+                                          capacidad, &producido) != 0 ||
+                          producido != capacidad || !rle_decodificador_completo(&d))) {
+        t->resultado = -1;
+    }
+    // Con la salida llena solo pueden quedar pares con count 0
+    for (size_t i = consumido; i < n && t->resultado == 0; i++) {
+        if (plan->formato != 1 || ((i - consumido) % 2 == 0 && t->entrada[a + i] != 0)) t->resultado = -1;
+    }
+}
+
+int rle_planificar(PlanRLE *plan, int hilos, const unsigned char *entrada, size_t n) {
+    memset(plan, 0, sizeof(*plan));
+    size_t partes = hilos > 1 ? 4 * (size_t)hilos : 1;
+    plan->entrada = malloc((partes + 1) * sizeof(size_t));
+    plan->salida = malloc((partes + 1) * sizeof(size_t));
+    if (!plan->entrada || !plan->salida) {
+        rle_liberar_plan(plan);
+        return -1;
+    }
+
+    if (n == 0) {
+        plan->entrada[0] = plan->salida[0] = 0;
+        return 0;
+    }
+
+    if (entrada[0] == 0) {
+        plan->formato = 2;
+        if (n < RLE2_TAM_MAGIA || memcmp(entrada, RLE2_MAGIA, RLE2_TAM_MAGIA) != 0) return -1;
+        size_t corte = (n - RLE2_TAM_MAGIA) / partes + 1;
+        return planificar_paquetes(plan, entrada, n, corte, TAM_TRAMO_SALIDA, partes + 1);
+    }
+
+    // Pares: todos miden 2 bytes, así que cada hilo suma los count de su
+    // tramo y la suma prefija de esos totales dice dónde escribe cada uno
+    plan->formato = 1;
+    if (n % 2 != 0) return -1;
+    size_t pares = n / 2;
+    if (partes > pares) partes = pares;
+    plan->num = partes;
+    for (size_t i = 0; i <= partes; i++) plan->entrada[i] = 2 * (pares * i / partes);
+
+    TramoRLE *tramos = calloc(partes, sizeof(TramoRLE));
+    if (!tramos) return -1;
+    for (size_t i = 0; i < partes; i++) {
+        tramos[i].plan = plan;
+        tramos[i].entrada = entrada;
+        tramos[i].tramo = i;
+    }
+    Pool *pool = crear_pool_trozos(hilos, partes);
+    ejecutar_trozos(pool, trabajo_contar_pares, tramos, sizeof(TramoRLE), partes);
+    if (pool) pool_destruir(pool);
+
+    plan->salida[0] = 0;
+    for (size_t i = 0; i < partes; i++) plan->salida[i + 1] = plan->salida[i] + tramos[i].total;
+    free(tramos);
+    return 0;
+}
+
+int rle_descomprimir_plan(const PlanRLE *plan, int hilos, const unsigned char *entrada, unsigned char *salida) {
+    if (plan->num == 0) return 0;
+    TramoRLE *tramos = calloc(plan->num, sizeof(TramoRLE));
+    if (!tramos) return -1;
+    for (size_t i = 0; i < plan->num; i++) {
+        tramos[i].plan = plan;
+        tramos[i].entrada = entrada;
+        tramos[i].salida = salida;
+        tramos[i].tramo = i;
+    }
+    Pool *pool = crear_pool_trozos(hilos, plan->num);
+    ejecutar_trozos(pool, trabajo_descomprimir, tramos, sizeof(TramoRLE), plan->num);
+    if (pool) pool_destruir(pool);
+
+    int resultado = 0;
+    for (size_t i = 0; i < plan->num; i++) {
+        if (tramos[i].resultado != 0) resultado = -1;
+    }
+    free(tramos);
+    return resultado;
+}
+
+void rle_liberar_plan(PlanRLE *plan) {
+    free(plan->entrada);
+    free(plan->salida);
+    plan->entrada = plan->salida = NULL;
+}
+
+/**
+ * rle_verificar - Cortes de formato 2 por tamaño de salida
+ *
+ * Corridas separadas por literales, con un tope de salida chico para que
+ * cada corrida corte un tramo. Se prueba con cada capacidad inicial hasta
+ * la cantidad de tramos (la que queda justa no se agranda): el lugar de más
+ * tiene que seguir intacto y la descompresión en paralelo tiene que dar lo
+ * mismo que los datos originales.
+ */
+int rle_verificar(void) {
+    enum { SEGMENTOS = 24, LITERALES = 37, CORRIDA = 1000, TOPE = 512 };
+    size_t n = SEGMENTOS * (LITERALES + CORRIDA);
+    unsigned char *datos = malloc(n);
+    unsigned char *comprimido = malloc(rle2_cota(n));
+    unsigned char *salida = malloc(n);
+    int resultado = datos && comprimido && salida ? 0 : -1;
+
+    size_t m = 0;
+    if (resultado == 0) {
+        for (size_t i = 0; i < n; i++) {
+            size_t k = i % (LITERALES + CORRIDA);
+            datos[i] = k < LITERALES ? (unsigned char)(i * 7 + k) : (unsigned char)(i / (LITERALES + CORRIDA));
+        }
+        CodificadorRLE c;
+        rle_codificador_init(&c);
+        m = rle_codificar(&c, datos, n, comprimido);
+        m += rle_codificador_terminar(&c, comprimido + m);
+    }
+
+    for (size_t capacidad = 2; capacidad <= SEGMENTOS + 2 && resultado == 0; capacidad++) {
+        const size_t centinela = (size_t)-1;
+        PlanRLE plan;
+        memset(&plan, 0, sizeof(plan));
+        plan.formato = 2;
+        plan.entrada = malloc((capacidad + 1) * sizeof(size_t));
+        plan.salida = malloc((capacidad + 1) * sizeof(size_t));
+        if (!plan.entrada || !plan.salida) {
+            rle_liberar_plan(&plan);
+            resultado = -1;
+            break;
+        }
+        size_t *entrada = plan.entrada, *salida_plan = plan.salida;
+        entrada[capacidad] = salida_plan[capacidad] = centinela;
+
+        if (planificar_paquetes(&plan, comprimido, m, m, TOPE, capacidad) != 0 ||
+            plan.num < SEGMENTOS || plan.salida[plan.num] != n) {
+            resultado = -1;
+        } else if (plan.entrada == entrada && plan.salida == salida_plan &&
+                   (entrada[capacidad] != centinela || salida_plan[capacidad] != centinela)) {
+            resultado = -1;
+        } else {
+            memset(salida, 0, n);
+            if (rle_descomprimir_plan(&plan, 4, comprimido, salida) != 0 || memcmp(salida, datos, n) != 0) {
+                resultado = -1;
+            }
+        }
+        rle_liberar_plan(&plan);
+    }
+
+    free(datos);
+    free(comprimido);
+    free(salida);
+    return resultado;
+}
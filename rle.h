@@ -18,6 +18,7 @@
  * 
  * Descripción: Codifica secuencias repetidas de bytes como pares (count, byte)
  * Ejemplo: "AAAABBC" -> [0x04, 'A', 0x02, 'B', 0x01, 'C']
+ * Los archivos nuevos usan el formato 2; este queda para leer los viejos.
  */
 int comprimir_rle(const unsigned char *in_buf, int in_size, unsigned char *out_buf);
 
@@ -34,4 +35,125 @@ int comprimir_rle(const unsigned char *in_buf, int in_size, unsigned char *out_b
  */
 int descomprimir_rle(unsigned char *in_buf, int in_size, unsigned char *out_buf);
 
+/**
+ * Formato 2 (estilo PackBits): [magia "\0RL\x02"] y después paquetes
+ *   [varint t] con t par: (t >> 1) + 1 literales copiados tal cual
+ *   [varint t] con t impar: un byte repetido (t >> 1) + RLE2_CORRIDA_MIN veces
+ * Los varint son de 7 bits por byte, el bit alto indica que sigue otro. El
+ * primer byte del formato de pares nunca es 0 (count >= 1), así que la magia
+ * los distingue.
+ */
+#define RLE2_TAM_MAGIA      4
+#define RLE2_CORRIDA_MIN    3
+
+extern const unsigned char RLE2_MAGIA[RLE2_TAM_MAGIA];
+
+/**
+ * API por flujo: el estado guarda lo que queda a medias entre una llamada y
+ * la siguiente, así que los trozos pueden tener cualquier tamaño y cortarse
+ * en cualquier byte. Los codecs leen de a RLE_TAM_TROZO.
+ */
+#define RLE_TAM_TROZO       (1024 * 1024)
+#define RLE_TAM_SALIDA      (RLE_TAM_TROZO + RLE_TAM_TROZO / 64 + 32)     // rle2_cota(RLE_TAM_TROZO)
+
+// Lo más que escribe rle_codificar con n bytes de entrada
+size_t rle2_cota(size_t n);
+
+// Corrida al final de lo ya visto, que puede seguir en el trozo siguiente
+typedef struct {
+    int iniciado;               // ya se escribió la magia
+    unsigned char valor;
+    unsigned long long corrida; // 0: ninguna
+} CodificadorRLE;
+
+void rle_codificador_init(CodificadorRLE *c);
+
+/**
+ * rle_codificar - Comprime el trozo siguiente al formato 2
+ * @out_buf: al menos rle2_cota(in_size) bytes
+ *
+ * Retorna: bytes escritos en out_buf (la magia va con el primer trozo)
+ */
+size_t rle_codificar(CodificadorRLE *c, const unsigned char *in_buf, size_t in_size, unsigned char *out_buf);
+
+/**
+ * rle_codificador_terminar - Escribe la corrida pendiente
+ * @out_buf: al menos rle2_cota(0) bytes
+ */
+size_t rle_codificador_terminar(CodificadorRLE *c, unsigned char *out_buf);
+
+// Formato, paquete o par a medio leer entre una llamada y la siguiente
+typedef struct {
+    int formato;                // 0: sin ver el primer byte, 1: pares, 2: paquetes
+    int n_magia;
+    int fase;
+    unsigned long long token;   // varint parcial
+    int bits;
+    unsigned long long pendiente;   // bytes del paquete que faltan en la salida
+    unsigned char valor;
+} DecodificadorRLE;
+
+void rle_decodificador_init(DecodificadorRLE *d);
+
+/**
+ * rle_decodificar - Descomprime el trozo siguiente, en cualquiera de los formatos
+ *
+ * Consume entrada hasta agotarla o hasta llenar out_buf; si una corrida no
+ * entra, sigue en la próxima llamada (aunque esa no traiga entrada).
+ * Retorna: 0, o -1 si los datos no son válidos
+ */
+int rle_decodificar(DecodificadorRLE *d, const unsigned char *in_buf, size_t in_size, size_t *consumido,
+                    unsigned char *out_buf, size_t capacidad, size_t *producido);
+
+// Retorna: 1 si la entrada terminó en el límite de un paquete o par
+int rle_decodificador_completo(const DecodificadorRLE *d);
+
+/**
+ * Variantes en paralelo sobre un archivo completo en memoria (--io=mmap).
+ *
+ * Compresión: cada trozo de RLE_TAM_TROZO arranca con el estado que el
+ * codificador tendría al llegar ahí (la corrida que viene de antes se mide
+ * hacia atrás), así que los hilos no dependen entre sí y el resultado es el
+ * mismo que en secuencia.
+ *
+ * Descompresión: primero se mide cuánto produce cada tramo de la entrada y
+ * la suma prefija da dónde empieza cada uno en la salida; después los hilos
+ * llenan sus tramos de la salida ya reservada.
+ */
+typedef int (*EscrituraRLE)(void *destino, const unsigned char *datos, size_t n);
+
+/**
+ * comprimir_rle_paralelo - Comprime entrada con hasta hilos hilos
+ * @escribir: recibe la salida en orden (magia incluida)
+ * Retorna: 0, o -1 si hubo error
+ */
+int comprimir_rle_paralelo(int hilos, const unsigned char *entrada, size_t n,
+                           EscrituraRLE escribir, void *destino);
+
+// Tramos de la entrada comprimida y dónde escribe cada uno
+typedef struct {
+    int formato;            // 1: pares, 2: paquetes
+    size_t num;
+    size_t *entrada;        // num + 1 posiciones en la entrada
+    size_t *salida;         // num + 1 posiciones en la salida; salida[num] es el total
+} PlanRLE;
+
+/**
+ * rle_planificar - Divide entrada en tramos y calcula el tamaño de la salida
+ * Retorna: 0, o -1 si los datos no son válidos (liberar el plan igual)
+ */
+int rle_planificar(PlanRLE *plan, int hilos, const unsigned char *entrada, size_t n);
+
+/**
+ * rle_descomprimir_plan - Descomprime los tramos en paralelo
+ * @salida: plan->salida[plan->num] bytes
+ */
+int rle_descomprimir_plan(const PlanRLE *plan, int hilos, const unsigned char *entrada, unsigned char *salida);
+
+void rle_liberar_plan(PlanRLE *plan);
+
+// Lo corre --selftest. Retorna: 0 si los cortes por salida del formato 2
+// entran en el plan y se descomprimen bien en paralelo, -1 si no
+int rle_verificar(void);
+
 #endif // RLE_H
\ No newline at end of file
@@ -0,0 +1,417 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "tuberia.h"
+
+// Alineación de buffers, posiciones y longitudes que exige O_DIRECT
+#define ALINEACION 4096
+
+// Anillo de buffers compartido entre el hilo que llama y el hilo de E/S
+typedef struct {
+    unsigned char **buffers;
+    size_t *llenos;             // bytes válidos de cada buffer
+    int num;
+    int listos;                 // buffers entregados y aún no consumidos
+    int productor;              // próximo buffer a llenar
+    int consumidor;             // próximo buffer a consumir
+    pthread_mutex_t mutex;
+    pthread_cond_t cambio;
+} Anillo;
+
+struct LectorTuberia {
+    int fd;
+    off_t posicion;             // -1 si el descriptor no admite pread
+    int directo;
+    int flags_originales;
+    size_t tam_buffer;
+    Anillo anillo;
+    int fin;                    // el hilo llegó al final del archivo
+    int error;
+    int detener;                // el consumidor terminó antes del final
+    pthread_t hilo;
+
+    // Cursor del consumidor en el buffer actual
+    int tomado;
+    size_t pos;
+};
+
+struct EscritorTuberia {
+    int fd;
+    off_t inicio;
+    off_t posicion;             // -1 si el descriptor no admite pwrite
+    int directo;
+    int flags_originales;
+    size_t tam_buffer;
+    Anillo anillo;
+    int fin;                    // no se van a entregar más buffers
+    int error;
+    int rellenado;              // el último bloque se escribió con relleno
+    size_t pos;                 // bytes en el buffer que se está llenando
+    long long total;
+    pthread_t hilo;
+};
+
+static int anillo_crear(Anillo *a, int num, size_t tam) {
+    a->num = num;
+    a->listos = 0;
+    a->productor = 0;
+    a->consumidor = 0;
+    a->buffers = calloc(num, sizeof(unsigned char *));
+    a->llenos = calloc(num, sizeof(size_t));
+    if (!a->buffers || !a->llenos) {
+        free(a->buffers);
+        free(a->llenos);
+        return -1;
+    }
+
+    for (int i = 0; i < num; i++) {
+        void *p;
+        if (posix_memalign(&p, ALINEACION, tam) != 0) {
+            for (int k = 0; k < i; k++) free(a->buffers[k]);
+            free(a->buffers);
+            free(a->llenos);
+            return -1;
+        }
+        a->buffers[i] = p;
+    }
+
+    pthread_mutex_init(&a->mutex, NULL);
+    pthread_cond_init(&a->cambio, NULL);
+    return 0;
+}
+
+static void anillo_destruir(Anillo *a) {
+    for (int i = 0; i < a->num; i++) free(a->buffers[i]);
+    free(a->buffers);
+    free(a->llenos);
+    pthread_mutex_destroy(&a->mutex);
+    pthread_cond_destroy(&a->cambio);
+}
+
+static size_t normalizar_tamano(size_t tam) {
+    if (tam < TUBERIA_BUFFER_MIN) tam = TUBERIA_BUFFER_MIN;
+    if (tam > TUBERIA_BUFFER_MAX) tam = TUBERIA_BUFFER_MAX;
+    return tam - tam % ALINEACION;
+}
+
+// Activa O_DIRECT en fd si la posición inicial está alineada. Retorna 1 si quedó activo
+static int activar_directo(int fd, off_t posicion, int *flags_originales) {
+    *flags_originales = fcntl(fd, F_GETFL);
+    if (*flags_originales < 0 || posicion < 0 || posicion % ALINEACION != 0) return 0;
+    return fcntl(fd, F_SETFL, *flags_originales | O_DIRECT) == 0;
+}
+
+static void desactivar_directo(int fd, int *directo, int flags_originales) {
+    if (*directo) {
+        fcntl(fd, F_SETFL, flags_originales);
+        *directo = 0;
+    }
+}
+
+// ---------------------------------------------------------------- lector
+
+// Llena buf hasta n bytes (menos solo al final del archivo)
+static ssize_t leer_completo(LectorTuberia *l, unsigned char *buf, size_t n) {
+    size_t total = 0;
+    while (total < n) {
+        ssize_t r;
+        if (l->posicion >= 0) r = pread(l->fd, buf + total, n - total, l->posicion + total);
+        else r = read(l->fd, buf + total, n - total);
+
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            // El sistema de archivos rechazó O_DIRECT: seguir con E/S normal
+            if (errno == EINVAL && l->directo) {
+                desactivar_directo(l->fd, &l->directo, l->flags_originales);
+                continue;
+            }
+            return -1;
+        }
+        if (r == 0) break;
+        total += r;
+    }
+    if (l->posicion >= 0) l->posicion += total;
+    return total;
+}
+
+static void *hilo_lector(void *arg) {
+    LectorTuberia *l = arg;
+    Anillo *a = &l->anillo;
+
+    while (1) {
+        pthread_mutex_lock(&a->mutex);
+        while (a->listos == a->num && !l->detener) {
+            pthread_cond_wait(&a->cambio, &a->mutex);
+        }
+        int detener = l->detener;
+        int indice = a->productor;
+        pthread_mutex_unlock(&a->mutex);
+        if (detener) break;
+
+        ssize_t n = leer_completo(l, a->buffers[indice], l->tam_buffer);
+
+        pthread_mutex_lock(&a->mutex);
+        if (n < 0) {
+            l->error = errno;
+            l->fin = 1;
+        } else {
+            if (n > 0) {
+                a->llenos[indice] = n;
+                a->productor = (indice + 1) % a->num;
+                a->listos++;
+            }
+            if ((size_t)n < l->tam_buffer) l->fin = 1;
+        }
+        int fin = l->fin;
+        pthread_cond_broadcast(&a->cambio);
+        pthread_mutex_unlock(&a->mutex);
+        if (fin) break;
+    }
+    return NULL;
+}
+
+LectorTuberia *lector_tuberia_crear(int fd, const ConfigTuberia *config) {
+    LectorTuberia *l = calloc(1, sizeof(LectorTuberia));
+    if (!l) return NULL;
+
+    l->fd = fd;
+    l->tam_buffer = normalizar_tamano(config->tam_buffer);
+    l->posicion = lseek(fd, 0, SEEK_CUR);
+    l->directo = config->directo && activar_directo(fd, l->posicion, &l->flags_originales);
+    if (!l->directo && l->posicion >= 0) {
+        posix_fadvise(fd, l->posicion, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    int num = config->num_buffers > 1 ? config->num_buffers : TUBERIA_NUM_BUFFERS;
+    if (anillo_crear(&l->anillo, num, l->tam_buffer) != 0) {
+        desactivar_directo(fd, &l->directo, l->flags_originales);
+        free(l);
+        return NULL;
+    }
+
+    if (pthread_create(&l->hilo, NULL, hilo_lector, l) != 0) {
+        anillo_destruir(&l->anillo);
+        desactivar_directo(fd, &l->directo, l->flags_originales);
+        free(l);
+        return NULL;
+    }
+    return l;
+}
+
+// Suelta el buffer actual y espera el siguiente. Retorna 1, 0 al final o -1
+static int lector_siguiente(LectorTuberia *l) {
+    Anillo *a = &l->anillo;
+
+    pthread_mutex_lock(&a->mutex);
+    if (l->tomado) {
+        a->consumidor = (a->consumidor + 1) % a->num;
+        a->listos--;
+        l->tomado = 0;
+        pthread_cond_broadcast(&a->cambio);
+    }
+    while (a->listos == 0 && !l->fin) {
+        pthread_cond_wait(&a->cambio, &a->mutex);
+    }
+    int r;
+    if (a->listos > 0) {
+        l->tomado = 1;
+        l->pos = 0;
+        r = 1;
+    } else {
+        r = l->error ? -1 : 0;
+    }
+    pthread_mutex_unlock(&a->mutex);
+    return r;
+}
+
+ssize_t lector_tuberia_leer(LectorTuberia *l, void *buf, size_t n) {
+    Anillo *a = &l->anillo;
+    size_t copiados = 0;
+
+    while (copiados < n) {
+        if (!l->tomado || l->pos == a->llenos[a->consumidor]) {
+            int r = lector_siguiente(l);
+            if (r < 0) {
+                errno = l->error;
+                return -1;
+            }
+            if (r == 0) break;
+        }
+
+        size_t disponibles = a->llenos[a->consumidor] - l->pos;
+        size_t copiar = n - copiados < disponibles ? n - copiados : disponibles;
+        memcpy((unsigned char *)buf + copiados, a->buffers[a->consumidor] + l->pos, copiar);
+        l->pos += copiar;
+        copiados += copiar;
+    }
+    return copiados;
+}
+
+void lector_tuberia_destruir(LectorTuberia *l) {
+    if (!l) return;
+
+    pthread_mutex_lock(&l->anillo.mutex);
+    l->detener = 1;
+    pthread_cond_broadcast(&l->anillo.cambio);
+    pthread_mutex_unlock(&l->anillo.mutex);
+    pthread_join(l->hilo, NULL);
+
+    desactivar_directo(l->fd, &l->directo, l->flags_originales);
+    anillo_destruir(&l->anillo);
+    free(l);
+}
+
+// ---------------------------------------------------------------- escritor
+
+static int escribir_completo(EscritorTuberia *e, const unsigned char *buf, size_t n) {
+    size_t total = 0;
+    while (total < n) {
+        ssize_t r;
+        if (e->posicion >= 0) r = pwrite(e->fd, buf + total, n - total, e->posicion + total);
+        else r = write(e->fd, buf + total, n - total);
+
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EINVAL && e->directo) {
+                desactivar_directo(e->fd, &e->directo, e->flags_originales);
+                continue;
+            }
+            return -1;
+        }
+        total += r;
+    }
+    if (e->posicion >= 0) e->posicion += total;
+    return 0;
+}
+
+static void *hilo_escritor(void *arg) {
+    EscritorTuberia *e = arg;
+    Anillo *a = &e->anillo;
+
+    while (1) {
+        pthread_mutex_lock(&a->mutex);
+        while (a->listos == 0 && !e->fin) {
+            pthread_cond_wait(&a->cambio, &a->mutex);
+        }
+        if (a->listos == 0) {
+            pthread_mutex_unlock(&a->mutex);
+            break;
+        }
+        int indice = a->consumidor;
+        pthread_mutex_unlock(&a->mutex);
+
+        size_t n = a->llenos[indice];
+
+        // Con O_DIRECT el último bloque incompleto se rellena y luego se recorta
+        if (e->directo && n % ALINEACION != 0) {
+            size_t relleno = ALINEACION - n % ALINEACION;
+            memset(a->buffers[indice] + n, 0, relleno);
+            n += relleno;
+            e->rellenado = 1;
+        }
+        int r = escribir_completo(e, a->buffers[indice], n);
+
+        pthread_mutex_lock(&a->mutex);
+        if (r != 0) e->error = errno ? errno : EIO;
+        a->consumidor = (indice + 1) % a->num;
+        a->listos--;
+        pthread_cond_broadcast(&a->cambio);
+        pthread_mutex_unlock(&a->mutex);
+        if (r != 0) break;
+    }
+    return NULL;
+}
+
+EscritorTuberia *escritor_tuberia_crear(int fd, const ConfigTuberia *config) {
+    EscritorTuberia *e = calloc(1, sizeof(EscritorTuberia));
+    if (!e) return NULL;
+
+    e->fd = fd;
+    e->tam_buffer = normalizar_tamano(config->tam_buffer);
+    e->inicio = lseek(fd, 0, SEEK_CUR);
+    e->posicion = e->inicio;
+    e->directo = config->directo && activar_directo(fd, e->posicion, &e->flags_originales);
+
+    int num = config->num_buffers > 1 ? config->num_buffers : TUBERIA_NUM_BUFFERS;
+    if (anillo_crear(&e->anillo, num, e->tam_buffer) != 0) {
+        desactivar_directo(fd, &e->directo, e->flags_originales);
+        free(e);
+        return NULL;
+    }
+
+    if (pthread_create(&e->hilo, NULL, hilo_escritor, e) != 0) {
+        anillo_destruir(&e->anillo);
+        desactivar_directo(fd, &e->directo, e->flags_originales);
+        free(e);
+        return NULL;
+    }
+    return e;
+}
+
+// Pasa el buffer actual al hilo escritor y espera a tener uno libre
+static int escritor_entregar(EscritorTuberia *e) {
+    Anillo *a = &e->anillo;
+
+    pthread_mutex_lock(&a->mutex);
+    a->llenos[a->productor] = e->pos;
+    a->productor = (a->productor + 1) % a->num;
+    a->listos++;
+    pthread_cond_broadcast(&a->cambio);
+    while (a->listos == a->num && !e->error) {
+        pthread_cond_wait(&a->cambio, &a->mutex);
+    }
+    int error = e->error;
+    pthread_mutex_unlock(&a->mutex);
+
+    e->pos = 0;
+    return error ? -1 : 0;
+}
+
+int escritor_tuberia_escribir(EscritorTuberia *e, const void *datos, size_t n) {
+    const unsigned char *p = datos;
+    if (__atomic_load_n(&e->error, __ATOMIC_RELAXED)) return -1;
+
+    while (n > 0) {
+        size_t libre = e->tam_buffer - e->pos;
+        size_t copiar = n < libre ? n : libre;
+        memcpy(e->anillo.buffers[e->anillo.productor] + e->pos, p, copiar);
+        e->pos += copiar;
+        e->total += copiar;
+        p += copiar;
+        n -= copiar;
+
+        if (e->pos == e->tam_buffer && escritor_entregar(e) != 0) return -1;
+    }
+    return 0;
+}
+
+int escritor_tuberia_cerrar(EscritorTuberia *e) {
+    if (!e) return -1;
+    Anillo *a = &e->anillo;
+
+    pthread_mutex_lock(&a->mutex);
+    if (e->pos > 0 && !e->error) {
+        a->llenos[a->productor] = e->pos;
+        a->productor = (a->productor + 1) % a->num;
+        a->listos++;
+    }
+    e->fin = 1;
+    pthread_cond_broadcast(&a->cambio);
+    pthread_mutex_unlock(&a->mutex);
+    pthread_join(e->hilo, NULL);
+
+    int resultado = e->error ? -1 : 0;
+    if (e->rellenado && ftruncate(e->fd, e->inicio + e->total) != 0) resultado = -1;
+
+    // Dejar la posición del descriptor al final de lo escrito
+    if (e->inicio >= 0) lseek(e->fd, e->inicio + e->total, SEEK_SET);
+
+    desactivar_directo(e->fd, &e->directo, e->flags_originales);
+    anillo_destruir(&e->anillo);
+    free(e);
+    return resultado;
+}
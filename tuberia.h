@@ -0,0 +1,66 @@
+#ifndef TUBERIA_H
+#define TUBERIA_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * E/S en tubería para archivos grandes: lectura -> codec -> escritura.
+ *
+ * Un hilo lector llena por adelantado un anillo de buffers grandes y
+ * alineados, y un hilo escritor vacía otro anillo hacia la salida, mientras
+ * el hilo que llama ejecuta el codec. Así el disco y la CPU trabajan a la vez
+ * y el tiempo total se acerca a max(disco, codec) en vez de disco + codec.
+ *
+ * Con directo = 1 se usa O_DIRECT (sin pasar por la caché de páginas) para
+ * archivos mucho más grandes que la memoria; si el sistema de archivos no lo
+ * soporta se vuelve a E/S normal.
+ */
+
+#define TUBERIA_BUFFER_MIN      (1L * 1024 * 1024)
+#define TUBERIA_BUFFER_MAX      (8L * 1024 * 1024)
+#define TUBERIA_BUFFER_DEFECTO  (4L * 1024 * 1024)
+#define TUBERIA_NUM_BUFFERS     3
+
+typedef struct {
+    size_t tam_buffer;      // bytes por buffer (múltiplo de 4096)
+    int num_buffers;        // buffers en cada anillo
+    int directo;            // usar O_DIRECT
+} ConfigTuberia;
+
+typedef struct LectorTuberia LectorTuberia;
+typedef struct EscritorTuberia EscritorTuberia;
+
+/**
+ * lector_tuberia_crear - Empieza a leer fd desde su posición actual
+ * Retorna: el lector, o NULL si hubo error
+ */
+LectorTuberia *lector_tuberia_crear(int fd, const ConfigTuberia *config);
+
+/**
+ * lector_tuberia_leer - Copia hasta n bytes en buf, como read()
+ *
+ * Solo devuelve menos de n al llegar al final del archivo.
+ * Retorna: bytes copiados, 0 al final, -1 si hubo error de lectura
+ */
+ssize_t lector_tuberia_leer(LectorTuberia *l, void *buf, size_t n);
+
+// Detiene el hilo lector y libera los buffers
+void lector_tuberia_destruir(LectorTuberia *l);
+
+/**
+ * escritor_tuberia_crear - Escribe en fd a partir de su posición actual
+ * Retorna: el escritor, o NULL si hubo error
+ */
+EscritorTuberia *escritor_tuberia_crear(int fd, const ConfigTuberia *config);
+
+// Copia n bytes al anillo. Retorna: 0, o -1 si una escritura anterior falló
+int escritor_tuberia_escribir(EscritorTuberia *e, const void *datos, size_t n);
+
+/**
+ * escritor_tuberia_cerrar - Escribe lo pendiente, espera al hilo y libera
+ * Retorna: 0 si todo se escribió, -1 si hubo error
+ */
+int escritor_tuberia_cerrar(EscritorTuberia *e);
+
+#endif // TUBERIA_H
@@ -0,0 +1,382 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "uring.h"
+#include "recorrido.h"
+
+// Archivos del lote con operaciones en vuelo al mismo tiempo
+#define URING_VENTANA 32
+
+// Operación codificada en los 3 bits bajos de user_data
+enum {
+    OP_ABRIR_IN,
+    OP_LEER,
+    OP_CERRAR_IN,
+    OP_ABRIR_OUT,
+    OP_ESCRIBIR,
+    OP_CERRAR_OUT
+};
+
+static const char *nombres_op[] = {
+    "abrir entrada", "leer", "cerrar entrada", "abrir salida", "escribir", "cerrar salida"
+};
+
+typedef struct {
+    TrabajoArchivo *t;
+    int fd_in;
+    int fd_out;
+    unsigned char *datos;
+    size_t tam;
+    size_t leidos;
+    unsigned char *salida;
+    size_t tam_salida;
+    size_t escritos;
+    int en_vuelo;       // operaciones enviadas sin completar
+    int fin;            // no quedan operaciones por enviar
+} EstadoArchivo;
+
+int anillo_iniciar(AnilloES *a, unsigned entradas) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(a, 0, sizeof(*a));
+
+    a->fd = syscall(__NR_io_uring_setup, entradas, &p);
+    if (a->fd < 0) return -1;
+
+    // Verificar que el kernel soporte las operaciones que usamos (>= 5.6)
+    size_t tam_probe = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, tam_probe);
+    int soportado = probe &&
+        syscall(__NR_io_uring_register, a->fd, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+        probe->last_op >= IORING_OP_CLOSE &&
+        (probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED) &&
+        (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) &&
+        (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED) &&
+        (probe->ops[IORING_OP_CLOSE].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    if (!soportado) {
+        close(a->fd);
+        return -1;
+    }
+
+    a->entradas = p.sq_entries;
+    a->sq_mem_tam = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    a->cq_mem_tam = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (a->cq_mem_tam > a->sq_mem_tam) a->sq_mem_tam = a->cq_mem_tam;
+        a->cq_mem_tam = 0;
+    }
+
+    a->sq_mem = mmap(NULL, a->sq_mem_tam, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     a->fd, IORING_OFF_SQ_RING);
+    if (a->sq_mem == MAP_FAILED) {
+        close(a->fd);
+        return -1;
+    }
+
+    if (a->cq_mem_tam) {
+        a->cq_mem = mmap(NULL, a->cq_mem_tam, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         a->fd, IORING_OFF_CQ_RING);
+        if (a->cq_mem == MAP_FAILED) {
+            munmap(a->sq_mem, a->sq_mem_tam);
+            close(a->fd);
+            return -1;
+        }
+    } else {
+        a->cq_mem = a->sq_mem;
+    }
+
+    a->sqes_tam = p.sq_entries * sizeof(struct io_uring_sqe);
+    a->sqes = mmap(NULL, a->sqes_tam, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   a->fd, IORING_OFF_SQES);
+    if (a->sqes == MAP_FAILED) {
+        if (a->cq_mem_tam) munmap(a->cq_mem, a->cq_mem_tam);
+        munmap(a->sq_mem, a->sq_mem_tam);
+        close(a->fd);
+        return -1;
+    }
+
+    char *sq = a->sq_mem;
+    a->sq_head = (unsigned *)(sq + p.sq_off.head);
+    a->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    a->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    a->sq_array = (unsigned *)(sq + p.sq_off.array);
+
+    char *cq = a->cq_mem;
+    a->cq_head = (unsigned *)(cq + p.cq_off.head);
+    a->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    a->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    a->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+void anillo_cerrar(AnilloES *a) {
+    if (a->fd < 0) return;
+    munmap(a->sqes, a->sqes_tam);
+    if (a->cq_mem_tam) munmap(a->cq_mem, a->cq_mem_tam);
+    munmap(a->sq_mem, a->sq_mem_tam);
+    close(a->fd);
+    a->fd = -1;
+}
+
+// Envía los sqes pendientes y espera al menos `esperar` completados
+static int anillo_enviar(AnilloES *a, unsigned esperar) {
+    while (1) {
+        int r = syscall(__NR_io_uring_enter, a->fd, a->sq_pendientes, esperar,
+                        esperar ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (r >= 0) {
+            a->sq_pendientes -= r;
+            return 0;
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) return -1;
+    }
+}
+
+static struct io_uring_sqe *anillo_sqe(AnilloES *a, int opcode, int fd, uint64_t user_data) {
+    unsigned tail = *a->sq_tail;
+    while (tail - __atomic_load_n(a->sq_head, __ATOMIC_ACQUIRE) >= a->entradas) {
+        if (anillo_enviar(a, 0) != 0) return NULL;
+    }
+
+    unsigned idx = tail & *a->sq_mask;
+    struct io_uring_sqe *sqe = &a->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = user_data;
+
+    a->sq_array[idx] = idx;
+    __atomic_store_n(a->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    a->sq_pendientes++;
+    return sqe;
+}
+
+static uint64_t dato_usuario(int indice, int op) {
+    return ((uint64_t)indice << 3) | op;
+}
+
+static int encolar(AnilloES *a, EstadoArchivo *e, int indice, int op) {
+    struct io_uring_sqe *sqe = NULL;
+    TrabajoArchivo *t = e->t;
+    uint64_t ud = dato_usuario(indice, op);
+
+    switch (op) {
+        case OP_ABRIR_IN: {
+            int usar_dir = t->dir_in && t->dir_in->fd >= 0;
+            sqe = anillo_sqe(a, IORING_OP_OPENAT, usar_dir ? t->dir_in->fd : AT_FDCWD, ud);
+            if (!sqe) break;
+            sqe->addr = (uint64_t)(uintptr_t)(usar_dir ? t->nombre_in : t->entrada);
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            break;
+        }
+        case OP_LEER:
+            sqe = anillo_sqe(a, IORING_OP_READ, e->fd_in, ud);
+            if (!sqe) break;
+            sqe->addr = (uint64_t)(uintptr_t)(e->datos + e->leidos);
+            sqe->len = e->tam - e->leidos;
+            sqe->off = e->leidos;
+            break;
+        case OP_CERRAR_IN:
+            sqe = anillo_sqe(a, IORING_OP_CLOSE, e->fd_in, ud);
+            e->fd_in = -1;
+            break;
+        case OP_ABRIR_OUT: {
+            int usar_dir = t->dir_out && t->dir_out->fd >= 0;
+            sqe = anillo_sqe(a, IORING_OP_OPENAT, usar_dir ? t->dir_out->fd : AT_FDCWD, ud);
+            if (!sqe) break;
+            sqe->addr = (uint64_t)(uintptr_t)(usar_dir ? t->nombre_out : t->salida);
+            sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+            sqe->len = 0644;
+            break;
+        }
+        case OP_ESCRIBIR:
+            sqe = anillo_sqe(a, IORING_OP_WRITE, e->fd_out, ud);
+            if (!sqe) break;
+            sqe->addr = (uint64_t)(uintptr_t)(e->salida + e->escritos);
+            sqe->len = e->tam_salida - e->escritos;
+            sqe->off = e->escritos;
+            break;
+        case OP_CERRAR_OUT:
+            sqe = anillo_sqe(a, IORING_OP_CLOSE, e->fd_out, ud);
+            e->fd_out = -1;
+            break;
+    }
+
+    if (!sqe) return -1;
+    e->en_vuelo++;
+    return 0;
+}
+
+// Marca el archivo con error y cierra lo que tenga abierto
+static void fallar(AnilloES *a, EstadoArchivo *e, int indice, int op, int error) {
+    fprintf(stderr, "io_uring (%s) %s: %s\n", nombres_op[op], e->t->entrada, strerror(error));
+    e->t->resultado = 1;
+    if (e->fd_in >= 0) encolar(a, e, indice, OP_CERRAR_IN);
+    if (e->fd_out >= 0) encolar(a, e, indice, OP_CERRAR_OUT);
+    e->fin = 1;
+}
+
+// Avanza la máquina de estados de un archivo con un completado
+static void completar(AnilloES *a, EstadoArchivo *e, int indice, int op, int res,
+                      int *listos, int *fin_listos) {
+    e->en_vuelo--;
+    if (e->fin && op != OP_CERRAR_IN && op != OP_CERRAR_OUT) return;
+
+    if (res < 0 && op != OP_CERRAR_IN) {
+        fallar(a, e, indice, op, -res);
+        return;
+    }
+
+    switch (op) {
+        case OP_ABRIR_IN:
+            e->fd_in = res;
+            if (e->tam == 0) {
+                encolar(a, e, indice, OP_CERRAR_IN);
+                listos[(*fin_listos)++] = indice;
+            } else {
+                encolar(a, e, indice, OP_LEER);
+            }
+            break;
+
+        case OP_LEER:
+            e->leidos += res;
+            if (res > 0 && e->leidos < e->tam) {
+                encolar(a, e, indice, OP_LEER);     // lectura corta: pedir el resto
+            } else {
+                encolar(a, e, indice, OP_CERRAR_IN);
+                listos[(*fin_listos)++] = indice;
+            }
+            break;
+
+        case OP_ABRIR_OUT:
+            e->fd_out = res;
+            if (e->tam_salida == 0) encolar(a, e, indice, OP_CERRAR_OUT);
+            else encolar(a, e, indice, OP_ESCRIBIR);
+            break;
+
+        case OP_ESCRIBIR:
+            e->escritos += res;
+            if (res > 0 && e->escritos < e->tam_salida) {
+                encolar(a, e, indice, OP_ESCRIBIR);
+            } else if (res == 0) {
+                fallar(a, e, indice, op, EIO);
+            } else {
+                encolar(a, e, indice, OP_CERRAR_OUT);
+            }
+            break;
+
+        case OP_CERRAR_OUT:
+            if (!e->fin) e->t->resultado = res < 0 ? 1 : 0;
+            e->fin = 1;
+            break;
+    }
+}
+
+int uring_procesar_lote(AnilloES *a, TrabajoArchivo **archivos, int n,
+                        FuncionCodecMemoria codec, void *contexto) {
+    EstadoArchivo *estados = calloc(n, sizeof(EstadoArchivo));
+    int *listos = malloc(n * sizeof(int));
+    if (!estados || !listos) {
+        free(estados);
+        free(listos);
+        return -1;
+    }
+
+    int siguiente = 0, activos = 0, terminados = 0;
+    int ini_listos = 0, fin_listos = 0;
+    int *finalizado = calloc(n, sizeof(int));
+
+    while (terminados < n) {
+        // Arrancar archivos nuevos hasta llenar la ventana
+        while (siguiente < n && activos < URING_VENTANA) {
+            EstadoArchivo *e = &estados[siguiente];
+            e->t = archivos[siguiente];
+            e->fd_in = e->fd_out = -1;
+            e->tam = e->t->tamano;
+            e->datos = malloc(e->tam > 0 ? e->tam : 1);
+            e->t->hilo = pool_hilo_actual();
+            printf("[HILO %d] Procesando: %s\n", e->t->hilo, e->t->entrada);
+
+            if (!e->datos || encolar(a, e, siguiente, OP_ABRIR_IN) != 0) {
+                e->t->resultado = 1;
+                e->fin = 1;
+            }
+            siguiente++;
+            activos++;
+        }
+
+        // Si hay archivos leídos, no bloquear: el codec trabaja mientras tanto
+        int hay_cpu = ini_listos < fin_listos;
+        int en_vuelo = 0;
+        for (int i = 0; i < siguiente; i++) en_vuelo += estados[i].en_vuelo;
+        if (anillo_enviar(a, (!hay_cpu && en_vuelo > 0) ? 1 : 0) != 0) {
+            perror("io_uring_enter");
+            break;
+        }
+
+        // Recoger completados
+        unsigned head = *a->cq_head;
+        unsigned tail = __atomic_load_n(a->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe *cqe = &a->cqes[head & *a->cq_mask];
+            int indice = (int)(cqe->user_data >> 3);
+            int op = (int)(cqe->user_data & 7);
+            completar(a, &estados[indice], indice, op, cqe->res, listos, &fin_listos);
+            head++;
+        }
+        __atomic_store_n(a->cq_head, head, __ATOMIC_RELEASE);
+
+        // Aplicar el codec a un archivo ya leído
+        if (ini_listos < fin_listos) {
+            int indice = listos[ini_listos++];
+            EstadoArchivo *e = &estados[indice];
+            if (!e->fin) {
+                int r = codec(contexto, e->t, e->datos, e->leidos, &e->salida, &e->tam_salida);
+                if (r != 0) {
+                    e->t->resultado = r;
+                    e->fin = 1;
+                } else if (encolar(a, e, indice, OP_ABRIR_OUT) != 0) {
+                    e->t->resultado = 1;
+                    e->fin = 1;
+                }
+            }
+            free(e->datos);
+            e->datos = NULL;
+        }
+
+        // Liberar los archivos que terminaron
+        for (int i = 0; i < siguiente; i++) {
+            EstadoArchivo *e = &estados[i];
+            if (!finalizado[i] && e->fin && e->en_vuelo == 0) {
+                finalizado[i] = 1;
+                free(e->datos);
+                free(e->salida);
+                e->datos = e->salida = NULL;
+                trabajo_soltar_dirs(e->t);
+                terminados++;
+                activos--;
+            }
+        }
+
+        if (en_vuelo == 0 && !hay_cpu && ini_listos == fin_listos && siguiente == n &&
+            terminados < n && a->sq_pendientes == 0) {
+            // Nada en vuelo ni por hacer: no debería ocurrir
+            int vivos = 0;
+            for (int i = 0; i < n; i++) vivos += estados[i].en_vuelo;
+            if (vivos == 0) break;
+        }
+    }
+
+    free(finalizado);
+    free(estados);
+    free(listos);
+    return 0;
+}
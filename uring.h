@@ -0,0 +1,62 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <linux/io_uring.h>
+#include "planificador.h"
+
+/**
+ * Motor de E/S por lotes con io_uring (--io=uring).
+ *
+ * Para lotes de archivos pequeños, abre, lee, escribe y cierra muchos
+ * archivos con solicitudes agrupadas en la cola de envío, y mientras esas
+ * operaciones están en vuelo aplica el codec a los archivos que ya se
+ * leyeron. Se usan las llamadas al sistema directamente (sin liburing).
+ */
+
+typedef struct {
+    int fd;
+    unsigned entradas;
+
+    // Cola de envío
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned sq_pendientes;     // sqes preparados sin enviar al kernel
+
+    // Cola de completados
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_mem;
+    size_t sq_mem_tam;
+    void *cq_mem;
+    size_t cq_mem_tam;
+    size_t sqes_tam;
+} AnilloES;
+
+/**
+ * anillo_iniciar - Crea un io_uring con al menos `entradas` posiciones
+ * Retorna: 0 si se pudo, -1 si el kernel no lo soporta o no lo permite
+ */
+int anillo_iniciar(AnilloES *a, unsigned entradas);
+void anillo_cerrar(AnilloES *a);
+
+// Codec en memoria: transforma entrada en *salida (reservada con malloc)
+typedef int (*FuncionCodecMemoria)(void *contexto, TrabajoArchivo *t, const unsigned char *entrada,
+                                   size_t n, unsigned char **salida, size_t *n_salida);
+
+/**
+ * uring_procesar_lote - Procesa n archivos con el anillo
+ *
+ * Deja el resultado de cada archivo en su campo resultado.
+ * Retorna: 0
+ */
+int uring_procesar_lote(AnilloES *a, TrabajoArchivo **archivos, int n,
+                        FuncionCodecMemoria codec, void *contexto);
+
+#endif // URING_H